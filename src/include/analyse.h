@@ -0,0 +1,36 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ANALYSE_H
+#define ANALYSE_H
+
+#include "worker.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Analyses all positions of the given EPD file with fixed-depth searches. All
+// workers run their own single-threaded searches on different positions and
+// share the hashtable. Results are printed as JSON lines in completion order,
+// followed by the analysis throughput.
+void analyse_epd(const char *path, int depth);
+
+// Splits an EPD line into a FEN and the value of its "id" operation (if any).
+// Lines holding full FENs are accepted as well.
+bool parse_epd_line(char *line, char *fen, size_t fenSize, char *id, size_t idSize);
+
+#endif // ANALYSE_H
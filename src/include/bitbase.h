@@ -0,0 +1,79 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include "board.h"
+#include "types.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+enum
+{
+    BITBASE_MAX_PIECES = 5,
+    BITBASE_MAX_TABLES = 256,
+
+    // Results stored in the bitbases, relative to the side to move
+    BITBASE_DRAW = 0,
+    BITBASE_WIN = 1,
+    BITBASE_LOSS = 2
+};
+
+// Struct for a WDL bitbase of a given material class. The pieces are stored
+// in a fixed order: White King, Black King, then the other White pieces and
+// the other Black pieces by increasing piece type. Positions are indexed by
+// piece squares after mirroring the White King to the a-d files (and to the
+// first four ranks for pawnless classes), with 2 bits per position.
+typedef struct _Bitbase
+{
+    char name[16];
+    int pieceCount;
+    piece_t pieces[BITBASE_MAX_PIECES];
+    bool hasPawns;
+    hashkey_t materialKey;
+    hashkey_t flippedKey;
+    size_t size;
+    const uint8_t *data;
+    void *mapping;
+    size_t mappingSize;
+    bool mapped;
+} Bitbase;
+
+// Returns the bitbase matching the material of the given board, or NULL if no
+// such bitbase is loaded.
+const Bitbase *bitbase_find(const Board *board);
+
+// Returns the result of the given position relative to the side to move.
+int bitbase_probe(const Bitbase *bitbase, const Board *board);
+
+// Evaluates a position covered by the bitbase cached in its board stack.
+score_t bitbase_evaluate(const Board *board);
+
+// Loads all bitbase files from the given directory, and returns the number
+// of loaded bitbases.
+int bitbase_load_dir(const char *path);
+
+// Unloads all bitbases.
+void bitbase_unload(void);
+
+// Generates the bitbase of the given material class (e.g. "KRvKP") along with
+// all the classes it depends on, and writes them to the given directory.
+bool bitbase_generate(const char *name, const char *path, int threadCount);
+
+#endif // BITBASE_H
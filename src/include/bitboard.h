@@ -19,6 +19,14 @@
 #ifndef BITBOARD_H
 #define BITBOARD_H
 
+#if defined(USE_PDEP) && !defined(USE_PEXT)
+#error "USE_PDEP requires USE_PEXT"
+#endif
+
+#if defined(USE_DISPATCH) && defined(USE_PEXT)
+#error "USE_DISPATCH selects PEXT at runtime and cannot be used with USE_PEXT"
+#endif
+
 #if (defined(USE_PREFETCH) || defined(USE_POPCNT) || defined(USE_PEXT))
 // Do not include the header if unspecified, because some compilers might
 // not have it.
@@ -27,6 +35,10 @@
 
 #include "types.h"
 
+#ifdef USE_DISPATCH
+#include "cpu.h"
+#endif
+
 typedef uint64_t bitboard_t;
 
 // Constants for file bitboard masks.
@@ -59,19 +71,30 @@ static const bitboard_t CENTER_FILES_BB = 0x3C3C3C3C3C3C3C3Cul;
 static const bitboard_t CENTER_BB = 0x0000001818000000ul;
 
 // Bitboards of all squares on the line between two squares.
-extern bitboard_t LineBB[SQUARE_NB][SQUARE_NB];
+extern TABLE_CONST bitboard_t LineBB[SQUARE_NB][SQUARE_NB];
 // Bitboards of pseudo-legal moves for a given square and piece type (not checking occupancy).
-extern bitboard_t PseudoMoves[PIECETYPE_NB][SQUARE_NB];
+extern TABLE_CONST bitboard_t PseudoMoves[PIECETYPE_NB][SQUARE_NB];
 // Bitboards of pawn capture moves.
-extern bitboard_t PawnMoves[COLOR_NB][SQUARE_NB];
+extern TABLE_CONST bitboard_t PawnMoves[COLOR_NB][SQUARE_NB];
 
-// The structure for magic bitboards.
+// The structure for magic bitboards. With PDEP, the attack tables are
+// compressed to 16-bit entries which only store the bits of the attacks on an
+// empty board, dividing their size by four. Fat builds keep the tables for
+// both magic and PEXT indexing, and select one at runtime.
 typedef struct _Magic
 {
     bitboard_t mask;
+#ifdef USE_PDEP
+    bitboard_t attacks;
+    const uint16_t *moves;
+#else
     bitboard_t magic;
-    bitboard_t *moves;
+    const bitboard_t *moves;
+#ifdef USE_DISPATCH
+    const bitboard_t *pextMoves;
+#endif
     unsigned int shift;
+#endif
 } Magic;
 
 // Returns the index of the attack bitboard for a given magic and occupancy bitboard.
@@ -84,12 +107,37 @@ INLINED unsigned int magic_index(const Magic *magic, bitboard_t occupied)
 #endif
 }
 
-// Globals for Rook and Bishop magic bitboards.
-extern Magic RookMagics[SQUARE_NB];
-extern Magic BishopMagics[SQUARE_NB];
+#ifdef USE_DISPATCH
+
+// Returns the bits of the given bitboard selected by the mask with the PEXT
+// instruction, which must only be used when the CPU supports BMI2.
+INLINED bitboard_t pext_asm(bitboard_t b, bitboard_t mask)
+{
+    bitboard_t result;
 
-// Initializes all global bitboard tables and magic bitboards.
-void bitboard_init(void);
+    __asm__("pextq %2, %1, %0" : "=r"(result) : "r"(b), "rm"(mask));
+    return result;
+}
+
+#endif
+
+// Returns the attack bitboard for a given magic and occupancy bitboard.
+INLINED bitboard_t magic_moves(const Magic *magic, bitboard_t occupied)
+{
+#if defined(USE_PDEP)
+    return _pdep_u64(magic->moves[magic_index(magic, occupied)], magic->attacks);
+#elif defined(USE_DISPATCH)
+    if (Cpu.fastPext) return magic->pextMoves[pext_asm(occupied, magic->mask)];
+
+    return magic->moves[magic_index(magic, occupied)];
+#else
+    return magic->moves[magic_index(magic, occupied)];
+#endif
+}
+
+// Globals for Rook and Bishop magic bitboards.
+extern TABLE_CONST Magic RookMagics[SQUARE_NB];
+extern TABLE_CONST Magic BishopMagics[SQUARE_NB];
 
 // Returns the bitboard representing the given square.
 INLINED bitboard_t square_bb(square_t square) { return (bitboard_t)1 << square; }
@@ -160,17 +208,13 @@ INLINED bool sq_aligned(square_t sq1, square_t sq2, square_t sq3)
 // Returns the bitboard of all bishop reachable squares from a given square and occupancy bitboard.
 INLINED bitboard_t bishop_moves_bb(square_t square, bitboard_t occupied)
 {
-    const Magic *magic = &BishopMagics[square];
-
-    return magic->moves[magic_index(magic, occupied)];
+    return magic_moves(&BishopMagics[square], occupied);
 }
 
 // Returns the bitboard of all rook reachable squares from a given square and occupancy bitboard.
 INLINED bitboard_t rook_moves_bb(square_t square, bitboard_t occupied)
 {
-    const Magic *magic = &RookMagics[square];
-
-    return magic->moves[magic_index(magic, occupied)];
+    return magic_moves(&RookMagics[square], occupied);
 }
 
 // Returns the bitboard of all squares attacked by white pawns from the given bitboard.
@@ -21,9 +21,24 @@
 
 #include "bitboard.h"
 #include "hashkey.h"
+#include "nnue.h"
 #include "psq_score.h"
 #include "types.h"
 
+// Special material configurations, which are evaluated without the main
+// evaluation function
+enum
+{
+    EGC_NONE,
+    EGC_BITBASE,     // Material matches a loaded bitbase
+    EGC_SPECIALIZED, // Material matches an entry of the endgame table
+    EGC_KXK_WHITE,   // White has mating material against a lone King
+    EGC_KXK_BLACK    // Black has mating material against a lone King
+};
+
+struct _EndgameEntry;
+struct _Bitbase;
+
 // Struct representing the board stack data from past moves
 typedef struct _Boardstack
 {
@@ -34,6 +49,10 @@ typedef struct _Boardstack
     hashkey_t pawnKey;
     score_t material[COLOR_NB];
     hashkey_t materialKey;
+    int phase;
+    int endgameClass;
+    const struct _EndgameEntry *endgameEntry;
+    const struct _Bitbase *bitbase;
     hashkey_t boardKey;
     bitboard_t checkers;
     piece_t capturedPiece;
@@ -42,6 +61,8 @@ typedef struct _Boardstack
     bitboard_t pinners[COLOR_NB];
     bitboard_t checkSquares[PIECETYPE_NB];
     int repetition;
+    DirtyPieces dirtyPieces;
+    NnueAccumulator accumulator;
 } Boardstack;
 
 // Struct representing the board
@@ -64,8 +85,39 @@ typedef struct _Board
 
 extern Board UciBoard;
 
-// Initializes cycle detection tables.
-void cyclic_init(void);
+// Compact 32-byte representation of a position, annotated with a search score
+// and a game result for training datasets. Pieces are stored as 4-bit codes in
+// the order of the occupied squares, with Rooks that still have castling
+// rights using the PACKED_CASTLING_ROOK type.
+typedef struct _PackedBoard
+{
+    bitboard_t occupancy;
+    uint8_t pieces[16];
+    uint16_t ply;
+    int16_t score; // From White's point of view
+    uint8_t flags; // Side to move in bit 0, Chess960 flag in bit 1
+    uint8_t enPassantSquare;
+    uint8_t rule50;
+    uint8_t result; // 0 for a Black win, 1 for a draw, 2 for a White win
+} PackedBoard;
+
+enum
+{
+    PACKED_CASTLING_ROOK = 7
+};
+
+// Game phase weights of each piece type
+extern const int PhaseWeights[PIECETYPE_NB];
+
+// Cuckoo tables of reversible moves' Zobrist keys, used for cycle detection.
+extern TABLE_CONST hashkey_t CyclicKeys[8192];
+extern TABLE_CONST move_t CyclicMoves[8192];
+
+// Returns the first cuckoo table index for the given move key.
+INLINED uint16_t cyclic_index_lo(hashkey_t key) { return key & 0x1FFFu; }
+
+// Returns the second cuckoo table index for the given move key.
+INLINED uint16_t cyclic_index_hi(hashkey_t key) { return (key >> 13) & 0x1FFFu; }
 
 // Returns the list of attacking pieces for a given square and occupancy.
 bitboard_t attackers_list(const Board *board, square_t s, bitboard_t occupied);
@@ -110,9 +162,19 @@ bool see_greater_than(const Board *board, move_t move, score_t threshold);
 // Initializes the board from the given FEN string.
 int board_from_fen(Board *board, const char *fen, bool isChess960, Boardstack *bstack);
 
+// Initializes the board from the given packed position.
+int board_from_packed(Board *board, const PackedBoard *packed, Boardstack *bstack);
+
+// Packs the given board. The score and result fields are left to the caller.
+void board_pack(const Board *board, PackedBoard *packed);
+
 // Initializes the board stack from the given board.
 void set_boardstack(Board *board, Boardstack *stack);
 
+// Updates the special endgame class of the current position from its material
+// distribution.
+void set_endgame_class(Board *board);
+
 // Initializes checkers info (pinned pieces, checking squares, etc.).
 void set_check(Board *restrict board, Boardstack *restrict stack);
 
@@ -0,0 +1,39 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CPU_H
+#define CPU_H
+
+#include <stdbool.h>
+
+// Struct for the CPU features detected at startup
+typedef struct _CpuFeatures
+{
+    bool avx2;
+    bool avx512;   // AVX-512 F and BW
+    bool vnni;     // AVX-512 VNNI
+    bool fastPext; // BMI2 with a fast PEXT (not microcoded like on AMD before Zen 3)
+} CpuFeatures;
+
+extern CpuFeatures Cpu;
+
+// Detects the features of the running CPU. Fat builds (with USE_DISPATCH)
+// use them to select the fastest code paths at runtime.
+void cpu_init(void);
+
+#endif // CPU_H
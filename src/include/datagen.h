@@ -0,0 +1,66 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include "types.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Packed datasets start with this 8-byte header, followed by PackedBoard
+// records in native byte order.
+#define DATASET_MAGIC "STASHPK1"
+
+enum
+{
+    DATASET_MAGIC_SIZE = 8
+};
+
+// Struct for self-play data generation settings.
+typedef struct _DatagenParams
+{
+    size_t games;
+    int depth;
+    uint64_t nodes;
+    int randomPlies;
+    uint64_t seed;
+    bool binary;
+} DatagenParams;
+
+// Plays self-play games with all workers, each one playing its own games, and
+// appends their quiet positions to the given file in the tuner's dataset
+// format ("<FEN> <result> <score>", both from White's point of view). Games
+// start from the given EPD book (or the starting position if NULL), followed
+// by random moves. Binary runs append PackedBoard records instead.
+void datagen_run(const char *path, const char *bookPath, const DatagenParams *params);
+
+// Splits a line of the tuner's text dataset format, leaving the FEN in the
+// line buffer. Returns false if the result or score fields are missing.
+bool dataset_parse_line(char *line, double *result, score_t *score);
+
+// Checks if the given file starts with the packed dataset header.
+bool dataset_is_packed(FILE *f);
+
+// Converts a text dataset to the packed format, and returns the number of
+// converted positions.
+size_t dataset_convert(const char *input, const char *output);
+
+#endif // DATAGEN_H
@@ -23,7 +23,8 @@
 
 enum
 {
-    EGTB_SIZE = 2048
+    EGTB_SIZE = 2048,
+    KPK_SIZE = 2 * 24 * 64 * 64
 };
 
 // Maps a square relative to the given color.
@@ -69,14 +70,29 @@ typedef struct _EndgameEntry
     color_t winningSide;
 } EndgameEntry;
 
-// Global table for hasing endgames
+// Global table for hashing endgames. Each material key can be stored in two
+// different slots, and insertions use cuckoo hashing to resolve conflicts.
 extern EndgameEntry EndgameTable[EGTB_SIZE];
 
+// Returns the first table index for the given material key.
+INLINED size_t endgame_index_lo(hashkey_t key) { return key & (EGTB_SIZE - 1); }
+
+// Returns the second table index for the given material key.
+INLINED size_t endgame_index_hi(hashkey_t key) { return (key >> 32) & (EGTB_SIZE - 1); }
+
 // Initializes the endgame table.
 void init_endgame_table(void);
 
-// Initializes the KPK bitbase.
-void init_kpk_bitbase(void);
+// KPK bitbase, with one bit per position set for wins of the side with the Pawn.
+extern TABLE_CONST uint8_t KPK_Bitbase[KPK_SIZE / 8];
+
+// Returns the KPK bitbase index for the given position, with the winning side
+// normalized to White and the Pawn on the a-d files.
+INLINED unsigned int kpk_index(color_t stm, square_t bksq, square_t wksq, square_t psq)
+{
+    return (unsigned int)wksq | ((unsigned int)bksq << 6) | ((unsigned int)stm << 12)
+           | ((unsigned int)sq_file(psq) << 13) | ((unsigned int)(RANK_7 - sq_rank(psq)) << 15);
+}
 
 // Checks if the given KPK endgame is winning.
 bool kpk_is_winning(color_t stm, square_t bksq, square_t wksq, square_t psq);
@@ -98,7 +98,9 @@ typedef struct evaltrace_s
     int8_t coeffs[IDX_COUNT][COLOR_NB];
 } evaltrace_t;
 
-extern evaltrace_t Trace;
+// Each thread has its own trace, so that the tuner can load its dataset in
+// parallel.
+extern _Thread_local evaltrace_t Trace;
 
 #define TRACE_INIT memset(&Trace, 0, sizeof(Trace))
 #define TRACE_ADD(idx, color, n) Trace.coeffs[idx][color] += n
@@ -118,9 +120,22 @@ extern evaltrace_t Trace;
 
 #endif
 
+// Entry of the per-worker evaluation cache. Each entry packs the upper 48 bits
+// of the board key along with the 16-bit evaluation, the lower 16 bits being
+// used for indexing.
+typedef uint64_t EvalCacheEntry;
+
+enum
+{
+    EvalCacheSize = 1 << 16
+};
+
 // Evaluates the position.
 score_t evaluate(const Board *board);
 
+// Evaluates the position, using the evaluation cache of the board's worker.
+score_t evaluate_cached(const Board *board);
+
 // Returns the scaled value of the endgame score.
 score_t scale_endgame(const Board *board, const PawnEntry *pe, score_t eg);
 
@@ -39,17 +39,15 @@ INLINED uint64_t mul_hi64(uint64_t x, uint64_t n)
 }
 
 // Global table for Zobrist Piece-Square hashes
-extern hashkey_t ZobristPsq[PIECE_NB][SQUARE_NB];
+extern TABLE_CONST hashkey_t ZobristPsq[PIECE_NB][SQUARE_NB];
 
 // Global table for Zobrist Enpassant hashes
-extern hashkey_t ZobristEnPassant[FILE_NB];
+extern TABLE_CONST hashkey_t ZobristEnPassant[FILE_NB];
 
 // Global table for Zobrist Castling hashes
-extern hashkey_t ZobristCastling[CASTLING_NB];
+extern TABLE_CONST hashkey_t ZobristCastling[CASTLING_NB];
 
 // Global value for Zobrist STM hash
-extern hashkey_t ZobristSideToMove;
-
-void zobrist_init(void);
+extern TABLE_CONST hashkey_t ZobristSideToMove;
 
 #endif // HASHKEY_H
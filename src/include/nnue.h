@@ -0,0 +1,115 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NNUE_H
+#define NNUE_H
+
+#include "bitboard.h"
+#include "types.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// The network uses HalfKP features: for each perspective, the King square
+// (mirrored vertically for Black) combined with the square and relative color
+// of every non-King piece. The feature transformer outputs NNUE_HIDDEN values
+// per perspective, which are clipped and fed to a single int8 output layer.
+enum
+{
+    NNUE_KING_SQUARES = SQUARE_NB,
+    NNUE_PIECE_INDEXES = 10,
+    NNUE_INPUTS = NNUE_KING_SQUARES * NNUE_PIECE_INDEXES * SQUARE_NB,
+    NNUE_HIDDEN = 256,
+
+    // Quantization constants: the accumulator is clipped to [0, NnueQA], the
+    // output weights are scaled by NnueQB, and the final sum is converted to
+    // centipawns with NnueOutputScale.
+    NnueQA = 127,
+    NnueQB = 64,
+    NnueOutputScale = 400
+};
+
+// Struct for the feature transformer state of a given position
+typedef struct _NnueAccumulator
+{
+    int16_t values[COLOR_NB][NNUE_HIDDEN];
+    bool computed[COLOR_NB];
+} NnueAccumulator;
+
+// Struct for the list of pieces changed by the last move, used to update the
+// accumulator lazily. A SQ_NONE origin means the piece was added, a SQ_NONE
+// destination means it was removed.
+typedef struct _DirtyPieces
+{
+    int count;
+    piece_t piece[3];
+    square_t from[3];
+    square_t to[3];
+} DirtyPieces;
+
+// Struct for a cached accumulator of a given King square, along with the
+// piece placement it was computed for
+typedef struct _NnueFinnyEntry
+{
+    int16_t values[NNUE_HIDDEN];
+    bitboard_t pieces[COLOR_NB][PIECETYPE_NB];
+} NnueFinnyEntry;
+
+// Struct for the per-worker accumulator cache, indexed by perspective and King
+// square. Full refreshes only apply the difference between the cached piece
+// placement and the current one.
+typedef struct _NnueFinnyTable
+{
+    int generation;
+    NnueFinnyEntry entries[COLOR_NB][SQUARE_NB];
+} NnueFinnyTable;
+
+struct _Board;
+
+// Set to true when the network evaluation is selected and a network is loaded.
+extern bool NnueEnabled;
+
+// Selects the network kernels for the running CPU in fat builds.
+void nnue_init_kernels(void);
+
+// Loads the network file at the given path. Returns false on failure, in
+// which case the previously loaded network (if any) is kept.
+bool nnue_load(const char *path);
+
+// Unloads the current network and disables the network evaluation.
+void nnue_unload(void);
+
+// Returns true if a network is currently loaded.
+bool nnue_is_loaded(void);
+
+// Marks all entries of the given cache as stale.
+void nnue_finny_reset(NnueFinnyTable *table);
+
+// Evaluates the position with the network, updating the accumulators of the
+// board stack if needed.
+score_t nnue_evaluate(const struct _Board *board);
+
+// Records a piece change for the next accumulator update.
+INLINED void dirty_pieces_add(DirtyPieces *dp, piece_t piece, square_t from, square_t to)
+{
+    dp->piece[dp->count] = piece;
+    dp->from[dp->count] = from;
+    dp->to[dp->count] = to;
+    dp->count++;
+}
+
+#endif // NNUE_H
@@ -0,0 +1,53 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NNUE_KERNELS_H
+#define NNUE_KERNELS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The vectorized parts of the network evaluation. Fat builds compile them once
+// per instruction set, and select the best variant for the running CPU at
+// startup.
+
+#define NNUE_KERNEL_NAME_(name, suffix) name##suffix
+#define NNUE_KERNEL_NAME(name, suffix) NNUE_KERNEL_NAME_(name, suffix)
+
+// Declares the kernels for the given function name suffix:
+// - nnue_accumulator_apply computes dst = src + sum(added rows) - sum(removed
+//   rows) for the given feature transformer weights. The source and
+//   destination may be the same;
+// - nnue_output_dot computes the dot product between the clipped accumulator
+//   values and the given output weights.
+#define DECLARE_NNUE_KERNELS(suffix)                                                            \
+    void NNUE_KERNEL_NAME(nnue_accumulator_apply, suffix)(int16_t *dst, const int16_t *src,     \
+        const int16_t *weights, const size_t *added, int addCount, const size_t *removed,       \
+        int removeCount);                                                                       \
+    int32_t NNUE_KERNEL_NAME(nnue_output_dot, suffix)(                                          \
+        const int16_t *restrict values, const int8_t *restrict weights);
+
+DECLARE_NNUE_KERNELS()
+
+#ifdef USE_DISPATCH
+DECLARE_NNUE_KERNELS(_avx2)
+DECLARE_NNUE_KERNELS(_avx512)
+DECLARE_NNUE_KERNELS(_vnni512)
+#endif
+
+#endif // NNUE_KERNELS_H
@@ -32,12 +32,41 @@ typedef struct _PawnEntry
     scorepair_t value;
 } PawnEntry;
 
+// Struct for King Pawn shelter/storm data
+typedef struct _KingPawnEntry
+{
+    hashkey_t key;
+    scorepair_t safety[COLOR_NB];
+} KingPawnEntry;
+
 enum
 {
-    PawnTableSize = 1 << 15
+    PawnTableSize = 1 << 15,
+    KingPawnTableSize = 1 << 14
 };
 
+// Struct for the Pawn hash table shared by all workers. In the shared table,
+// the key of each entry is stored xored with a checksum of the entry
+// contents, so that entries written concurrently by multiple workers fail
+// the key verification.
+typedef struct _SharedPawnTable
+{
+    size_t entryCount;
+    PawnEntry *table;
+} SharedPawnTable;
+
+// Global shared Pawn hash table. When not allocated, each worker uses its own
+// Pawn hash table instead.
+extern SharedPawnTable SearchPawnTable;
+
 // Probes the pawn hash table for the given position.
 PawnEntry *pawn_probe(const Board *board);
 
+// Resizes the shared Pawn hash table. A size of zero switches back to
+// per-worker tables.
+void pawn_table_resize(size_t mbsize);
+
+// Resets the shared Pawn hash table contents.
+void pawn_table_clear(void);
+
 #endif
@@ -0,0 +1,119 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "types.h"
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+// Enum for the hot-path functions timed in profiling builds. PROF_SEARCH spans
+// the whole search of a worker, and thus collects the time spent outside of
+// all other profiled functions.
+enum
+{
+    PROF_SEARCH,
+    PROF_EVALUATE,
+    PROF_PAWN_PROBE,
+    PROF_GENERATE,
+    PROF_SEE,
+    PROF_TT_PROBE,
+    PROF_DO_MOVE,
+    PROF_NEXT_MOVE,
+    PROF_COUNT
+};
+
+// Struct for the profiling counters of a thread. Cycles are exclusive: the
+// time spent in nested profiled functions is only counted for the innermost
+// one, so that all entries sum to the total profiled time.
+typedef struct _ProfileData
+{
+    uint64_t cycles[PROF_COUNT];
+    uint64_t calls[PROF_COUNT];
+    uint64_t nodes;
+} ProfileData;
+
+#ifdef PROFILE
+
+// Struct for a profiled function call in progress.
+typedef struct _ProfileScope
+{
+    int id;
+    uint64_t start;
+    uint64_t childCycles;
+    struct _ProfileScope *parent;
+} ProfileScope;
+
+extern _Thread_local ProfileData *ThreadProfile;
+extern _Thread_local ProfileScope *ThreadScope;
+
+// Returns a timestamp in cycles (or nanoseconds on non-x86 platforms).
+INLINED uint64_t profile_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec tp;
+
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (uint64_t)tp.tv_sec * 1000000000 + (uint64_t)tp.tv_nsec;
+#endif
+}
+
+INLINED void profile_scope_begin(ProfileScope *scope, int id)
+{
+    scope->id = id;
+    scope->childCycles = 0;
+    scope->parent = ThreadScope;
+    ThreadScope = scope;
+    scope->start = profile_clock();
+}
+
+INLINED void profile_scope_end(ProfileScope *scope)
+{
+    const uint64_t elapsed = profile_clock() - scope->start;
+
+    ThreadProfile->cycles[scope->id] += elapsed - scope->childCycles;
+    ThreadProfile->calls[scope->id]++;
+
+    if (scope->parent) scope->parent->childCycles += elapsed;
+
+    ThreadScope = scope->parent;
+}
+
+// Times the enclosing function until it returns.
+#define PROFILE_SCOPE(id)                                                  \
+    ProfileScope profileScope __attribute__((cleanup(profile_scope_end))); \
+    profile_scope_begin(&profileScope, (id))
+
+#else
+
+#define PROFILE_SCOPE(id) ((void)0)
+
+#endif
+
+// Prints the per-function cycle breakdown of the given profile.
+void profile_print(const ProfileData *profile, const char *name);
+
+#endif // PROFILE_H
@@ -0,0 +1,78 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RELAY_H
+#define RELAY_H
+
+#include "hashkey.h"
+#include "types.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+// A relay lets several engine processes work on a single analysis. The leader
+// process listens on a transport address (see transport.h), and forwards its
+// searches to the member processes connected to it. During the search, all
+// nodes exchange their high-depth TT entries through the leader (see the
+// ClusterDepth option), and members periodically report their progress. On
+// the same machine, members can also use a shared hashtable instead (see the
+// SharedHashName option). When the leader's search ends, it stops all members
+// and collects their results.
+
+// Minimal depth of the TT entries shared with the other nodes, or 0 if we're
+// not part of a relay.
+extern int RelayShareDepth;
+
+// Starts accepting member processes on the given address.
+bool relay_serve(const char *address);
+
+// Connects to the leader listening on the given address, and executes all
+// commands received from it until the connection is closed.
+void relay_join(const char *address);
+
+// Closes all relay connections.
+void relay_close(void);
+
+// Records the arguments of the last "position" command, sent to members along
+// with each search.
+void relay_set_position(const char *args);
+
+// Sets up TT sharing for the new search. On the leader side, also starts an
+// infinite search on all members.
+void relay_start_search(void);
+
+// Queues a TT entry to be sent to the other nodes.
+void relay_share_entry(
+    hashkey_t key, score_t score, score_t eval, int depth, int bound, move_t move);
+
+// Member side: records the last completed iteration of the search, which is
+// periodically reported to the leader.
+void relay_update_progress(int depth, score_t score, const char *bestmove);
+
+// Leader side: returns the last reported node count of all members.
+uint64_t relay_member_nodes(void);
+
+// Leader side: stops the search of all members, and reports their results
+// along with the cluster-wide depth, node count and speed, given the
+// statistics of our own search.
+void relay_collect_results(uint64_t nodes, int depth, clock_t elapsed);
+
+// Member side: sends the result of the finished search to the leader.
+void relay_report(const char *bestmove, score_t score, int depth, uint64_t nodes);
+
+#endif // RELAY_H
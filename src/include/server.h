@@ -0,0 +1,48 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdbool.h>
+
+// Server mode lets a single engine process host many independent UCI
+// sessions, which share the hashtable and the worker pool. Clients connect to
+// a transport address (see transport.h), and prefix each command with a
+// session identifier of their choice, for example "game42 position startpos".
+// All output of a session is sent back with the same prefix. Each session has
+// its own position, search limits, thread count and display options.
+//
+// Sessions search concurrently: each search borrows a slice of the free
+// workers of the pool, and has its own search state. Searches wait in a queue
+// while all workers are busy, and the time spent waiting is charged to the
+// clock of the sessions searching with wtime/btime.
+
+// Starts serving sessions on the given address.
+bool server_start(const char *address);
+
+// Stops all running searches, and closes all sessions.
+void server_close(void);
+
+// Runs a command received outside of the server while it is active: search
+// commands are refused, and commands changing the shared state wait for the
+// running searches to end. Returns false if the caller should run the command
+// itself.
+bool server_run_command(const char *name, void (*call)(const char *), const char *args);
+
+#endif // SERVER_H
@@ -0,0 +1,80 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SYZYGY_H
+#define SYZYGY_H
+
+#include "board.h"
+#include "types.h"
+#include "worker.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+enum
+{
+    TB_MAX_PIECES = 7,
+
+    // WDL results relative to the side to move. Cursed wins and blessed
+    // losses are wins and losses which are drawn by the 50-move rule.
+    TB_LOSS = -2,
+    TB_BLESSED_LOSS = -1,
+    TB_DRAW = 0,
+    TB_CURSED_WIN = 1,
+    TB_WIN = 2,
+
+    // Probe results
+    TB_FAIL = 0,
+    TB_OK = 1,
+    TB_CHANGE_STM = -1,        // DTZ table stores the other side to move
+    TB_ZEROING_BEST_MOVE = 2,  // Best move zeroes the 50-move counter
+
+    TB_MAX_DTZ = 1 << 18
+};
+
+// Largest number of pieces covered by the loaded tables.
+extern int TbMaxCardinality;
+
+// Looks for tablebase files in the given list of directories (separated by ':',
+// or ';' on Windows), and registers all found tables. Files are only mapped
+// the first time they are probed.
+void tb_init(const char *paths);
+
+// Unmaps and unregisters all tables.
+void tb_free(void);
+
+// Probes the WDL tables for the given position. The position must not have
+// castling rights. On failure, *result is set to TB_FAIL.
+int tb_probe_wdl(Board *board, int *result);
+
+// Probes the DTZ tables for the given position, returning the distance to the
+// next zeroing move in plies (positive for wins, negative for losses, and off
+// by 100 for results drawn by the 50-move rule). On failure, *result is set to
+// TB_FAIL.
+int tb_probe_dtz(Board *board, int *result);
+
+// Ranks the root moves using the DTZ tables (or the WDL tables as a fallback),
+// and only keeps the best ranked ones. Also sets the search-time probing
+// settings of the given pool from its Syzygy options.
+void tb_rank_root_moves(WorkerPool *wpool, Board *board, RootMove *rootMoves, size_t *rootCount);
+
+// Checks the tables of the given material class (e.g. "KRvKP") on the given
+// number of random positions: WDL and DTZ results must agree with the best
+// results one ply deeper, and WDL results with the bitbases if loaded.
+void tb_check(const char *name, size_t count);
+
+#endif // SYZYGY_H
@@ -40,6 +40,19 @@ INLINED clock_t chess_clock(void)
 #endif
 }
 
+// Returns a monotonic timestamp in microseconds, used for profiling.
+INLINED uint64_t micro_clock(void)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    return (uint64_t)chess_clock() * 1000;
+#else
+    struct timespec tp;
+
+    clock_gettime(CLOCK_MONOTONIC, &tp);
+    return (uint64_t)tp.tv_sec * 1000000 + (uint64_t)tp.tv_nsec / 1000;
+#endif
+}
+
 // Enum for the type of bestmove
 typedef enum bestmove_type_e
 {
@@ -96,20 +109,24 @@ void timeman_init(const Board *board, Timeman *tm, SearchParams *params, clock_t
 // Updates the time management based on the current bestmove and score.
 void timeman_update(Timeman *tm, const Board *board, move_t bestmove, score_t score);
 
-// Checks time usage periodically.
-void check_time(void);
+// Checks the time usage of the pool's search periodically.
+void check_time(WorkerPool *wpool);
 
-// Checks if we can safely stop the search.
-INLINED bool timeman_can_stop_search(Timeman *tm, clock_t cur)
+// Checks if we can safely stop the pool's search.
+INLINED bool timeman_can_stop_search(const WorkerPool *wpool, clock_t cur)
 {
-    if (tm->pondering && wpool_is_pondering(&SearchWorkerPool)) return false;
+    const Timeman *tm = wpool->timeman;
+
+    if (tm->pondering && wpool_is_pondering(wpool)) return false;
     return tm->mode != NoTimeman && cur >= tm->start + tm->optimalTime;
 }
 
-// Checks if we must stop the search.
-INLINED bool timeman_must_stop_search(Timeman *tm, clock_t cur)
+// Checks if we must stop the pool's search.
+INLINED bool timeman_must_stop_search(const WorkerPool *wpool, clock_t cur)
 {
-    if (tm->pondering && wpool_is_pondering(&SearchWorkerPool)) return false;
+    const Timeman *tm = wpool->timeman;
+
+    if (tm->pondering && wpool_is_pondering(wpool)) return false;
     return tm->mode != NoTimeman && cur >= tm->start + tm->maximalTime;
 }
 
@@ -0,0 +1,59 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Stream transports used for communicating between engine processes.
+// Addresses are either "tcp:<host>:<port>", or a Unix socket path optionally
+// prefixed with "unix:". All messages are text lines.
+
+// Opens a socket listening on the given address. Returns -1 on failure.
+int transport_listen(const char *address);
+
+// Opens a connection to the given address. Returns -1 on failure.
+int transport_connect(const char *address);
+
+// Waits for a connection on the given listening socket, and returns the
+// connected socket. Returns -1 once the listening socket is closed.
+int transport_accept(int fd);
+
+// Shuts down and closes the given socket.
+void transport_close(int fd);
+
+// Releases the resources associated with a listening address.
+void transport_cleanup(const char *address);
+
+// Waits at most the given time in milliseconds for data to be readable on any
+// of the given sockets (including complete lines already buffered), and marks
+// the readable ones. Returns the number of readable sockets.
+int transport_poll(const int *fds, bool *ready, size_t count, int timeout);
+
+// Sends the given message. Returns false if the connection is lost.
+bool transport_send(int fd, const char *message);
+
+// Reads a line, waiting at most the given time in milliseconds for more data
+// (or indefinitely if negative). Data is read in blocks and buffered until
+// the socket is closed with transport_close(). Returns false on timeout or
+// disconnection.
+bool transport_read_line(int fd, char *buffer, size_t size, int timeout);
+
+#endif // TRANSPORT_H
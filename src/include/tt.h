@@ -21,6 +21,7 @@
 
 #include "hashkey.h"
 #include "types.h"
+#include <stdatomic.h>
 #include <string.h>
 
 // Struct for TT entry
@@ -45,12 +46,26 @@ typedef struct _TT_Cluster
     TT_Entry clEntry[ClusterSize];
 } TT_Cluster;
 
-// Struct for the transposition table
+// Header stored in front of a shared table, padded to a full cluster so that
+// the clusters stay aligned.
+typedef union _TT_SharedHeader
+{
+    _Atomic uint8_t generation;
+    TT_Cluster padding;
+} TT_SharedHeader;
+
+// Struct for the transposition table. A shared table is mapped from a named
+// POSIX shared memory segment, so that several processes can use it at once.
+// The generation then lives in the segment header, so that all processes age
+// the entries together.
 typedef struct _TranspositionTable
 {
     size_t clusterCount;
     TT_Cluster *table;
-    uint8_t generation;
+    _Atomic uint8_t *generation;
+    _Atomic uint8_t localGeneration;
+    bool shared;
+    bool sharedOwner;
 } TranspositionTable;
 
 // Global transposition table
@@ -62,8 +77,17 @@ INLINED TT_Entry *tt_entry_at(hashkey_t k)
     return SearchTT.table[mul_hi64(k, SearchTT.clusterCount)].clEntry;
 }
 
+// Returns the current TT generation.
+INLINED uint8_t tt_generation(void)
+{
+    return atomic_load_explicit(SearchTT.generation, memory_order_relaxed);
+}
+
 // Updates the TT generation.
-INLINED void tt_clear(void) { SearchTT.generation += 4; }
+INLINED void tt_clear(void)
+{
+    atomic_fetch_add_explicit(SearchTT.generation, 4, memory_order_relaxed);
+}
 
 // Converts a score to a TT score.
 INLINED score_t score_to_tt(score_t s, int plies)
@@ -77,7 +101,8 @@ INLINED score_t score_from_tt(score_t s, int plies)
     return s >= MATE_FOUND ? s - plies : s <= -MATE_FOUND ? s + plies : s;
 }
 
-// Resets the TT contents.
+// Resets the TT contents. Shared tables are only reset by the process which
+// created them.
 void tt_bzero(size_t threadCount);
 
 // Probes the TT for the given hashkey.
@@ -89,7 +114,9 @@ void tt_save(TT_Entry *entry, hashkey_t k, score_t s, score_t e, int d, int b, m
 // Returns the filling rate of the TT (per mil).
 int tt_hashfull(void);
 
-// Resizes the TT.
+// Resizes the TT. If the SharedHashName option is set, the TT is mapped from the
+// shared memory segment of that name, which is created if needed. Processes
+// joining an existing segment use its size instead of the given one.
 void tt_resize(size_t mbsize);
 
 #endif // TT_H
@@ -21,6 +21,7 @@
 
 #include "evaluate.h"
 #include <stddef.h>
+#include <stdio.h>
 
 #ifdef TUNE
 
@@ -61,6 +62,14 @@ typedef struct tune_data_s
     size_t maxSize;
 } tune_data_t;
 
+typedef struct tune_loader_s
+{
+    const PackedBoard *records;
+    tune_entry_t *entries;
+    size_t count;
+    size_t loaded;
+} tune_loader_t;
+
 typedef int tp_array_t[IDX_COUNT];
 typedef double tp_vector_t[IDX_COUNT][2];
 
@@ -72,6 +81,8 @@ void start_tuning_session(const char *filename);
 
 void init_base_values(tp_vector_t base);
 void init_tuner_entries(tune_data_t *data, const char *filename);
+void init_packed_entries(tune_data_t *data, FILE *f);
+void *init_packed_slice(void *ptr);
 bool init_tuner_entry(tune_entry_t *entry, const Board *board);
 void init_tuner_tuples(tune_entry_t *entry);
 double compute_optimal_k(const tune_data_t *data);
@@ -27,6 +27,15 @@
 
 #define INLINED static inline
 
+// Precomputed tables are emitted as constant data at build time by the table
+// generator (see tools/tablegen.c), which is the only place writing to them.
+
+#ifdef TABLEGEN
+#define TABLE_CONST
+#else
+#define TABLE_CONST const
+#endif
+
 // API for basic integer operations.
 
 INLINED int imax(int a, int b) { return a > b ? a : b; }
@@ -149,7 +158,7 @@ enum
 
 // clang-format on
 
-extern int SquareDistance[SQUARE_NB][SQUARE_NB];
+extern TABLE_CONST int SquareDistance[SQUARE_NB][SQUARE_NB];
 
 INLINED file_t sq_file(square_t square) { return square & 7; }
 
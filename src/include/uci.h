@@ -24,6 +24,7 @@
 #include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <time.h>
 
 // Small trick to detect if the system is 64-bit or 32-bit.
@@ -39,17 +40,32 @@ typedef uint32_t info_t;
 #define MAX_HASH 2048
 #endif
 
+#define UCI_VERSION "v35.31"
+
 typedef struct _OptionFields
 {
     long threads;
     long hash;
     long moveOverhead;
     long multiPv;
+    long sharedPawnHash;
+    long syzygyProbeDepth;
+    long syzygyProbeLimit;
+    long clusterDepth;
     bool chess960;
     bool ponder;
     bool debug;
     bool showWDL;
     bool normalizeScore;
+    bool useNnue;
+    bool syzygy50MoveRule;
+    bool abdada;
+    bool helperDepthSkip;
+    bool helperDiversity;
+    char *evalFile;
+    char *bitbasePath;
+    char *syzygyPath;
+    char *sharedHashName;
 } OptionFields;
 
 extern pthread_attr_t WorkerSettings;
@@ -65,25 +81,46 @@ typedef struct _CommandMap
 char *get_next_token(char **str);
 
 const char *move_to_str(move_t move, bool isChess960);
-const char *score_to_str(score_t score);
+const char *score_to_str(score_t score, bool normalize);
 move_t str_to_move(const Board *board, const char *str);
 
+// Sets the given board to the position described by the arguments of a
+// "position" command.
+void uci_parse_position(Board *board, const char *args, bool isChess960);
+
+struct _SearchParams;
+
+// Reads the search limits and the root moves to search from the arguments of
+// a "go" command.
+void uci_parse_go(
+    const Board *board, const char *args, struct _SearchParams *params, Movelist *searchMoves);
+
 // Displays the formatted content while in debug mode.
 int debug_printf(const char *fmt, ...);
 
 // The list of supported commands by the engine.
+void uci_analyse(const char *args);
 void uci_bench(const char *args);
+void uci_bitbase(const char *args);
+void uci_convert(const char *args);
 void uci_d(const char *args);
+void uci_datagen(const char *args);
 void uci_debug(const char *args);
 void uci_go(const char *args);
 void uci_isready(const char *args);
 void uci_ponderhit(const char *args);
 void uci_position(const char *args);
 void uci_quit(const char *args);
+void uci_relay(const char *args);
+void uci_server(const char *args);
 void uci_setoption(const char *args);
 void uci_stop(const char *args);
+void uci_tbcheck(const char *args);
 void uci_uci(const char *args);
 void uci_ucinewgame(const char *args);
 void uci_loop(int argc, char **argv);
 
+// Executes the given command, and returns 0 if the engine should quit.
+int execute_uci_cmd(const char *command);
+
 #endif
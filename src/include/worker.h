@@ -20,11 +20,15 @@
 #define WORKER_H
 
 #include "board.h"
+#include "evaluate.h"
 #include "history.h"
+#include "movelist.h"
 #include "pawns.h"
+#include "profile.h"
 #include "uci.h"
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stdio.h>
 #include <time.h>
 
 // Struct for search params.
@@ -55,6 +59,8 @@ typedef struct _RootMove
     int seldepth;
     score_t prevScore;
     score_t score;
+    int tbRank;
+    score_t tbScore;
     move_t pv[512];
 } RootMove;
 
@@ -63,6 +69,40 @@ RootMove *find_root_move(RootMove *begin, RootMove *end, move_t move);
 void print_pv(
     const Board *board, RootMove *rootMove, int multiPv, int depth, clock_t time, int bound);
 
+// Struct for search statistics, only collected in builds with SEARCH_STATS
+// defined. All fields are plain counters so that they can be summed easily.
+
+typedef struct _SearchStats
+{
+    uint64_t ttProbes;
+    uint64_t ttHits;
+    uint64_t ttCutoffs;
+    uint64_t nmpTries;
+    uint64_t nmpCutoffs;
+    uint64_t probcutCutoffs;
+    uint64_t singularSearches;
+    uint64_t singularExtensions;
+    uint64_t multicuts;
+    uint64_t lmrSearches;
+    uint64_t lmrResearches;
+    uint64_t betaCutoffs;
+    uint64_t firstMoveCutoffs;
+    uint64_t qsearchNodes;
+    uint64_t expandedNodes;
+    uint64_t searchedMoves;
+} SearchStats;
+
+#ifdef SEARCH_STATS
+#define STAT_ADD(worker, field, value) ((worker)->stats.field += (value))
+#else
+#define STAT_ADD(worker, field, value) ((void)0)
+#endif
+
+#define STAT_INC(worker, field) STAT_ADD(worker, field, 1)
+
+void search_stats_merge(SearchStats *restrict dst, const SearchStats *restrict src);
+void search_stats_print(const SearchStats *stats, uint64_t nodes, FILE *stream);
+
 // Struct for worker thread data.
 
 typedef struct _Worker
@@ -74,22 +114,43 @@ typedef struct _Worker
     countermove_history_t cmHistory;
     capture_history_t capHistory;
     PawnEntry *pawnTable;
+    PawnEntry pawnScratch;
+    KingPawnEntry *kingPawnTable;
+    EvalCacheEntry *evalCache;
+    NnueFinnyTable finnyTable;
 
     int seldepth;
     int rootDepth;
+    int completedDepth;
+    int lmrBias;
+    int lmpBias;
     int verifPlies;
     _Atomic uint64_t nodes;
+    _Atomic uint64_t tbHits;
+    uint64_t evalCacheProbes;
+    uint64_t evalCacheHits;
+    uint64_t pawnProbes;
+    uint64_t pawnHits;
+#ifdef SEARCH_STATS
+    SearchStats stats;
+#endif
+#ifdef PROFILE
+    ProfileData profile;
+#endif
 
     RootMove *rootMoves;
     size_t rootCount;
     int pvLine;
 
     size_t idx;
+    struct _WorkerPool *pool; // Pool the worker currently searches for
     pthread_t thread;
     pthread_mutex_t mutex;
     pthread_cond_t condVar;
     bool exit;
     bool searching;
+    bool standalone;
+    bool stopped; // Set when a standalone worker exhausts its node budget
 } Worker;
 
 INLINED Worker *get_worker(const Board *board) { return board->worker; }
@@ -108,6 +169,13 @@ void worker_start_search(Worker *worker);
 void worker_wait_search_end(Worker *worker);
 void *worker_entry(void *worker);
 
+// Maximal number of workers in the search pool.
+#define MAX_THREADS 256
+
+// Struct for a worker pool. Besides its workers, a pool holds the state of
+// the search it runs: the main pool uses the UCI globals, while the server
+// lends slices of the main pool's workers to its sessions, each slice having
+// its own search state.
 typedef struct _WorkerPool
 {
     size_t size;
@@ -117,12 +185,28 @@ typedef struct _WorkerPool
     atomic_bool stop;
 
     Worker **workerList;
+
+    SearchParams *params;
+    struct _Timeman *timeman;
+    Movelist *searchMoves;
+    const struct _OptionFields *options;
+    FILE *output;
+
+    // Tablebase settings of the current search, see tb_rank_root_moves().
+    int tbCardinality;
+    int tbProbeDepth;
+    bool tbUseRule50;
+    bool tbRootInTb;
 } WorkerPool;
 
 extern WorkerPool SearchWorkerPool;
 
 INLINED Worker *wpool_main_worker(WorkerPool *wpool) { return wpool->workerList[0]; }
 
+// Returns true for the main pool, which is the only one taking part in relay
+// searches.
+INLINED bool wpool_is_main(const WorkerPool *wpool) { return wpool == &SearchWorkerPool; }
+
 INLINED void wpool_ponderhit(WorkerPool *wpool)
 {
     atomic_store_explicit(&wpool->ponder, false, memory_order_relaxed);
@@ -143,6 +227,12 @@ INLINED bool wpool_is_stopped(const WorkerPool *wpool)
     return atomic_load_explicit(&wpool->stop, memory_order_relaxed);
 }
 
+// Returns true if the worker must abort its search.
+INLINED bool worker_is_stopped(const Worker *worker)
+{
+    return worker->stopped || wpool_is_stopped(worker->pool);
+}
+
 void wpool_init(WorkerPool *wpool, size_t threads);
 void wpool_new_search(WorkerPool *wpool);
 void wpool_reset(WorkerPool *wpool);
@@ -150,6 +240,11 @@ void wpool_start_search(
     WorkerPool *wpool, const Board *rootBoard, const SearchParams *searchParams);
 void wpool_start_workers(WorkerPool *wpool);
 void wpool_wait_search_end(WorkerPool *wpool);
+void wpool_run_standalone(WorkerPool *wpool, void (*task)(Worker *));
 uint64_t wpool_get_total_nodes(WorkerPool *wpool);
+uint64_t wpool_get_total_tbhits(WorkerPool *wpool);
+Worker *wpool_best_worker(WorkerPool *wpool);
+void wpool_get_search_stats(WorkerPool *wpool, SearchStats *stats);
+void wpool_print_profile(WorkerPool *wpool);
 
 #endif
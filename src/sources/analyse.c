@@ -0,0 +1,289 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "analyse.h"
+#include "movelist.h"
+#include "search.h"
+#include "timeman.h"
+#include "tt.h"
+#include "uci.h"
+#include <ctype.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static FILE *EpdFile;
+static size_t NextIndex;
+static uint64_t TotalNodes;
+static pthread_mutex_t AnalysisMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Reads the next non-empty line of the EPD file, along with its index.
+static bool analysis_next_line(char *line, size_t size, size_t *index)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&AnalysisMutex);
+
+    while (!found && !wpool_is_stopped(&SearchWorkerPool) && fgets(line, size, EpdFile) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        found = (line[strspn(line, Delimiters)] != '\0' && line[0] != '#');
+    }
+
+    if (found) *index = NextIndex++;
+
+    pthread_mutex_unlock(&AnalysisMutex);
+    return found;
+}
+
+bool parse_epd_line(char *line, char *fen, size_t fenSize, char *id, size_t idSize)
+{
+    char *ptr = line;
+    char *fields[4];
+
+    for (int i = 0; i < 4; ++i)
+        if ((fields[i] = get_next_token(&ptr)) == NULL) return false;
+
+    const char *rest = ptr + strspn(ptr, Delimiters);
+    const size_t rule50Length = strspn(rest, "0123456789");
+    const char *next = rest + rule50Length + strspn(rest + rule50Length, Delimiters);
+    const size_t moveLength = strspn(next, "0123456789");
+
+    if (rule50Length && moveLength && next != rest + rule50Length
+        && (next[moveLength] == '\0' || isspace((unsigned char)next[moveLength])))
+    {
+        snprintf(fen, fenSize, "%s %s %s %s %.*s %.*s", fields[0], fields[1], fields[2],
+            fields[3], (int)rule50Length, rest, (int)moveLength, next);
+        rest = next + moveLength;
+    }
+    else
+        snprintf(fen, fenSize, "%s %s %s %s 0 1", fields[0], fields[1], fields[2], fields[3]);
+
+    const char *op = strstr(rest, "id \"");
+
+    id[0] = '\0';
+
+    if (op != NULL)
+    {
+        const char *value = op + 4;
+        size_t length = 0;
+
+        // Escape the characters which can't appear as is in JSON strings.
+        while (*value != '\0' && *value != '"' && length + 3 < idSize)
+        {
+            if (*value == '\\') id[length++] = '\\';
+
+            if (!iscntrl((unsigned char)*value)) id[length++] = *value;
+
+            ++value;
+        }
+
+        id[length] = '\0';
+    }
+
+    return true;
+}
+
+// Prints the result of the analysed position as a JSON line.
+static void analysis_report(Worker *worker, size_t index, const char *fen, const char *id)
+{
+    const RootMove *best = worker->rootMoves;
+    const uint64_t nodes = atomic_load_explicit(&worker->nodes, memory_order_relaxed);
+    char unit[8] = "cp";
+    int value = 0;
+
+    // The move and score formatting functions use static buffers, so only
+    // call them with the analysis mutex held.
+    pthread_mutex_lock(&AnalysisMutex);
+
+    TotalNodes += nodes;
+    printf("{\"index\": %zu, \"id\": \"%s\", \"fen\": \"%s\"", index, id, fen);
+
+    if (worker->rootCount == 0)
+    {
+        if (worker->board.stack->checkers) strcpy(unit, "mate");
+
+        printf(", \"depth\": 0, \"score\": {\"%s\": 0}, \"nodes\": 0, \"bestmove\": null, "
+               "\"pv\": []}\n",
+            unit);
+    }
+    else
+    {
+        sscanf(
+            score_to_str(best->prevScore, UciOptionFields.normalizeScore), "%7s %d", unit, &value);
+        printf(", \"depth\": %d, \"seldepth\": %d, \"score\": {\"%s\": %d}, \"nodes\": %" PRIu64
+               ", \"bestmove\": \"%s\", \"pv\": [",
+            worker->completedDepth, best->seldepth, unit, value, nodes,
+            move_to_str(best->move, worker->board.chess960));
+
+        for (size_t i = 0; best->pv[i]; ++i)
+            printf("%s\"%s\"", i ? ", " : "", move_to_str(best->pv[i], worker->board.chess960));
+
+        puts("]}");
+    }
+
+    fflush(stdout);
+    pthread_mutex_unlock(&AnalysisMutex);
+}
+
+static void analysis_report_error(size_t index, const char *error)
+{
+    pthread_mutex_lock(&AnalysisMutex);
+    printf("{\"index\": %zu, \"error\": \"%s\"}\n", index, error);
+    fflush(stdout);
+    pthread_mutex_unlock(&AnalysisMutex);
+}
+
+// Analyses positions from the EPD file until it is exhausted.
+static void analysis_worker_search(Worker *worker)
+{
+    char line[4096], fen[256], id[256];
+    size_t index;
+
+    while (analysis_next_line(line, sizeof(line), &index))
+    {
+        if (!parse_epd_line(line, fen, sizeof(fen), id, sizeof(id)))
+        {
+            analysis_report_error(index, "invalid EPD line");
+            continue;
+        }
+
+        Boardstack *stack = malloc(sizeof(Boardstack));
+
+        if (stack == NULL)
+        {
+            perror("Unable to allocate board stack");
+            exit(EXIT_FAILURE);
+        }
+
+        if (board_from_fen(&worker->board, fen, UciOptionFields.chess960, stack) < 0)
+        {
+            free(stack);
+            analysis_report_error(index, "invalid FEN");
+            continue;
+        }
+
+        Movelist list;
+
+        list_all(&list, &worker->board);
+        worker->board.worker = worker;
+        worker->stack = stack;
+        worker->rootCount = movelist_size(&list);
+        worker->rootMoves = malloc(sizeof(RootMove) * worker->rootCount);
+
+        if (worker->rootMoves == NULL && worker->rootCount != 0)
+        {
+            perror("Unable to allocate root moves");
+            exit(EXIT_FAILURE);
+        }
+
+        for (size_t k = 0; k < worker->rootCount; ++k)
+        {
+            RootMove *rootMove = &worker->rootMoves[k];
+
+            rootMove->move = list.moves[k].move;
+            rootMove->seldepth = 0;
+            rootMove->score = rootMove->prevScore = -INF_SCORE;
+            rootMove->tbRank = 0;
+            rootMove->tbScore = DRAW;
+            rootMove->pv[0] = rootMove->pv[1] = NO_MOVE;
+        }
+
+        atomic_store_explicit(&worker->nodes, 0, memory_order_relaxed);
+        worker->completedDepth = 0;
+
+        if (worker->rootCount) worker_search(worker);
+
+        analysis_report(worker, index, fen, id);
+        free(worker->rootMoves);
+        free_boardstack(worker->stack);
+        worker->rootMoves = NULL;
+        worker->stack = NULL;
+    }
+}
+
+void analyse_epd(const char *path, int depth)
+{
+    EpdFile = fopen(path, "r");
+
+    if (EpdFile == NULL)
+    {
+        printf("info string Unable to open '%s'\n", path);
+        fflush(stdout);
+        return;
+    }
+
+    NextIndex = 0;
+    TotalNodes = 0;
+
+    // Searches are bounded by depth only. Marking them as infinite disables
+    // the time checks of the first worker.
+    memset(&UciSearchParams, 0, sizeof(SearchParams));
+    UciSearchParams.depth = depth;
+    UciSearchParams.nodes = UINT64_MAX;
+    UciSearchParams.infinite = 1;
+    tt_clear();
+
+    const clock_t start = chess_clock();
+
+    wpool_run_standalone(&SearchWorkerPool, &analysis_worker_search);
+
+    const clock_t elapsed = chess_clock() - start;
+
+    fclose(EpdFile);
+    EpdFile = NULL;
+    printf("info string Analysed %zu positions in %.3fs (%.1f positions/s, %" PRIu64
+           " nodes/s)\n",
+        NextIndex, elapsed / 1000.0, NextIndex * 1000.0 / (elapsed + !elapsed),
+        TotalNodes * 1000 / (uint64_t)(elapsed + !elapsed));
+    fflush(stdout);
+}
+
+void uci_analyse(const char *args)
+{
+    char *copy = strdup(args ? args : "");
+
+    if (copy == NULL)
+    {
+        perror("Unable to allocate command copy");
+        exit(EXIT_FAILURE);
+    }
+
+    char *ptr = copy;
+    char *path = get_next_token(&ptr);
+    char *token = get_next_token(&ptr);
+    unsigned long depth = 0;
+
+    if (token != NULL && !strcmp(token, "depth") && (token = get_next_token(&ptr)) != NULL)
+        depth = strtoul(token, NULL, 10);
+
+    // If the depth is absent or invalid, use a default depth of 12.
+    if (depth == 0 || depth > MAX_PLIES) depth = 12;
+
+    if (path != NULL)
+        analyse_epd(path, (int)depth);
+    else
+    {
+        puts("info string Usage: analyse <file.epd> [depth <depth>]");
+        fflush(stdout);
+    }
+
+    free(copy);
+}
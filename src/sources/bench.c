@@ -88,6 +88,9 @@ void uci_bench(const char *args)
     // Initialize the overall clock here.
     clock_t benchTime = chess_clock();
     uint64_t totalNodes = 0;
+#ifdef SEARCH_STATS
+    SearchStats totalStats = {0};
+#endif
 
     for (size_t i = 0; BenchFENs[i]; ++i)
     {
@@ -110,6 +113,14 @@ void uci_bench(const char *args)
 
         // Retrieve the node counter from the worker pool structure.
         totalNodes += wpool_get_total_nodes(&SearchWorkerPool);
+
+#ifdef SEARCH_STATS
+        // Accumulate the search statistics of all positions.
+        SearchStats stats;
+
+        wpool_get_search_stats(&SearchWorkerPool, &stats);
+        search_stats_merge(&totalStats, &stats);
+#endif
     }
 
     // Stop the clock.
@@ -120,5 +131,8 @@ void uci_bench(const char *args)
     printf("TIME:  %" FMT_INFO " milliseconds\n", (info_t)benchTime);
     printf("NODES: %" FMT_INFO "\n", (info_t)totalNodes);
     printf("NPS:   %" FMT_INFO "\n", (info_t)((totalNodes * 1000) / benchTime));
+#ifdef SEARCH_STATS
+    search_stats_print(&totalStats, totalNodes, stdout);
+#endif
     fflush(stdout);
 }
@@ -0,0 +1,939 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bitbase.h"
+#include "endgame.h"
+#include "movelist.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Layout of the bitbase files: a 64-byte header, followed by the results of
+// all indexed positions, packed 4 per byte.
+typedef struct _BitbaseHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pieceCount;
+    char name[16];
+    uint64_t size;
+    char padding[24];
+} BitbaseHeader;
+
+static const char BitbaseMagic[8] = "StashBB";
+
+enum
+{
+    BitbaseVersion = 1,
+
+    // Working states of the positions during generation
+    BB_UNKNOWN = 0,
+    BB_WIN = 1,
+    BB_LOSS = 2,
+    BB_DRAW = 3,
+    BB_INVALID = 4,
+    BB_RESULT_MASK = 7,
+
+    // Set for newly resolved wins and losses whose predecessors haven't been
+    // updated yet
+    BB_NEW = 0x10,
+
+    // Set for undecided positions with a drawing capture or promotion
+    BB_DRAW_CHILD = 0x20
+};
+
+static const char PieceLetters[] = " PNBRQK";
+
+static Bitbase Bitbases[BITBASE_MAX_TABLES];
+static int BitbaseCount;
+
+// Struct for the work range of a generation thread
+typedef struct _BitbaseJob
+{
+    const Bitbase *bitbase;
+    atomic_uchar *states;
+    atomic_uchar *counts;
+    uint8_t *data;
+    size_t start;
+    size_t end;
+    size_t results[3];
+    bool progress;
+    pthread_t thread;
+} BitbaseJob;
+
+// Returns the number of possible squares for the White King in the index.
+INLINED size_t king_squares(const Bitbase *bitbase) { return bitbase->hasPawns ? 32 : 16; }
+
+// Sorts the squares of identical pieces, so that each position has a unique
+// representation.
+static void sort_identical_pieces(const Bitbase *bitbase, square_t *squares)
+{
+    for (int i = 3; i < bitbase->pieceCount; ++i)
+        for (int j = i; j > 2 && bitbase->pieces[j] == bitbase->pieces[j - 1]
+                        && squares[j] < squares[j - 1];
+             --j)
+        {
+            square_t tmp = squares[j];
+            squares[j] = squares[j - 1];
+            squares[j - 1] = tmp;
+        }
+}
+
+// Returns the index of the given position in the generation tables, which
+// don't use any symmetry.
+static size_t full_index(const Bitbase *bitbase, const square_t *squares, color_t stm)
+{
+    size_t index = 0;
+
+    for (int i = bitbase->pieceCount - 1; i >= 0; --i) index = index * SQUARE_NB + squares[i];
+
+    return index * 2 + stm;
+}
+
+static void full_decode(const Bitbase *bitbase, size_t index, square_t *squares, color_t *stm)
+{
+    *stm = index & 1;
+    index >>= 1;
+
+    for (int i = 0; i < bitbase->pieceCount; ++i)
+    {
+        squares[i] = index % SQUARE_NB;
+        index /= SQUARE_NB;
+    }
+}
+
+// Returns the index of the given position in the bitbase.
+static size_t reduced_index(const Bitbase *bitbase, const square_t *squares, color_t stm)
+{
+    square_t sq[BITBASE_MAX_PIECES];
+    square_t flip = 0;
+
+    // Mirror the position so that the White King ends on the a-d files, and
+    // on the first four ranks for pawnless positions.
+    if (sq_file(squares[0]) >= FILE_E) flip ^= FILE_H;
+
+    if (!bitbase->hasPawns && sq_rank(squares[0]) >= RANK_5) flip ^= SQ_A8;
+
+    for (int i = 0; i < bitbase->pieceCount; ++i) sq[i] = squares[i] ^ flip;
+
+    sort_identical_pieces(bitbase, sq);
+
+    size_t index = 0;
+
+    for (int i = bitbase->pieceCount - 1; i >= 1; --i) index = index * SQUARE_NB + sq[i];
+
+    index = index * king_squares(bitbase) + sq_file(sq[0]) + 4 * sq_rank(sq[0]);
+
+    return index * 2 + stm;
+}
+
+static void reduced_decode(const Bitbase *bitbase, size_t index, square_t *squares, color_t *stm)
+{
+    *stm = index & 1;
+    index >>= 1;
+
+    const size_t kingIndex = index % king_squares(bitbase);
+
+    squares[0] = create_sq(kingIndex % 4, kingIndex / 4);
+    index /= king_squares(bitbase);
+
+    for (int i = 1; i < bitbase->pieceCount; ++i)
+    {
+        squares[i] = index % SQUARE_NB;
+        index /= SQUARE_NB;
+    }
+}
+
+INLINED int bitbase_result_at(const Bitbase *bitbase, size_t index)
+{
+    return (bitbase->data[index / 4] >> (2 * (index % 4))) & 3;
+}
+
+static const Bitbase *bitbase_find_key(hashkey_t key)
+{
+    for (int i = 0; i < BitbaseCount; ++i)
+        if (Bitbases[i].materialKey == key || Bitbases[i].flippedKey == key) return &Bitbases[i];
+
+    return NULL;
+}
+
+const Bitbase *bitbase_find(const Board *board)
+{
+    return BitbaseCount ? bitbase_find_key(board->stack->materialKey) : NULL;
+}
+
+int bitbase_probe(const Bitbase *bitbase, const Board *board)
+{
+    // If the material is reversed compared to the bitbase, swap the colors
+    // and mirror the ranks of the pieces.
+    const bool flipped = board->stack->materialKey != bitbase->materialKey;
+    square_t squares[BITBASE_MAX_PIECES];
+    int count = 0;
+
+    for (int i = 0; i < bitbase->pieceCount; ++i)
+    {
+        if (i > 2 && bitbase->pieces[i] == bitbase->pieces[i - 1]) continue;
+
+        const color_t c = piece_color(bitbase->pieces[i]) ^ flipped;
+        bitboard_t b = piece_bb(board, c, piece_type(bitbase->pieces[i]));
+
+        while (b) squares[count++] = bb_pop_first_sq(&b) ^ (flipped ? SQ_A8 : 0);
+    }
+
+    const color_t stm = board->sideToMove ^ flipped;
+
+    return bitbase_result_at(bitbase, reduced_index(bitbase, squares, stm));
+}
+
+score_t bitbase_evaluate(const Board *board)
+{
+    const int result = bitbase_probe(board->stack->bitbase, board);
+
+    if (result == BITBASE_DRAW) return 0;
+
+    const color_t winningSide =
+        (result == BITBASE_WIN) ? board->sideToMove : not_color(board->sideToMove);
+    const color_t losingSide = not_color(winningSide);
+    const square_t winningKsq = get_king_square(board, winningSide);
+    const square_t losingKsq = get_king_square(board, losingSide);
+    score_t score =
+        VICTORY + board->stack->material[winningSide] - board->stack->material[losingSide];
+
+    // Push the losing King to the edge, and bring the winning King closer to
+    // it to help the search find the mating net.
+    score += edge_bonus(losingKsq) + close_bonus(winningKsq, losingKsq);
+
+    // Give a bonus for advanced Pawns of the winning side to help making
+    // progress towards a promotion.
+    for (bitboard_t b = piece_bb(board, winningSide, PAWN); b;)
+        score += 8 * relative_sq_rank(bb_pop_first_sq(&b), winningSide);
+
+    return winningSide == board->sideToMove ? score : -score;
+}
+
+// Fills the bitbase specifications from the piece counts of each side.
+static void bitbase_setup(Bitbase *bitbase, int counts[COLOR_NB][PIECETYPE_NB])
+{
+    char *name = bitbase->name;
+
+    memset(bitbase, 0, sizeof(Bitbase));
+    bitbase->pieces[bitbase->pieceCount++] = WHITE_KING;
+    bitbase->pieces[bitbase->pieceCount++] = BLACK_KING;
+
+    for (color_t c = WHITE; c <= BLACK; ++c)
+    {
+        if (c == BLACK) *name++ = 'v';
+
+        *name++ = 'K';
+
+        for (piecetype_t pt = QUEEN; pt >= PAWN; --pt)
+            for (int i = 0; i < counts[c][pt]; ++i) *name++ = PieceLetters[pt];
+
+        for (piecetype_t pt = PAWN; pt <= QUEEN; ++pt)
+            for (int i = 0; i < counts[c][pt]; ++i)
+                bitbase->pieces[bitbase->pieceCount++] = create_piece(c, pt);
+
+        // Compute the material keys, with the same layout as in set_boardstack().
+        for (piecetype_t pt = PAWN; pt <= KING; ++pt)
+        {
+            const int count = (pt == KING) ? 1 : counts[c][pt];
+
+            for (int i = 0; i < count; ++i)
+            {
+                bitbase->materialKey ^= ZobristPsq[create_piece(c, pt)][i];
+                bitbase->flippedKey ^= ZobristPsq[create_piece(not_color(c), pt)][i];
+            }
+        }
+    }
+
+    bitbase->hasPawns = counts[WHITE][PAWN] + counts[BLACK][PAWN] != 0;
+    bitbase->size = 2 * king_squares(bitbase);
+
+    for (int i = 1; i < bitbase->pieceCount; ++i) bitbase->size *= SQUARE_NB;
+}
+
+// Parses a material class like "KRPvKR" into piece counts.
+static bool bitbase_parse(const char *name, int counts[COLOR_NB][PIECETYPE_NB])
+{
+    int pieceCount = 0;
+    color_t c = WHITE;
+
+    memset(counts, 0, sizeof(int) * COLOR_NB * PIECETYPE_NB);
+
+    if (toupper((unsigned char)*name) != 'K') return false;
+
+    for (++name; *name; ++name)
+    {
+        const char letter = toupper((unsigned char)*name);
+        const char *ptr = strchr(PieceLetters + PAWN, letter);
+
+        // Switch to the Black pieces when reaching the "vK" separator.
+        if (letter == 'V' && c == WHITE && toupper((unsigned char)name[1]) == 'K')
+        {
+            c = BLACK;
+            ++name;
+        }
+        else if (ptr != NULL && letter != 'K' && letter != ' ')
+        {
+            counts[c][ptr - PieceLetters]++;
+            ++pieceCount;
+        }
+        else
+            return false;
+    }
+
+    return c == BLACK && pieceCount + 2 <= BITBASE_MAX_PIECES;
+}
+
+// Places the pieces of the given position on the board, and returns false if
+// the position is illegal or doesn't have a unique representation.
+static bool bitbase_set_board(Board *restrict board, Boardstack *restrict stack,
+    const Bitbase *restrict bitbase, const square_t *restrict squares, color_t stm)
+{
+    memset(board, 0, sizeof(Board));
+    memset(stack, 0, sizeof(Boardstack));
+
+    for (int i = 0; i < bitbase->pieceCount; ++i)
+    {
+        const piece_t piece = bitbase->pieces[i];
+
+        if (!empty_square(board, squares[i])) return false;
+
+        if (piece_type(piece) == PAWN
+            && (sq_rank(squares[i]) == RANK_1 || sq_rank(squares[i]) == RANK_8))
+            return false;
+
+        if (i > 2 && piece == bitbase->pieces[i - 1] && squares[i] < squares[i - 1]) return false;
+
+        put_piece(board, piece, squares[i]);
+    }
+
+    board->sideToMove = stm;
+    board->stack = stack;
+    stack->enPassantSquare = SQ_NONE;
+
+    // Check that the King of the opposite side isn't in check.
+    if (attackers_to(board, get_king_square(board, not_color(stm))) & color_bb(board, stm))
+        return false;
+
+    set_boardstack(board, stack);
+    return true;
+}
+
+// Returns the result of the position reached after a capture or a promotion,
+// relative to the side to move.
+static int bitbase_child_result(const Board *board)
+{
+    if (board->stack->bitbase != NULL) return bitbase_probe(board->stack->bitbase, board);
+
+    // Only bare Kings are left on the board.
+    return BITBASE_DRAW;
+}
+
+// Classifies all positions from the results of their captures and
+// promotions, and counts the remaining moves for the backward propagation.
+static void *bitbase_init_thread(void *data)
+{
+    BitbaseJob *job = data;
+    const Bitbase *bitbase = job->bitbase;
+    square_t squares[BITBASE_MAX_PIECES];
+    color_t stm;
+    Board board;
+    Boardstack stack, next;
+    Movelist list;
+
+    for (size_t index = job->start; index < job->end; ++index)
+    {
+        full_decode(bitbase, index, squares, &stm);
+
+        if (!bitbase_set_board(&board, &stack, bitbase, squares, stm))
+        {
+            atomic_store_explicit(&job->states[index], BB_INVALID, memory_order_relaxed);
+            continue;
+        }
+
+        uint8_t state = BB_UNKNOWN;
+        int count = 0;
+
+        list_all(&list, &board);
+
+        for (const ExtendedMove *m = movelist_begin(&list); m < movelist_end(&list); ++m)
+        {
+            // Moves that don't change the material are handled during the
+            // propagation.
+            if (!is_capture_or_promotion(&board, m->move))
+            {
+                ++count;
+                continue;
+            }
+
+            do_move(&board, m->move, &next);
+
+            const int result = bitbase_child_result(&board);
+
+            undo_move(&board, m->move);
+
+            if (result == BITBASE_LOSS)
+            {
+                state = BB_WIN | BB_NEW;
+                break;
+            }
+
+            if (result == BITBASE_DRAW) state |= BB_DRAW_CHILD;
+        }
+
+        if (state == BB_UNKNOWN || state == BB_DRAW_CHILD)
+        {
+            // Checkmates and stalemates.
+            if (movelist_size(&list) == 0)
+                state = board.stack->checkers ? BB_LOSS | BB_NEW : BB_DRAW;
+
+            // All moves change the material and none of them is winning.
+            else if (count == 0)
+                state = (state & BB_DRAW_CHILD) ? BB_DRAW : BB_LOSS | BB_NEW;
+        }
+
+        atomic_store_explicit(&job->states[index], state, memory_order_relaxed);
+        atomic_store_explicit(&job->counts[index], (uint8_t)count, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+// Updates the predecessor of a newly resolved position.
+static void bitbase_update_parent(
+    atomic_uchar *restrict states, atomic_uchar *restrict counts, size_t index, int childResult)
+{
+    unsigned char state = atomic_load_explicit(&states[index], memory_order_relaxed);
+
+    if ((state & BB_RESULT_MASK) != BB_UNKNOWN) return;
+
+    // The side to move can reach a lost position for the opponent: this is a
+    // win.
+    if (childResult == BB_LOSS)
+    {
+        while ((state & BB_RESULT_MASK) == BB_UNKNOWN
+               && !atomic_compare_exchange_weak_explicit(&states[index], &state, BB_WIN | BB_NEW,
+                   memory_order_relaxed, memory_order_relaxed))
+            ;
+    }
+
+    // All moves lead to won positions for the opponent: this is a loss, or a
+    // draw if a capture or promotion saves the game.
+    else if (atomic_fetch_sub_explicit(&counts[index], 1, memory_order_relaxed) == 1)
+    {
+        state = atomic_load_explicit(&states[index], memory_order_relaxed);
+
+        while ((state & BB_RESULT_MASK) == BB_UNKNOWN
+               && !atomic_compare_exchange_weak_explicit(&states[index], &state,
+                   (state & BB_DRAW_CHILD) ? BB_DRAW : BB_LOSS | BB_NEW, memory_order_relaxed,
+                   memory_order_relaxed))
+            ;
+    }
+}
+
+// Propagates the newly resolved positions to their predecessors, by
+// generating all reverse moves which don't change the material.
+static void *bitbase_propagate_thread(void *data)
+{
+    BitbaseJob *job = data;
+    const Bitbase *bitbase = job->bitbase;
+    square_t squares[BITBASE_MAX_PIECES];
+    square_t parent[BITBASE_MAX_PIECES];
+    color_t stm;
+
+    job->progress = false;
+
+    for (size_t index = job->start; index < job->end; ++index)
+    {
+        const unsigned char state =
+            atomic_load_explicit(&job->states[index], memory_order_relaxed);
+
+        if (!(state & BB_NEW)) continue;
+
+        atomic_fetch_and_explicit(&job->states[index], ~BB_NEW, memory_order_relaxed);
+        job->progress = true;
+        full_decode(bitbase, index, squares, &stm);
+
+        const color_t them = not_color(stm);
+        bitboard_t occupancy = 0;
+
+        for (int i = 0; i < bitbase->pieceCount; ++i) occupancy |= square_bb(squares[i]);
+
+        for (int i = 0; i < bitbase->pieceCount; ++i)
+        {
+            const piece_t piece = bitbase->pieces[i];
+            bitboard_t targets;
+
+            if (piece_color(piece) != them) continue;
+
+            if (piece_type(piece) == PAWN)
+            {
+                const square_t back = squares[i] - pawn_direction(them);
+
+                targets = 0;
+
+                if (!(occupancy & square_bb(back)))
+                {
+                    targets = square_bb(back);
+
+                    // Reverse double pushes.
+                    if (relative_sq_rank(squares[i], them) == RANK_4
+                        && !(occupancy & square_bb(back - pawn_direction(them))))
+                        targets |= square_bb(back - pawn_direction(them));
+                }
+            }
+            else
+                targets = piece_moves(piece_type(piece), squares[i], occupancy) & ~occupancy;
+
+            while (targets)
+            {
+                memcpy(parent, squares, sizeof(square_t) * bitbase->pieceCount);
+                parent[i] = bb_pop_first_sq(&targets);
+                sort_identical_pieces(bitbase, parent);
+                bitbase_update_parent(job->states, job->counts,
+                    full_index(bitbase, parent, them), state & BB_RESULT_MASK);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+// Packs the final results in the bitbase format.
+static void *bitbase_pack_thread(void *data)
+{
+    BitbaseJob *job = data;
+    const Bitbase *bitbase = job->bitbase;
+    square_t squares[BITBASE_MAX_PIECES];
+    color_t stm;
+
+    for (size_t index = job->start; index < job->end; ++index)
+    {
+        reduced_decode(bitbase, index, squares, &stm);
+        sort_identical_pieces(bitbase, squares);
+
+        const unsigned char state = atomic_load_explicit(
+            &job->states[full_index(bitbase, squares, stm)], memory_order_relaxed);
+        int result;
+
+        switch (state & BB_RESULT_MASK)
+        {
+            case BB_INVALID: continue;
+            case BB_WIN: result = BITBASE_WIN; break;
+            case BB_LOSS: result = BITBASE_LOSS; break;
+            default: result = BITBASE_DRAW; break;
+        }
+
+        job->results[result]++;
+        job->data[index / 4] |= result << (2 * (index % 4));
+    }
+
+    return NULL;
+}
+
+// Runs the given function on all the generation threads, and returns true if
+// any of them made progress.
+static bool bitbase_run_jobs(BitbaseJob *jobs, int threadCount, void *(*func)(void *))
+{
+    bool progress = false;
+
+    for (int i = 1; i < threadCount; ++i)
+        if (pthread_create(&jobs[i].thread, NULL, func, &jobs[i]))
+        {
+            perror("Unable to generate bitbase");
+            exit(EXIT_FAILURE);
+        }
+
+    // Recycle the main thread for generation.
+    func(&jobs[0]);
+
+    for (int i = 1; i < threadCount; ++i) pthread_join(jobs[i].thread, NULL);
+
+    for (int i = 0; i < threadCount; ++i) progress |= jobs[i].progress;
+
+    return progress;
+}
+
+// Splits the given range between the generation threads. Ranges are aligned
+// on 4 positions so that packing threads never share a byte.
+static void bitbase_split_jobs(BitbaseJob *jobs, int threadCount, size_t size)
+{
+    const size_t blocks = (size + 3) / 4;
+
+    for (int i = 0; i < threadCount; ++i)
+    {
+        jobs[i].start = blocks * i / threadCount * 4;
+        jobs[i].end = (i == threadCount - 1) ? size : blocks * (i + 1) / threadCount * 4;
+    }
+}
+
+static void bitbase_generate_data(Bitbase *bitbase, int threadCount)
+{
+    size_t fullSize = 2;
+
+    for (int i = 0; i < bitbase->pieceCount; ++i) fullSize *= SQUARE_NB;
+
+    atomic_uchar *states = malloc(fullSize * sizeof(atomic_uchar));
+    atomic_uchar *counts = malloc(fullSize * sizeof(atomic_uchar));
+    uint8_t *data = calloc((bitbase->size + 3) / 4, 1);
+    BitbaseJob *jobs = calloc(threadCount, sizeof(BitbaseJob));
+
+    if (states == NULL || counts == NULL || data == NULL || jobs == NULL)
+    {
+        perror("Unable to generate bitbase");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < threadCount; ++i)
+    {
+        jobs[i].bitbase = bitbase;
+        jobs[i].states = states;
+        jobs[i].counts = counts;
+        jobs[i].data = data;
+    }
+
+    // Resolve all mates, stalemates, and positions decided by a capture or a
+    // promotion.
+    bitbase_split_jobs(jobs, threadCount, fullSize);
+    bitbase_run_jobs(jobs, threadCount, &bitbase_init_thread);
+
+    // Propagate the results backwards until no position changes. The
+    // remaining undecided positions are draws.
+    while (bitbase_run_jobs(jobs, threadCount, &bitbase_propagate_thread))
+        ;
+
+    bitbase_split_jobs(jobs, threadCount, bitbase->size);
+
+    for (int i = 0; i < threadCount; ++i) jobs[i].progress = false;
+
+    bitbase_run_jobs(jobs, threadCount, &bitbase_pack_thread);
+
+    size_t results[3] = {0, 0, 0};
+
+    for (int i = 0; i < threadCount; ++i)
+        for (int r = 0; r < 3; ++r) results[r] += jobs[i].results[r];
+
+    printf("info string Bitbase %s: %zu wins, %zu draws, %zu losses\n", bitbase->name,
+        results[BITBASE_WIN], results[BITBASE_DRAW], results[BITBASE_LOSS]);
+    fflush(stdout);
+
+    bitbase->data = data;
+    bitbase->mapping = data;
+    bitbase->mapped = false;
+
+    free(jobs);
+    free(counts);
+    free(states);
+}
+
+static void bitbase_path(char *buf, size_t size, const char *path, const char *name)
+{
+    snprintf(buf, size, "%s/%s.sbb", path, name);
+}
+
+static bool bitbase_write(const Bitbase *bitbase, const char *path)
+{
+    char filename[4096];
+    BitbaseHeader header;
+
+    bitbase_path(filename, sizeof(filename), path, bitbase->name);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BitbaseMagic, sizeof(BitbaseMagic));
+    header.version = BitbaseVersion;
+    header.pieceCount = bitbase->pieceCount;
+    strcpy(header.name, bitbase->name);
+    header.size = bitbase->size;
+
+    FILE *f = fopen(filename, "wb");
+
+    if (f == NULL)
+    {
+        printf("info string Unable to write bitbase '%s': %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    const size_t bytes = (bitbase->size + 3) / 4;
+    const bool success =
+        fwrite(&header, sizeof(header), 1, f) == 1 && fwrite(bitbase->data, 1, bytes, f) == bytes;
+
+    if (fclose(f) != 0 || !success)
+    {
+        printf("info string Unable to write bitbase '%s'\n", filename);
+        return false;
+    }
+
+    return true;
+}
+
+static bool bitbase_register(const Bitbase *bitbase)
+{
+    if (BitbaseCount == BITBASE_MAX_TABLES)
+    {
+        printf("info string Unable to register bitbase %s: too many bitbases\n", bitbase->name);
+        return false;
+    }
+
+    Bitbases[BitbaseCount++] = *bitbase;
+    return true;
+}
+
+static bool bitbase_generate_class(
+    int counts[COLOR_NB][PIECETYPE_NB], const char *path, int threadCount)
+{
+    static const int PieceValues[PIECETYPE_NB] = {0, 1, 3, 3, 5, 9, 0, 0};
+    int balance = 0;
+    Bitbase bitbase;
+
+    // Always generate classes with the strongest side as White, so that
+    // files are named like "KRvKP" and not "KPvKR".
+    for (piecetype_t pt = PAWN; pt <= QUEEN; ++pt)
+        balance += (counts[WHITE][pt] - counts[BLACK][pt]) * PieceValues[pt];
+
+    if (balance < 0)
+    {
+        int flipped[COLOR_NB][PIECETYPE_NB];
+
+        memcpy(flipped[WHITE], counts[BLACK], sizeof(flipped[WHITE]));
+        memcpy(flipped[BLACK], counts[WHITE], sizeof(flipped[BLACK]));
+        return bitbase_generate_class(flipped, path, threadCount);
+    }
+
+    bitbase_setup(&bitbase, counts);
+
+    // Bare Kings are always a draw, and existing bitbases don't need to be
+    // generated again.
+    if (bitbase.pieceCount == 2 || bitbase_find_key(bitbase.materialKey) != NULL) return true;
+
+    // Generate all the classes reachable with a capture or a promotion first.
+    for (color_t c = WHITE; c <= BLACK; ++c)
+        for (piecetype_t pt = PAWN; pt <= QUEEN; ++pt)
+        {
+            if (!counts[c][pt]) continue;
+
+            int child[COLOR_NB][PIECETYPE_NB];
+
+            memcpy(child, counts, sizeof(child));
+            child[c][pt]--;
+
+            if (!bitbase_generate_class(child, path, threadCount)) return false;
+
+            if (pt != PAWN) continue;
+
+            for (piecetype_t promotion = KNIGHT; promotion <= QUEEN; ++promotion)
+            {
+                child[c][promotion]++;
+
+                if (!bitbase_generate_class(child, path, threadCount)) return false;
+
+                // Promotions with a capture.
+                for (piecetype_t captured = KNIGHT; captured <= QUEEN; ++captured)
+                {
+                    if (!child[not_color(c)][captured]) continue;
+
+                    child[not_color(c)][captured]--;
+
+                    if (!bitbase_generate_class(child, path, threadCount)) return false;
+
+                    child[not_color(c)][captured]++;
+                }
+
+                child[c][promotion]--;
+            }
+        }
+
+    printf("info string Generating bitbase %s\n", bitbase.name);
+    fflush(stdout);
+
+    bitbase_generate_data(&bitbase, threadCount);
+
+    if (!bitbase_register(&bitbase))
+    {
+        free(bitbase.mapping);
+        return false;
+    }
+
+    return bitbase_write(&bitbase, path);
+}
+
+bool bitbase_generate(const char *name, const char *path, int threadCount)
+{
+    int counts[COLOR_NB][PIECETYPE_NB];
+
+    if (!bitbase_parse(name, counts))
+    {
+        printf("info string Invalid bitbase class '%s'\n", name);
+        return false;
+    }
+
+    return bitbase_generate_class(counts, path, threadCount);
+}
+
+static void bitbase_release(Bitbase *bitbase)
+{
+#ifndef _WIN32
+    if (bitbase->mapped)
+    {
+        munmap(bitbase->mapping, bitbase->mappingSize);
+        return;
+    }
+#endif
+
+    free(bitbase->mapping);
+}
+
+void bitbase_unload(void)
+{
+    for (int i = 0; i < BitbaseCount; ++i) bitbase_release(&Bitbases[i]);
+
+    BitbaseCount = 0;
+}
+
+static bool bitbase_load_file(const char *filename)
+{
+    Bitbase bitbase;
+    BitbaseHeader header;
+    int counts[COLOR_NB][PIECETYPE_NB];
+    FILE *f = fopen(filename, "rb");
+
+    if (f == NULL) return false;
+
+    // Read the header first to check the bitbase specifications.
+    if (fread(&header, sizeof(header), 1, f) != 1
+        || memcmp(header.magic, BitbaseMagic, sizeof(BitbaseMagic))
+        || header.version != BitbaseVersion
+        || memchr(header.name, '\0', sizeof(header.name)) == NULL
+        || !bitbase_parse(header.name, counts))
+    {
+        printf("info string Invalid bitbase '%s'\n", filename);
+        fclose(f);
+        return false;
+    }
+
+    bitbase_setup(&bitbase, counts);
+
+    if (bitbase_find_key(bitbase.materialKey) != NULL)
+    {
+        fclose(f);
+        return false;
+    }
+
+    const size_t bytes = (bitbase.size + 3) / 4;
+
+    if ((size_t)header.pieceCount != (size_t)bitbase.pieceCount || header.size != bitbase.size)
+    {
+        printf("info string Invalid bitbase '%s'\n", filename);
+        fclose(f);
+        return false;
+    }
+
+#ifndef _WIN32
+    struct stat st;
+
+    if (fstat(fileno(f), &st) < 0 || st.st_size != (off_t)(sizeof(header) + bytes))
+    {
+        printf("info string Invalid bitbase '%s': wrong file size\n", filename);
+        fclose(f);
+        return false;
+    }
+
+    // Map the file read-only and shared, so that multiple engine instances
+    // share the same physical pages.
+    void *mapping = mmap(NULL, sizeof(header) + bytes, PROT_READ, MAP_SHARED, fileno(f), 0);
+
+    fclose(f);
+
+    if (mapping == MAP_FAILED)
+    {
+        printf("info string Unable to map bitbase '%s': %s\n", filename, strerror(errno));
+        return false;
+    }
+
+    bitbase.mapping = mapping;
+    bitbase.mappingSize = sizeof(header) + bytes;
+    bitbase.mapped = true;
+    bitbase.data = (const uint8_t *)mapping + sizeof(header);
+#else
+    uint8_t *data = malloc(bytes);
+
+    if (data == NULL)
+    {
+        perror("Unable to allocate bitbase");
+        exit(EXIT_FAILURE);
+    }
+
+    if (fread(data, 1, bytes, f) != bytes || fgetc(f) != EOF)
+    {
+        printf("info string Invalid bitbase '%s': wrong file size\n", filename);
+        free(data);
+        fclose(f);
+        return false;
+    }
+
+    fclose(f);
+    bitbase.mapping = data;
+    bitbase.mapped = false;
+    bitbase.data = data;
+#endif
+
+    if (!bitbase_register(&bitbase))
+    {
+        bitbase_release(&bitbase);
+        return false;
+    }
+
+    return true;
+}
+
+int bitbase_load_dir(const char *path)
+{
+    DIR *dir = opendir(path);
+    int loaded = 0;
+
+    if (dir == NULL)
+    {
+        printf("info string Unable to open bitbase directory '%s': %s\n", path, strerror(errno));
+        return 0;
+    }
+
+    for (struct dirent *entry = readdir(dir); entry != NULL; entry = readdir(dir))
+    {
+        const size_t len = strlen(entry->d_name);
+        char filename[4096];
+
+        if (len <= 4 || strcmp(entry->d_name + len - 4, ".sbb")) continue;
+
+        snprintf(filename, sizeof(filename), "%s/%s", path, entry->d_name);
+        loaded += bitbase_load_file(filename);
+    }
+
+    closedir(dir);
+    return loaded;
+}
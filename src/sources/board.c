@@ -17,62 +17,22 @@
 */
 
 #include "board.h"
+#include "bitbase.h"
+#include "endgame.h"
 #include "movelist.h"
+#include "profile.h"
 #include "tt.h"
 #include "types.h"
 #include "uci.h"
 #include <ctype.h>
 #include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
 const char PieceIndexes[PIECE_NB] = " PNBRQK  pnbrqk";
 
-hashkey_t CyclicKeys[8192];
-move_t CyclicMoves[8192];
-
-INLINED uint16_t cyclic_index_lo(hashkey_t key) { return key & 0x1FFFu; }
-
-INLINED uint16_t cyclic_index_hi(hashkey_t key) { return (key >> 13) & 0x1FFFu; }
-
-static void cyclic_init_move(piece_t piece, square_t from, square_t to)
-{
-    move_t move = create_move(from, to);
-    hashkey_t key = ZobristPsq[piece][from] ^ ZobristPsq[piece][to] ^ ZobristSideToMove;
-    uint16_t index = cyclic_index_lo(key);
-
-    // Swap the current move/key pair with the table contents until we find an
-    // empty slot.
-    while (true)
-    {
-        hashkey_t tmpKey = CyclicKeys[index];
-        CyclicKeys[index] = key;
-        key = tmpKey;
-
-        move_t tmpMove = CyclicMoves[index];
-        CyclicMoves[index] = move;
-        move = tmpMove;
-
-        if (move == NO_MOVE) break;
-
-        // Trick: change the section of the key for indexing by xor-ing the
-        // index value with the low and high key indexes:
-        // - if index == hi, index ^ lo ^ hi == lo
-        // - if index == lo, index ^ lo ^ hi == hi
-        index ^= cyclic_index_lo(key) ^ cyclic_index_hi(key);
-    }
-}
-
-void cyclic_init(void)
-{
-    // Map all reversible move Zobrist keys to their corresponding move.
-    for (piecetype_t pt = KNIGHT; pt <= KING; ++pt)
-        for (color_t c = WHITE; c <= BLACK; ++c)
-            for (square_t from = SQ_A1; from <= SQ_H8; ++from)
-                for (square_t to = from + 1; to <= SQ_H8; ++to)
-                    if (piece_moves(pt, from, 0) & square_bb(to))
-                        cyclic_init_move(create_piece(c, pt), from, to);
-}
+const int PhaseWeights[PIECETYPE_NB] = {0, 0, 1, 1, 2, 4, 0, 0};
 
 static bool board_invalid_material(const Board *board, color_t c)
 {
@@ -486,10 +446,123 @@ int board_from_fen(Board *board, const char *fen, bool isChess960, Boardstack *b
     return 0;
 }
 
+int board_from_packed(Board *board, const PackedBoard *packed, Boardstack *bstack)
+{
+    memset(board, 0, sizeof(Board));
+    memset(bstack, 0, sizeof(Boardstack));
+
+    bitboard_t occupancy = packed->occupancy;
+    bitboard_t castlingRooks = 0;
+
+    board->stack = bstack;
+
+    // The piece section cannot hold more than 32 pieces.
+    if (popcount(occupancy) > 32) return -1;
+
+    for (int i = 0; occupancy; ++i)
+    {
+        const square_t square = bb_pop_first_sq(&occupancy);
+        piece_t piece = (packed->pieces[i / 2] >> (4 * (i & 1))) & 15;
+
+        if (piece_type(piece) == NO_PIECETYPE) return -1;
+
+        // Restore the Rooks with castling rights, and remember their squares
+        // for setting the castling rights once the Kings are placed.
+        if (piece_type(piece) == PACKED_CASTLING_ROOK)
+        {
+            piece = create_piece(piece_color(piece), ROOK);
+            castlingRooks |= square_bb(square);
+        }
+
+        put_piece(board, piece, square);
+    }
+
+    if (popcount(piece_bb(board, WHITE, KING)) != 1 || popcount(piece_bb(board, BLACK, KING)) != 1)
+        return -1;
+
+    board->sideToMove = packed->flags & 1;
+
+    while (castlingRooks)
+    {
+        const square_t rookSquare = bb_pop_first_sq(&castlingRooks);
+
+        if (board_set_castling(board, piece_color(piece_on(board, rookSquare)), rookSquare) < 0)
+            return -1;
+    }
+
+    board->chess960 = (packed->flags >> 1) & 1;
+    board->stack->enPassantSquare =
+        (packed->enPassantSquare < SQUARE_NB) ? packed->enPassantSquare : SQ_NONE;
+    board->stack->rule50 = packed->rule50;
+    board->ply = packed->ply;
+
+    set_boardstack(board, board->stack);
+    return 0;
+}
+
+void board_pack(const Board *board, PackedBoard *packed)
+{
+    bitboard_t occupancy = occupancy_bb(board);
+
+    memset(packed, 0, sizeof(PackedBoard));
+    packed->occupancy = occupancy;
+
+    for (int i = 0; occupancy; ++i)
+    {
+        const square_t square = bb_pop_first_sq(&occupancy);
+        piece_t piece = piece_on(board, square);
+
+        // Rooks only have their own castling bit in the castling mask.
+        if (piece_type(piece) == ROOK && (board->castlingMask[square] & board->stack->castlings))
+            piece = create_piece(piece_color(piece), PACKED_CASTLING_ROOK);
+
+        packed->pieces[i / 2] |= piece << (4 * (i & 1));
+    }
+
+    packed->ply = board->ply;
+    packed->flags = board->sideToMove | (board->chess960 << 1);
+    packed->enPassantSquare = board->stack->enPassantSquare;
+    packed->rule50 = imin(imax(board->stack->rule50, 0), 255);
+}
+
+void set_endgame_class(Board *board)
+{
+    Boardstack *stack = board->stack;
+
+    // Do we have exact results for the current configuration ?
+    stack->bitbase = bitbase_find(board);
+
+    if (stack->bitbase != NULL)
+    {
+        stack->endgameClass = EGC_BITBASE;
+        return;
+    }
+
+    // Do we have a specialized endgame eval for the current configuration ?
+    stack->endgameEntry = endgame_probe(board);
+
+    if (stack->endgameEntry != NULL)
+    {
+        stack->endgameClass = EGC_SPECIALIZED;
+        return;
+    }
+
+    stack->endgameClass = EGC_NONE;
+
+    // Is there a KXK situation ? (lone King vs mating material)
+    for (color_t c = WHITE; c <= BLACK; ++c)
+        if (board->pieceCount[create_piece(not_color(c), ALL_PIECES)] == 1
+            && stack->material[c] >= ROOK_MG_SCORE)
+            stack->endgameClass = EGC_KXK_WHITE + c;
+}
+
 void set_boardstack(Board *board, Boardstack *stack)
 {
     stack->boardKey = stack->pawnKey = board->stack->materialKey = 0;
     stack->material[WHITE] = stack->material[BLACK] = 0;
+    stack->phase = 0;
+    stack->dirtyPieces.count = 0;
+    stack->accumulator.computed[WHITE] = stack->accumulator.computed[BLACK] = false;
     stack->checkers = attackers_to(board, get_king_square(board, board->sideToMove))
                       & color_bb(board, not_color(board->sideToMove));
 
@@ -509,6 +582,8 @@ void set_boardstack(Board *board, Boardstack *stack)
 
         else if (piece_type(piece) != KING)
             stack->material[piece_color(piece)] += PieceScores[MIDGAME][piece];
+
+        stack->phase += PhaseWeights[piece_type(piece)];
     }
 
     // And the en-passant square to the board key if it exists.
@@ -526,6 +601,8 @@ void set_boardstack(Board *board, Boardstack *stack)
             for (int i = 0; i < board->pieceCount[pc]; ++i) stack->materialKey ^= ZobristPsq[pc][i];
         }
 
+    set_endgame_class(board);
+
     // And the castlings to the board key.
     stack->boardKey ^= ZobristCastling[stack->castlings];
 }
@@ -643,6 +720,8 @@ const char *board_fen(const Board *board)
 
 void do_move_gc(Board *restrict board, move_t move, Boardstack *restrict next, bool givesCheck)
 {
+    PROFILE_SCOPE(PROF_DO_MOVE);
+
     hashkey_t key = board->stack->boardKey ^ ZobristSideToMove;
 
     // Copy the state variables that will need to be updated incrementally.
@@ -656,6 +735,12 @@ void do_move_gc(Board *restrict board, move_t move, Boardstack *restrict next, b
     next->materialKey = board->stack->materialKey;
     next->material[WHITE] = board->stack->material[WHITE];
     next->material[BLACK] = board->stack->material[BLACK];
+    next->phase = board->stack->phase;
+    next->endgameClass = board->stack->endgameClass;
+    next->endgameEntry = board->stack->endgameEntry;
+    next->bitbase = board->stack->bitbase;
+    next->dirtyPieces.count = 0;
+    next->accumulator.computed[WHITE] = next->accumulator.computed[BLACK] = false;
 
     // Link the new stack to the existing list, and increment the ply-related
     // counters.
@@ -678,6 +763,8 @@ void do_move_gc(Board *restrict board, move_t move, Boardstack *restrict next, b
         square_t rookFrom, rookTo;
 
         do_castling(board, us, from, &to, &rookFrom, &rookTo);
+        dirty_pieces_add(&board->stack->dirtyPieces, piece, from, to);
+        dirty_pieces_add(&board->stack->dirtyPieces, capturedPiece, rookFrom, rookTo);
 
         key ^= ZobristPsq[capturedPiece][rookFrom];
         key ^= ZobristPsq[capturedPiece][rookTo];
@@ -697,9 +784,13 @@ void do_move_gc(Board *restrict board, move_t move, Boardstack *restrict next, b
             board->stack->pawnKey ^= ZobristPsq[capturedPiece][capturedSquare];
         }
         else
+        {
             board->stack->material[them] -= PieceScores[MIDGAME][capturedPiece];
+            board->stack->phase -= PhaseWeights[piece_type(capturedPiece)];
+        }
 
         remove_piece(board, capturedSquare);
+        dirty_pieces_add(&board->stack->dirtyPieces, capturedPiece, capturedSquare, SQ_NONE);
 
         // Special handling for en-passant moves: since the arrival square of
         // the Pawn isn't the one the opponent's Pawn resides on, we need to
@@ -733,7 +824,11 @@ void do_move_gc(Board *restrict board, move_t move, Boardstack *restrict next, b
 
     // Don't move the piece during castling, since we already do this work in
     // the do_castling() function.
-    if (move_type(move) != CASTLING) move_piece(board, from, to);
+    if (move_type(move) != CASTLING)
+    {
+        move_piece(board, from, to);
+        dirty_pieces_add(&board->stack->dirtyPieces, piece, from, to);
+    }
 
     // Additional work is required for pawn moves.
     if (piece_type(piece) == PAWN)
@@ -754,10 +849,16 @@ void do_move_gc(Board *restrict board, move_t move, Boardstack *restrict next, b
             remove_piece(board, to);
             put_piece(board, newPiece, to);
 
+            // The promoted Pawn leaves the board instead of reaching its
+            // arrival square.
+            board->stack->dirtyPieces.to[board->stack->dirtyPieces.count - 1] = SQ_NONE;
+            dirty_pieces_add(&board->stack->dirtyPieces, newPiece, SQ_NONE, to);
+
             // Update the board, Pawn and material keys.
             key ^= ZobristPsq[piece][to] ^ ZobristPsq[newPiece][to];
             board->stack->pawnKey ^= ZobristPsq[piece][to];
             board->stack->material[us] += PieceScores[MIDGAME][promotion_type(move)];
+            board->stack->phase += PhaseWeights[promotion_type(move)];
             board->stack->materialKey ^= ZobristPsq[newPiece][board->pieceCount[newPiece] - 1];
             board->stack->materialKey ^= ZobristPsq[piece][board->pieceCount[piece]];
         }
@@ -767,6 +868,11 @@ void do_move_gc(Board *restrict board, move_t move, Boardstack *restrict next, b
         board->stack->rule50 = 0;
     }
 
+    // The special endgame class only depends on the material distribution, so
+    // it only needs to be updated after captures and promotions.
+    if (capturedPiece || move_type(move) == PROMOTION)
+        set_endgame_class(board);
+
     // Record the captured piece if it exists, and set the board key.
     board->stack->capturedPiece = capturedPiece;
     board->stack->boardKey = key;
@@ -895,13 +1001,18 @@ void do_null_move(Board *restrict board, Boardstack *restrict stack)
 {
     // Copy the whole stack state. (NOTE: this part might be further optimized
     // by only copying the required fields as in the do_move_gc() function, this
-    // hasn't been tested yet for an Elo gain.)
-    memcpy(stack, board->stack, sizeof(Boardstack));
+    // hasn't been tested yet for an Elo gain.) The accumulator is left out, as
+    // it is large and can be lazily copied from the parent node if needed.
+    memcpy(stack, board->stack, offsetof(Boardstack, accumulator));
 
     // Link the new stack to the existing list.
     stack->prev = board->stack;
     board->stack = stack;
 
+    // No piece moved, so the accumulator is the same as the parent one.
+    stack->dirtyPieces.count = 0;
+    stack->accumulator.computed[WHITE] = stack->accumulator.computed[BLACK] = false;
+
     // Clear the en-passant Zobrist key from the board key if needed.
     if (stack->enPassantSquare != SQ_NONE)
     {
@@ -1224,6 +1335,8 @@ bool move_is_pseudo_legal(const Board *board, move_t move)
 
 bool see_greater_than(const Board *board, move_t m, score_t threshold)
 {
+    PROFILE_SCOPE(PROF_SEE);
+
     // "Non-standard" moves are tricky to evaluate, so perform a generic check
     // here.
     if (move_type(m) != NORMAL_MOVE) return threshold <= 0;
@@ -0,0 +1,60 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cpu.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define CPU_X86
+#endif
+
+CpuFeatures Cpu = {false, false, false, false};
+
+void cpu_init(void)
+{
+#ifdef CPU_X86
+    unsigned int eax, ebx, ecx, edx;
+    char vendor[13] = {0};
+
+    __builtin_cpu_init();
+
+    // The builtins also check that the OS saves the AVX registers.
+    Cpu.avx2 = __builtin_cpu_supports("avx2");
+    Cpu.avx512 =
+        Cpu.avx2 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+    Cpu.vnni = Cpu.avx512 && __builtin_cpu_supports("avx512vnni");
+
+    if (!__builtin_cpu_supports("bmi2") || !__get_cpuid(0, &eax, &ebx, &ecx, &edx)) return;
+
+    memcpy(vendor, &ebx, 4);
+    memcpy(vendor + 4, &edx, 4);
+    memcpy(vendor + 8, &ecx, 4);
+
+    __get_cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    unsigned int family = (eax >> 8) & 0xF;
+
+    if (family == 0xF) family += (eax >> 20) & 0xFF;
+
+    // PEXT is microcoded on AMD (and Hygon) CPUs before Zen 3, taking up to
+    // several hundred cycles, which makes magic bitboards faster there.
+    Cpu.fastPext =
+        (strcmp(vendor, "AuthenticAMD") && strcmp(vendor, "HygonGenuine")) || family >= 0x19;
+#endif
+}
@@ -0,0 +1,541 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "datagen.h"
+#include "analyse.h"
+#include "bitboard.h"
+#include "movelist.h"
+#include "random.h"
+#include "search.h"
+#include "timeman.h"
+#include "tt.h"
+#include "uci.h"
+#include "worker.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+    DATAGEN_MAX_PLIES = 400,     // Games reaching this length are drawn
+    DATAGEN_WIN_SCORE = 2000,    // Score for win adjudication
+    DATAGEN_WIN_PLIES = 4,       // Consecutive plies needed for win adjudication
+    DATAGEN_DRAW_SCORE = 10,     // Score for draw adjudication
+    DATAGEN_DRAW_PLIES = 12,     // Consecutive plies needed for draw adjudication
+    DATAGEN_DRAW_MIN_PLY = 80,   // Minimal game length for draw adjudication
+    DATAGEN_REPORT_GAMES = 100   // Number of games between two progress reports
+};
+
+static const char *StartPosFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+static DatagenParams Params;
+static FILE *OutputFile;
+static char **BookFens;
+static size_t BookSize;
+static size_t GamesStarted;
+static size_t GamesFinished;
+static uint64_t PositionsWritten;
+static clock_t StartTime;
+static pthread_mutex_t DatagenMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static bool datagen_claim_game(void)
+{
+    pthread_mutex_lock(&DatagenMutex);
+
+    const bool claimed = GamesStarted < Params.games && !wpool_is_stopped(&SearchWorkerPool);
+
+    GamesStarted += claimed;
+    pthread_mutex_unlock(&DatagenMutex);
+    return claimed;
+}
+
+// Sets up a random opening on the given board. Returns the number of played
+// plies, or -1 if the opening ended the game early.
+static int datagen_opening(Board *board, Boardstack *stacks, uint64_t *seed)
+{
+    const char *fen = BookSize ? BookFens[qrandom(seed) % BookSize] : StartPosFEN;
+    Movelist list;
+
+    board_from_fen(board, fen, UciOptionFields.chess960, &stacks[0]);
+
+    for (int ply = 0; ply < Params.randomPlies; ++ply)
+    {
+        list_all(&list, board);
+
+        if (movelist_size(&list) == 0) return -1;
+
+        do_move(board, list.moves[qrandom(seed) % movelist_size(&list)].move, &stacks[ply + 1]);
+    }
+
+    list_all(&list, board);
+    return movelist_size(&list) ? Params.randomPlies : -1;
+}
+
+// Checks for draws by the 50-move rule, threefold repetition or insufficient
+// material.
+static bool datagen_is_draw(const Board *board)
+{
+    if (board->stack->rule50 > 99 || board->stack->repetition < 0) return true;
+
+    return !(piecetypes_bb(board, PAWN, ROOK) | piecetype_bb(board, QUEEN))
+           && popcount(occupancy_bb(board)) <= 3;
+}
+
+// Searches the current position of the worker, and returns the best move.
+static move_t datagen_search(Worker *worker, const Movelist *list, score_t *score)
+{
+    worker->rootCount = movelist_size(list);
+    worker->rootMoves = malloc(sizeof(RootMove) * worker->rootCount);
+
+    if (worker->rootMoves == NULL)
+    {
+        perror("Unable to allocate root moves");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t k = 0; k < worker->rootCount; ++k)
+    {
+        RootMove *rootMove = &worker->rootMoves[k];
+
+        rootMove->move = list->moves[k].move;
+        rootMove->seldepth = 0;
+        rootMove->score = rootMove->prevScore = -INF_SCORE;
+        rootMove->tbRank = 0;
+        rootMove->tbScore = DRAW;
+        rootMove->pv[0] = rootMove->pv[1] = NO_MOVE;
+    }
+
+    atomic_store_explicit(&worker->nodes, 0, memory_order_relaxed);
+    worker->completedDepth = 0;
+    worker_search(worker);
+
+    const move_t move = worker->rootMoves->move;
+
+    *score = worker->rootMoves->prevScore;
+    free(worker->rootMoves);
+    worker->rootMoves = NULL;
+    return move;
+}
+
+// Plays a self-play game, records its quiet positions, and returns its result
+// from White's point of view.
+static double datagen_play_game(
+    Worker *worker, Boardstack *stacks, PackedBoard *entries, size_t *count, uint64_t *seed)
+{
+    Board *board = &worker->board;
+    int ply, winPlies = 0, drawPlies = 0;
+    Movelist list;
+
+    while ((ply = datagen_opening(board, stacks, seed)) < 0)
+        ;
+
+    board->worker = worker;
+    *count = 0;
+
+    for (int gamePly = 0; true; ++gamePly)
+    {
+        list_all(&list, board);
+
+        if (movelist_size(&list) == 0)
+            return !board->stack->checkers ? 0.5 : board->sideToMove == WHITE ? 0.0 : 1.0;
+
+        if (gamePly >= DATAGEN_MAX_PLIES || datagen_is_draw(board)) return 0.5;
+
+        score_t score;
+        const move_t move = datagen_search(worker, &list, &score);
+        const score_t whiteScore = (board->sideToMove == WHITE) ? score : -score;
+
+        // Adjudicate games once the scores are decisive or drawish for long
+        // enough.
+        winPlies = (abs(score) >= DATAGEN_WIN_SCORE) ? winPlies + 1 : 0;
+        drawPlies = (abs(score) <= DATAGEN_DRAW_SCORE) ? drawPlies + 1 : 0;
+
+        if (winPlies >= DATAGEN_WIN_PLIES) return whiteScore > 0 ? 1.0 : 0.0;
+
+        if (gamePly >= DATAGEN_DRAW_MIN_PLY && drawPlies >= DATAGEN_DRAW_PLIES) return 0.5;
+
+        // Only record quiet positions, which suit the static eval tuning.
+        if (!board->stack->checkers && !is_capture_or_promotion(board, move)
+            && abs(score) < MATE_FOUND)
+        {
+            board_pack(board, &entries[*count]);
+            entries[(*count)++].score = whiteScore;
+        }
+
+        do_move(board, move, &stacks[++ply]);
+    }
+}
+
+static void datagen_write_game(PackedBoard *entries, size_t count, double result)
+{
+    for (size_t i = 0; i < count; ++i) entries[i].result = (uint8_t)(result * 2.0);
+
+    pthread_mutex_lock(&DatagenMutex);
+
+    if (Params.binary)
+    {
+        if (fwrite(entries, sizeof(PackedBoard), count, OutputFile) != count)
+        {
+            perror("Unable to write dataset");
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+    {
+        Board board;
+        Boardstack stack;
+
+        // The FEN formatting function uses a static buffer, so only call it
+        // with the datagen mutex held.
+        for (size_t i = 0; i < count; ++i)
+        {
+            board_from_packed(&board, &entries[i], &stack);
+            fprintf(OutputFile, "%s %.1lf %d\n", board_fen(&board), result,
+                (int)entries[i].score);
+        }
+    }
+
+    PositionsWritten += count;
+
+    if (++GamesFinished % DATAGEN_REPORT_GAMES == 0 || GamesFinished == Params.games)
+    {
+        const clock_t elapsed = chess_clock() - StartTime;
+
+        printf("info string datagen games %zu positions %" PRIu64 " (%.1f positions/s)\n",
+            GamesFinished, PositionsWritten, PositionsWritten * 1000.0 / (elapsed + !elapsed));
+        fflush(stdout);
+    }
+
+    pthread_mutex_unlock(&DatagenMutex);
+}
+
+// Plays games until the requested number of games is reached.
+static void datagen_worker_search(Worker *worker)
+{
+    const size_t stackCount = (size_t)Params.randomPlies + DATAGEN_MAX_PLIES + 2;
+    Boardstack *stacks = malloc(sizeof(Boardstack) * stackCount);
+    PackedBoard *entries = malloc(sizeof(PackedBoard) * DATAGEN_MAX_PLIES);
+    uint64_t seed = Params.seed ^ (UINT64_C(0x9E3779B97F4A7C15) * (worker->idx + 1));
+
+    if (stacks == NULL || entries == NULL)
+    {
+        perror("Unable to allocate game data");
+        exit(EXIT_FAILURE);
+    }
+
+    // Xorshift generators must not be seeded with zero.
+    seed += !seed;
+
+    while (datagen_claim_game())
+    {
+        size_t count;
+        const double result = datagen_play_game(worker, stacks, entries, &count, &seed);
+
+        datagen_write_game(entries, count, result);
+    }
+
+    free(stacks);
+    free(entries);
+}
+
+// Loads all valid positions of the given EPD book.
+static bool datagen_load_book(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[4096], fen[256], id[256];
+    size_t maxSize = 0;
+    Board board;
+    Boardstack stack;
+
+    if (f == NULL)
+    {
+        printf("info string Unable to open '%s'\n", path);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == '#' || !parse_epd_line(line, fen, sizeof(fen), id, sizeof(id))
+            || board_from_fen(&board, fen, UciOptionFields.chess960, &stack) < 0)
+            continue;
+
+        if (BookSize == maxSize)
+        {
+            maxSize += !maxSize ? 16 : maxSize / 2;
+            BookFens = realloc(BookFens, sizeof(char *) * maxSize);
+
+            if (BookFens == NULL)
+            {
+                perror("Unable to allocate book");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        if ((BookFens[BookSize++] = strdup(fen)) == NULL)
+        {
+            perror("Unable to allocate book");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    fclose(f);
+
+    if (BookSize == 0) printf("info string No valid positions in '%s'\n", path);
+
+    return BookSize != 0;
+}
+
+static void datagen_free_book(void)
+{
+    while (BookSize) free(BookFens[--BookSize]);
+
+    free(BookFens);
+    BookFens = NULL;
+}
+
+// Writes the packed dataset header to empty files, and checks it otherwise.
+static bool datagen_init_packed(FILE *f)
+{
+    fseek(f, 0, SEEK_END);
+
+    if (ftell(f) == 0) return fwrite(DATASET_MAGIC, 1, DATASET_MAGIC_SIZE, f) == DATASET_MAGIC_SIZE;
+
+    const bool packed = dataset_is_packed(f);
+
+    fseek(f, 0, SEEK_END);
+    return packed;
+}
+
+void datagen_run(const char *path, const char *bookPath, const DatagenParams *params)
+{
+    if (bookPath != NULL && !datagen_load_book(bookPath))
+    {
+        datagen_free_book();
+        fflush(stdout);
+        return;
+    }
+
+    OutputFile = fopen(path, params->binary ? "a+b" : "a");
+
+    if (OutputFile == NULL || (params->binary && !datagen_init_packed(OutputFile)))
+    {
+        printf("info string Unable to open '%s' as a%s dataset\n", path,
+            params->binary ? " packed" : "");
+
+        if (OutputFile != NULL) fclose(OutputFile);
+
+        OutputFile = NULL;
+        datagen_free_book();
+        fflush(stdout);
+        return;
+    }
+
+    Params = *params;
+    GamesStarted = GamesFinished = 0;
+    PositionsWritten = 0;
+
+    // Searches are bounded by depth and by a soft node limit. Marking them as
+    // infinite disables the time checks of the first worker.
+    memset(&UciSearchParams, 0, sizeof(SearchParams));
+    UciSearchParams.depth = Params.depth;
+    UciSearchParams.nodes = Params.nodes;
+    UciSearchParams.infinite = 1;
+    tt_clear();
+
+    StartTime = chess_clock();
+    wpool_run_standalone(&SearchWorkerPool, &datagen_worker_search);
+
+    fclose(OutputFile);
+    OutputFile = NULL;
+    datagen_free_book();
+}
+
+void uci_datagen(const char *args)
+{
+    char *copy = strdup(args ? args : "");
+
+    if (copy == NULL)
+    {
+        perror("Unable to allocate command copy");
+        exit(EXIT_FAILURE);
+    }
+
+    char *ptr = copy;
+    char *path = get_next_token(&ptr);
+    char *bookPath = NULL;
+    char *token;
+    DatagenParams params = {100, 0, 0, 8, (uint64_t)chess_clock(), false};
+
+    while ((token = get_next_token(&ptr)) != NULL)
+    {
+        char *value = get_next_token(&ptr);
+
+        if (value == NULL) break;
+
+        if (!strcmp(token, "games"))
+            params.games = (size_t)strtoull(value, NULL, 10);
+        else if (!strcmp(token, "depth"))
+            params.depth = atoi(value);
+        else if (!strcmp(token, "nodes"))
+            params.nodes = strtoull(value, NULL, 10);
+        else if (!strcmp(token, "plies"))
+            params.randomPlies = atoi(value);
+        else if (!strcmp(token, "book"))
+            bookPath = value;
+        else if (!strcmp(token, "seed"))
+            params.seed = strtoull(value, NULL, 10);
+        else if (!strcmp(token, "format"))
+            params.binary = !strcmp(value, "bin");
+    }
+
+    // Without any limit, use a default depth of 8.
+    if (params.depth <= 0 || params.depth > MAX_PLIES)
+        params.depth = params.nodes ? MAX_PLIES : 8;
+
+    if (params.nodes == 0) params.nodes = UINT64_MAX;
+
+    if (params.randomPlies < 0 || params.randomPlies > 64) params.randomPlies = 8;
+
+    if (path != NULL)
+        datagen_run(path, bookPath, &params);
+    else
+    {
+        puts("info string Usage: datagen <output file> [games <n>] [depth <n>] [nodes <n>] "
+             "[plies <n>] [book <file.epd>] [seed <n>] [format <text|bin>]");
+        fflush(stdout);
+    }
+
+    free(copy);
+}
+
+bool dataset_parse_line(char *line, double *result, score_t *score)
+{
+    // Parse the fields from the end of the line, since the FEN has spaces.
+    char *ptr = strrchr(line, ' ');
+
+    if (ptr == NULL || sscanf(ptr + 1, "%hd", score) != 1) return false;
+
+    *ptr = '\0';
+    ptr = strrchr(line, ' ');
+
+    if (ptr == NULL || sscanf(ptr + 1, "%lf", result) != 1) return false;
+
+    *ptr = '\0';
+    return true;
+}
+
+bool dataset_is_packed(FILE *f)
+{
+    char magic[DATASET_MAGIC_SIZE];
+
+    rewind(f);
+    return fread(magic, 1, DATASET_MAGIC_SIZE, f) == DATASET_MAGIC_SIZE
+           && !memcmp(magic, DATASET_MAGIC, DATASET_MAGIC_SIZE);
+}
+
+size_t dataset_convert(const char *input, const char *output)
+{
+    FILE *in = fopen(input, "r");
+
+    if (in == NULL)
+    {
+        printf("info string Unable to open '%s'\n", input);
+        return 0;
+    }
+
+    FILE *out = fopen(output, "wb");
+
+    if (out == NULL)
+    {
+        printf("info string Unable to open '%s'\n", output);
+        fclose(in);
+        return 0;
+    }
+
+    char line[1024];
+    size_t converted = 0, skipped = 0;
+    Board board;
+    Boardstack stack;
+    PackedBoard packed;
+    double result;
+    score_t score;
+
+    if (fwrite(DATASET_MAGIC, 1, DATASET_MAGIC_SIZE, out) != DATASET_MAGIC_SIZE)
+    {
+        perror("Unable to write dataset");
+        exit(EXIT_FAILURE);
+    }
+
+    while (fgets(line, sizeof(line), in) != NULL)
+    {
+        // Positions are loaded like in the tuner, without the Chess960 flag.
+        if (!dataset_parse_line(line, &result, &score)
+            || board_from_fen(&board, line, false, &stack) < 0)
+        {
+            ++skipped;
+            continue;
+        }
+
+        board_pack(&board, &packed);
+        packed.score = score;
+        packed.result = (uint8_t)(result * 2.0 + 0.5);
+
+        if (fwrite(&packed, sizeof(PackedBoard), 1, out) != 1)
+        {
+            perror("Unable to write dataset");
+            exit(EXIT_FAILURE);
+        }
+
+        ++converted;
+    }
+
+    fclose(in);
+    fclose(out);
+    printf("info string Converted %zu positions (%zu skipped)\n", converted, skipped);
+    fflush(stdout);
+    return converted;
+}
+
+void uci_convert(const char *args)
+{
+    char *copy = strdup(args ? args : "");
+
+    if (copy == NULL)
+    {
+        perror("Unable to allocate command copy");
+        exit(EXIT_FAILURE);
+    }
+
+    char *ptr = copy;
+    char *input = get_next_token(&ptr);
+    char *output = get_next_token(&ptr);
+
+    if (input != NULL && output != NULL)
+        dataset_convert(input, output);
+    else
+    {
+        puts("info string Usage: convert <text dataset> <packed dataset>");
+        fflush(stdout);
+    }
+
+    free(copy);
+}
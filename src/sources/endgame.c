@@ -332,20 +332,36 @@ void add_colored_entry(color_t winningSide, char *wpieces, char *bpieces, endgam
 
     board_from_fen(&board, fen, false, &stack);
 
-    // Try to map the board to a new endgame entry.
-    EndgameEntry *entry = &EndgameTable[board.stack->materialKey & (EGTB_SIZE - 1)];
+    // Build the endgame entry from the endgame specifications.
+    EndgameEntry entry = {board.stack->materialKey, func, winningSide};
+    size_t index = endgame_index_lo(entry.key);
 
-    // Check for key conflicts and stop the program here.
-    if (entry->key)
+    // Check that the material configuration hasn't already been registered.
+    if (endgame_probe(&board) != NULL)
     {
-        fputs("Error: key conflicts in endgame table\n", stderr);
+        fprintf(stderr, "Error: duplicate endgame entry %sv%s\n", wpieces, bpieces);
         exit(EXIT_FAILURE);
     }
 
-    // Assign the endgame specifications to the entry.
-    entry->key = board.stack->materialKey;
-    entry->func = func;
-    entry->winningSide = winningSide;
+    // Swap the current entry with the table contents until we find an empty
+    // slot. Each displaced entry is moved to its alternative slot. Give up
+    // if the insertion cycles for too long, which in practice never happens
+    // with a sparse table.
+    for (int tries = 0; tries < EGTB_SIZE; ++tries)
+    {
+        EndgameEntry tmp = EndgameTable[index];
+        EndgameTable[index] = entry;
+        entry = tmp;
+
+        if (!entry.key) return;
+
+        // Same trick as for the cyclic keys: xor-ing the index with both
+        // indexes of the displaced key gives us its other slot.
+        index ^= endgame_index_lo(entry.key) ^ endgame_index_hi(entry.key);
+    }
+
+    fputs("Error: unable to insert all entries in endgame table\n", stderr);
+    exit(EXIT_FAILURE);
 }
 
 void add_endgame_entry(const char *pieces, endgame_func_t eval)
@@ -412,8 +428,13 @@ void init_endgame_table(void)
 
 const EndgameEntry *endgame_probe(const Board *board)
 {
-    EndgameEntry *entry = &EndgameTable[board->stack->materialKey & (EGTB_SIZE - 1)];
+    const hashkey_t key = board->stack->materialKey;
+    const EndgameEntry *entry = &EndgameTable[endgame_index_lo(key)];
+
+    // Return the entry from either slot if the keys match.
+    if (entry->key == key) return entry;
+
+    entry = &EndgameTable[endgame_index_hi(key)];
 
-    // Return the entry if the keys match.
-    return entry->key == board->stack->materialKey ? entry : NULL;
+    return entry->key == key ? entry : NULL;
 }
@@ -17,15 +17,19 @@
 */
 
 #include "evaluate.h"
+#include "bitbase.h"
 #include "endgame.h"
 #include "movelist.h"
+#include "nnue.h"
 #include "pawns.h"
+#include "profile.h"
 #include "types.h"
+#include "worker.h"
 #include <stdlib.h>
 #include <string.h>
 
 #ifdef TUNE
-evaltrace_t Trace;
+_Thread_local evaltrace_t Trace;
 #endif
 
 // clang-format off
@@ -174,14 +178,6 @@ typedef struct evaluation_s
     int positionClosed;
 } evaluation_t;
 
-bool is_kxk_endgame(const Board *board, color_t us)
-{
-    // Weak side has pieces or Pawns, this is not a KXK endgame.
-    if (more_than_one(color_bb(board, not_color(us)))) return false;
-
-    return board->stack->material[us] >= ROOK_MG_SCORE;
-}
-
 score_t eval_kxk(const Board *board, color_t us)
 {
     // Be careful to avoid stalemating the weak King.
@@ -224,16 +220,10 @@ score_t eval_kxk(const Board *board, color_t us)
 bool ocb_endgame(const Board *board)
 {
     // Check if there is exactly one White Bishop and one Black Bishop.
-    bitboard_t wbishop = piece_bb(board, WHITE, BISHOP);
-
-    if (!wbishop || more_than_one(wbishop)) return false;
-
-    bitboard_t bbishop = piece_bb(board, BLACK, BISHOP);
-
-    if (!bbishop || more_than_one(bbishop)) return false;
+    if (board->pieceCount[WHITE_BISHOP] != 1 || board->pieceCount[BLACK_BISHOP] != 1) return false;
 
     // Then check that the Bishops are on opposite colored squares.
-    bitboard_t dsqMask = (wbishop | bbishop) & DSQ_BB;
+    bitboard_t dsqMask = piecetype_bb(board, BISHOP) & DSQ_BB;
 
     return !!dsqMask && !more_than_one(dsqMask);
 }
@@ -247,12 +237,14 @@ score_t scale_endgame(const Board *board, const PawnEntry *pe, score_t eg)
     int factor;
     score_t strongMat = board->stack->material[strongSide],
             weakMat = board->stack->material[weakSide];
+    int strongPawnCount = board->pieceCount[create_piece(strongSide, PAWN)],
+        weakPawnCount = board->pieceCount[create_piece(weakSide, PAWN)];
     bitboard_t strongPawns = piece_bb(board, strongSide, PAWN),
                weakPawns = piece_bb(board, weakSide, PAWN);
 
     // No Pawns and low material difference, the endgame is either drawn
     // or very difficult to win.
-    if (!strongPawns && strongMat - weakMat <= BISHOP_MG_SCORE)
+    if (!strongPawnCount && strongMat - weakMat <= BISHOP_MG_SCORE)
         factor = (strongMat <= BISHOP_MG_SCORE)
                      ? 0
                      : imax((int32_t)(strongMat - weakMat) * 8 / BISHOP_MG_SCORE, 0);
@@ -261,14 +253,14 @@ score_t scale_endgame(const Board *board, const PawnEntry *pe, score_t eg)
     // or if there are no other remaining pieces, based on the number of passed pawns.
     else if (ocb_endgame(board))
         factor = (strongMat + weakMat > 2 * BISHOP_MG_SCORE)
-                     ? 71 + popcount(color_bb(board, strongSide)) * 9
+                     ? 71 + board->pieceCount[create_piece(strongSide, ALL_PIECES)] * 9
                      : 33 + popcount(pe->passed[strongSide]) * 21;
 
     // Rook endgames: drawish if the Pawn advantage is small, and all strong side Pawns
     // are on the same side of the board. Don't scale if the defending King is far from
     // his own Pawns.
     else if (strongMat == ROOK_MG_SCORE && weakMat == ROOK_MG_SCORE
-             && (popcount(strongPawns) - popcount(weakPawns) < 2)
+             && (strongPawnCount - weakPawnCount < 2)
              && !!(KINGSIDE_BB & strongPawns) != !!(QUEENSIDE_BB & strongPawns)
              && (king_moves(get_king_square(board, weakSide)) & weakPawns))
         factor = 130;
@@ -276,7 +268,7 @@ score_t scale_endgame(const Board *board, const PawnEntry *pe, score_t eg)
     // Other endgames. Decrease the endgame score as the number of pawns of the strong
     // side gets lower.
     else
-        factor = imin(256, 177 + 13 * popcount(strongPawns));
+        factor = imin(256, 177 + 13 * strongPawnCount);
 
     // Be careful to cast to 32-bit integer here before multiplying to avoid overflows.
     eg = (score_t)((int32_t)eg * factor / 256);
@@ -725,6 +717,45 @@ scorepair_t evaluate_safety_file(
     return ret;
 }
 
+scorepair_t evaluate_shelter_storm(const Board *board, color_t us)
+{
+    const color_t them = not_color(us);
+    const square_t theirKing = get_king_square(board, them);
+    const bitboard_t ourPawns = piece_bb(board, us, PAWN);
+    const bitboard_t theirPawns = piece_bb(board, them, PAWN);
+    scorepair_t ret = 0;
+
+    for (file_t f = imax(FILE_A, sq_file(theirKing) - 1); f <= imin(FILE_H, sq_file(theirKing) + 1);
+         ++f)
+        ret += evaluate_safety_file(ourPawns, theirPawns, f, theirKing, us);
+
+    return ret;
+}
+
+scorepair_t king_pawn_probe(const Board *board, color_t us)
+{
+#ifndef TUNE
+    // The Pawn Storm/Shelter terms only depend on the Pawn structure and the
+    // King squares, so we can cache them for both sides at once.
+    const hashkey_t key = board->stack->pawnKey
+                          ^ ZobristPsq[WHITE_KING][get_king_square(board, WHITE)]
+                          ^ ZobristPsq[BLACK_KING][get_king_square(board, BLACK)];
+    KingPawnEntry *entry = get_worker(board)->kingPawnTable + (key % KingPawnTableSize);
+
+    if (entry->key != key)
+    {
+        entry->key = key;
+        entry->safety[WHITE] = evaluate_shelter_storm(board, WHITE);
+        entry->safety[BLACK] = evaluate_shelter_storm(board, BLACK);
+    }
+
+    return entry->safety[us];
+#else
+    // Always recompute the terms when tuning, since we need to trace them.
+    return evaluate_shelter_storm(board, us);
+#endif
+}
+
 scorepair_t evaluate_safety(const Board *board, evaluation_t *eval, color_t us)
 {
     // Add a bonus if we have 2 pieces (or more) on the King Attack zone, or
@@ -771,14 +802,7 @@ scorepair_t evaluate_safety(const Board *board, evaluation_t *eval, color_t us)
         bonus += SafeQueenCheck * popcount(queenChecks);
 
         // Evaluate the Pawn Storm/Shelter.
-        {
-            bitboard_t ourPawns = piece_bb(board, us, PAWN);
-            bitboard_t theirPawns = piece_bb(board, them, PAWN);
-
-            for (file_t f = imax(FILE_A, sq_file(theirKing) - 1);
-                 f <= imin(FILE_H, sq_file(theirKing) + 1); ++f)
-                bonus += evaluate_safety_file(ourPawns, theirPawns, f, theirKing, us);
-        }
+        bonus += king_pawn_probe(board, us);
 
         TRACE_ADD(IDX_KS_OFFSET, us, 1);
         TRACE_ADD(IDX_KS_QUEENLESS, us, queenless);
@@ -801,16 +825,29 @@ scorepair_t evaluate_safety(const Board *board, evaluation_t *eval, color_t us)
 
 score_t evaluate(const Board *board)
 {
+    PROFILE_SCOPE(PROF_EVALUATE);
+
     TRACE_INIT;
 
-    // Do we have a specialized endgame eval for the current configuration ?
-    const EndgameEntry *entry = endgame_probe(board);
+    // Do we have exact bitbase results, a specialized endgame eval, or a KXK
+    // situation (lone King vs mating material) for the current configuration ?
+    // The endgame class is maintained by do_move_gc(), so this is free in the
+    // general case.
+    switch (board->stack->endgameClass)
+    {
+        case EGC_BITBASE: return bitbase_evaluate(board);
+
+        case EGC_SPECIALIZED:
+            return board->stack->endgameEntry->func(board, board->stack->endgameEntry->winningSide);
 
-    if (entry != NULL) return entry->func(board, entry->winningSide);
+        case EGC_KXK_WHITE: return eval_kxk(board, WHITE);
+        case EGC_KXK_BLACK: return eval_kxk(board, BLACK);
+
+        default: break;
+    }
 
-    // Is there a KXK situation ? (lone King vs mating material)
-    if (is_kxk_endgame(board, WHITE)) return eval_kxk(board, WHITE);
-    if (is_kxk_endgame(board, BLACK)) return eval_kxk(board, BLACK);
+    // Use the network evaluation if it has been selected.
+    if (NnueEnabled) return nnue_evaluate(board);
 
     evaluation_t eval;
     scorepair_t tapered = board->psqScorePair;
@@ -873,11 +910,7 @@ score_t evaluate(const Board *board)
     // Compute the evaluation by interpolating between the middlegame and
     // endgame scores.
     {
-        int phase = 4 * popcount(piecetype_bb(board, QUEEN))
-                    + 2 * popcount(piecetype_bb(board, ROOK))
-                    + popcount(piecetypes_bb(board, KNIGHT, BISHOP));
-
-        phase = iclamp(phase, ENDGAME_COUNT, MIDGAME_COUNT);
+        int phase = iclamp(board->stack->phase, ENDGAME_COUNT, MIDGAME_COUNT);
 
         score = mg * (phase - ENDGAME_COUNT) / (MIDGAME_COUNT - ENDGAME_COUNT);
         score += eg * (MIDGAME_COUNT - phase) / (MIDGAME_COUNT - ENDGAME_COUNT);
@@ -888,3 +921,25 @@ score_t evaluate(const Board *board)
     // Return the score relative to the side to move.
     return board->sideToMove == WHITE ? score : -score;
 }
+
+score_t evaluate_cached(const Board *board)
+{
+    Worker *worker = get_worker(board);
+    const hashkey_t key = board->stack->boardKey;
+    EvalCacheEntry *entry = &worker->evalCache[key & (EvalCacheSize - 1)];
+
+    worker->evalCacheProbes++;
+
+    // The lower bits of the key are implied by the entry index, so we only
+    // need to compare the upper ones.
+    if (((*entry ^ key) >> 16) == 0)
+    {
+        worker->evalCacheHits++;
+        return (score_t)(uint16_t)*entry;
+    }
+
+    const score_t eval = evaluate(board);
+
+    *entry = (key & ~(hashkey_t)0xFFFF) | (uint16_t)eval;
+    return eval;
+}
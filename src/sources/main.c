@@ -16,17 +16,24 @@
 **    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "cpu.h"
 #include "endgame.h"
 #include "movelist.h"
+#include "nnue.h"
 #include "option.h"
+#include "relay.h"
 #include "search.h"
+#include "server.h"
+#include "syzygy.h"
 #include "timeman.h"
 #include "tt.h"
 #include "tuner.h"
 #include "uci.h"
 #include "worker.h"
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdio.h>
+#include <string.h>
 
 Board UciBoard = {.stack = NULL};
 pthread_attr_t WorkerSettings;
@@ -36,21 +43,53 @@ Movelist UciSearchMoves;
 
 uint64_t Seed = 1048592ul;
 
-OptionFields UciOptionFields = {1, 16, 100, 1, false, false, false, false, true};
+OptionFields UciOptionFields = {
+    1, 16, 100, 1, 0, 1, TB_MAX_PIECES, 10, false, false, false, false, true, false, true, false,
+    false, false, NULL, NULL, NULL, NULL};
 
 Timeman SearchTimeman;
 
 const char *Delimiters = " \r\t\n";
 
+// Runs an initialization step, and reports its duration when startup
+// profiling is enabled with the --startup-profile flag.
+#define STARTUP_PHASE(profile, call)                                                 \
+    do {                                                                             \
+        const uint64_t phaseStart = micro_clock();                                   \
+        call;                                                                        \
+        if (profile)                                                                 \
+            printf("info string startup %s %" PRIu64 " us\n", #call,                 \
+                micro_clock() - phaseStart);                                         \
+    } while (0)
+
 int main(int argc, char **argv)
 {
-    // Initialize various parts of the engine.
-    bitboard_init();
-    psq_score_init();
-    zobrist_init();
-    cyclic_init();
-    init_kpk_bitbase();
-    init_endgame_table();
+#ifndef TUNE
+    const uint64_t startupStart = micro_clock();
+#endif
+    bool startupProfile = false;
+
+    if (argc > 1 && !strcmp(argv[1], "--startup-profile"))
+    {
+        startupProfile = true;
+        argv[1] = argv[0];
+        ++argv;
+        --argc;
+    }
+
+    // Detect the CPU features first, since fat builds select their code paths
+    // from them.
+    STARTUP_PHASE(startupProfile, cpu_init());
+    STARTUP_PHASE(startupProfile, nnue_init_kernels());
+
+    if (startupProfile)
+        printf("info string startup cpu%s%s%s%s\n", Cpu.avx2 ? " avx2" : "",
+            Cpu.avx512 ? " avx512" : "", Cpu.vnni ? " vnni" : "", Cpu.fastPext ? " fastpext" : "");
+
+    // Initialize various parts of the engine. Most tables are generated at
+    // build time, so only the ones depending on runtime data remain here.
+    STARTUP_PHASE(startupProfile, psq_score_init());
+    STARTUP_PHASE(startupProfile, init_endgame_table());
 
 #ifdef TUNE
 
@@ -64,17 +103,41 @@ int main(int argc, char **argv)
 #else
 
     // Initialize the search-related data along with the worker pool.
-    tt_resize(16);
-    init_search_tables();
+    STARTUP_PHASE(startupProfile, tt_resize(16));
+    STARTUP_PHASE(startupProfile, init_search_tables());
     pthread_attr_init(&WorkerSettings);
     pthread_attr_setstacksize(&WorkerSettings, 4ul * 1024 * 1024);
-    wpool_init(&SearchWorkerPool, 1);
+
+    // The main pool searches with the state set by the UCI commands.
+    SearchWorkerPool.params = &UciSearchParams;
+    SearchWorkerPool.timeman = &SearchTimeman;
+    SearchWorkerPool.searchMoves = &UciSearchMoves;
+    SearchWorkerPool.options = &UciOptionFields;
+    SearchWorkerPool.output = stdout;
+    STARTUP_PHASE(startupProfile, wpool_init(&SearchWorkerPool, 1));
 
     // Wait for the engine thread to be ready, and then start parsing UCI
     // commands.
     worker_wait_search_end(wpool_main_worker(&SearchWorkerPool));
+
+    if (startupProfile)
+    {
+        printf("info string startup total %" PRIu64 " us\n", micro_clock() - startupStart);
+        fflush(stdout);
+    }
+
     uci_loop(argc, argv);
 
+    // Close the server first, since its sessions may still be searching with
+    // the workers of the pool.
+    server_close();
+
+    // Report the time spent in hot-path functions in profiling builds, once
+    // the last search (only stopped by the quit command) has ended.
+    worker_wait_search_end(wpool_main_worker(&SearchWorkerPool));
+    wpool_print_profile(&SearchWorkerPool);
+    relay_close();
+
     // Destroy all allocated memory.
     wpool_init(&SearchWorkerPool, 0);
     tt_resize(0);
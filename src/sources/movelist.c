@@ -17,6 +17,7 @@
 */
 
 #include "movelist.h"
+#include "profile.h"
 #include <string.h>
 
 INLINED ExtendedMove *create_promotions(ExtendedMove *movelist, square_t to, direction_t direction)
@@ -146,6 +147,8 @@ ExtendedMove *generate_pawn_capture_moves(ExtendedMove *restrict movelist,
 ExtendedMove *generate_captures(
     ExtendedMove *restrict movelist, const Board *restrict board, bool inQsearch)
 {
+    PROFILE_SCOPE(PROF_GENERATE);
+
     color_t us = board->sideToMove;
     bitboard_t target = color_bb(board, not_color(us));
     square_t kingSquare = get_king_square(board, us);
@@ -193,6 +196,8 @@ ExtendedMove *generate_quiet_pawn_moves(
 
 ExtendedMove *generate_quiet(ExtendedMove *restrict movelist, const Board *restrict board)
 {
+    PROFILE_SCOPE(PROF_GENERATE);
+
     color_t us = board->sideToMove;
     bitboard_t target = ~occupancy_bb(board);
 
@@ -293,6 +298,8 @@ ExtendedMove *generate_classic_pawn_moves(
 
 ExtendedMove *generate_classic(ExtendedMove *restrict movelist, const Board *restrict board)
 {
+    PROFILE_SCOPE(PROF_GENERATE);
+
     color_t us = board->sideToMove;
     bitboard_t target = ~color_bb(board, us);
 
@@ -402,6 +409,8 @@ ExtendedMove *generate_pawn_evasion_moves(ExtendedMove *restrict movelist,
 
 ExtendedMove *generate_evasions(ExtendedMove *restrict movelist, const Board *restrict board)
 {
+    PROFILE_SCOPE(PROF_GENERATE);
+
     color_t us = board->sideToMove;
     square_t kingSquare = get_king_square(board, us);
     bitboard_t sliderAttacks = 0;
@@ -438,6 +447,8 @@ ExtendedMove *generate_evasions(ExtendedMove *restrict movelist, const Board *re
 
 ExtendedMove *generate_all(ExtendedMove *restrict movelist, const Board *restrict board)
 {
+    PROFILE_SCOPE(PROF_GENERATE);
+
     color_t us = board->sideToMove;
     bitboard_t pinned = board->stack->kingBlockers[us] & color_bb(board, us);
     square_t kingSquare = get_king_square(board, us);
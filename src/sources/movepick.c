@@ -17,6 +17,7 @@
 */
 
 #include "movepick.h"
+#include "profile.h"
 
 void movepicker_init(Movepicker *mp, bool inQsearch, const Board *board, const Worker *worker,
     move_t ttMove, Searchstack *ss)
@@ -141,6 +142,8 @@ static void score_evasions(Movepicker *mp, ExtendedMove *begin, ExtendedMove *en
 
 move_t movepicker_next_move(Movepicker *mp, bool skipQuiets, int see_threshold)
 {
+    PROFILE_SCOPE(PROF_NEXT_MOVE);
+
 top:
 
     switch (mp->stage)
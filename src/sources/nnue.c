@@ -0,0 +1,417 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "nnue.h"
+#include "board.h"
+#include "cpu.h"
+#include "nnue_kernels.h"
+#include "worker.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Layout of the network file:
+// - a 64-byte header;
+// - the feature transformer biases (int16_t[NNUE_HIDDEN]);
+// - the feature transformer weights (int16_t[NNUE_INPUTS][NNUE_HIDDEN]);
+// - the output weights, side to move first (int8_t[2 * NNUE_HIDDEN]);
+// - the output bias (int32_t).
+// All values are stored in little-endian order.
+typedef struct _NnueHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t inputs;
+    uint32_t hidden;
+    uint32_t reserved[11];
+} NnueHeader;
+
+static const char NnueMagic[8] = "StashNN";
+
+enum
+{
+    NnueVersion = 1,
+    NnueBiasesOffset = sizeof(NnueHeader),
+    NnueWeightsOffset = NnueBiasesOffset + NNUE_HIDDEN * sizeof(int16_t),
+    NnueOutputOffset = NnueWeightsOffset + NNUE_INPUTS * NNUE_HIDDEN * sizeof(int16_t),
+    NnueOutputBiasOffset = NnueOutputOffset + 2 * NNUE_HIDDEN * sizeof(int8_t),
+    NnueFileSize = NnueOutputBiasOffset + sizeof(int32_t)
+};
+
+// Struct for the currently loaded network
+typedef struct _NnueNetwork
+{
+    const int16_t *ftBiases;
+    const int16_t *ftWeights;
+    const int8_t *outWeights;
+    int32_t outBias;
+    void *data;
+    int generation;
+} NnueNetwork;
+
+static NnueNetwork CurrentNet = {NULL, NULL, NULL, 0, NULL, 0};
+
+bool NnueEnabled = false;
+
+#ifdef USE_DISPATCH
+
+typedef void (*accumulator_apply_t)(int16_t *, const int16_t *, const int16_t *, const size_t *,
+    int, const size_t *, int);
+typedef int32_t (*output_dot_t)(const int16_t *restrict, const int8_t *restrict);
+
+// Kernels selected for the running CPU by nnue_init_kernels().
+static accumulator_apply_t accumulator_apply = &nnue_accumulator_apply;
+static output_dot_t output_dot = &nnue_output_dot;
+
+#else
+
+#define accumulator_apply nnue_accumulator_apply
+#define output_dot nnue_output_dot
+
+#endif
+
+void nnue_init_kernels(void)
+{
+#ifdef USE_DISPATCH
+    if (Cpu.vnni)
+    {
+        accumulator_apply = &nnue_accumulator_apply_vnni512;
+        output_dot = &nnue_output_dot_vnni512;
+    }
+    else if (Cpu.avx512)
+    {
+        accumulator_apply = &nnue_accumulator_apply_avx512;
+        output_dot = &nnue_output_dot_avx512;
+    }
+    else if (Cpu.avx2)
+    {
+        accumulator_apply = &nnue_accumulator_apply_avx2;
+        output_dot = &nnue_output_dot_avx2;
+    }
+#endif
+}
+
+// Returns the feature index of the given piece from the given perspective.
+INLINED size_t feature_index(color_t perspective, square_t kingSquare, piece_t piece, square_t square)
+{
+    const size_t pieceIndex = (piece_type(piece) - PAWN) * 2 + (piece_color(piece) != perspective);
+
+    return ((size_t)relative_sq(kingSquare, perspective) * NNUE_PIECE_INDEXES + pieceIndex)
+               * SQUARE_NB
+           + relative_sq(square, perspective);
+}
+
+// Computes the accumulator of the given perspective from scratch.
+static void accumulator_refresh(const Board *board, NnueAccumulator *acc, color_t perspective)
+{
+    const square_t kingSquare = get_king_square(board, perspective);
+    bitboard_t pieces = occupancy_bb(board) & ~piecetype_bb(board, KING);
+    size_t active[32];
+    int count = 0;
+
+    while (pieces)
+    {
+        const square_t square = bb_pop_first_sq(&pieces);
+
+        active[count++] = feature_index(perspective, kingSquare, piece_on(board, square), square);
+    }
+
+    accumulator_apply(acc->values[perspective], CurrentNet.ftBiases, CurrentNet.ftWeights, active,
+        count, NULL, 0);
+    acc->computed[perspective] = true;
+}
+
+void nnue_finny_reset(NnueFinnyTable *table)
+{
+    // Force a reinitialization of the entries on the next refresh.
+    table->generation = -1;
+}
+
+// Computes the accumulator of the given perspective using the cached
+// accumulator for the current King square.
+static void accumulator_refresh_cached(
+    const Board *board, NnueFinnyTable *table, NnueAccumulator *acc, color_t perspective)
+{
+    // Reset the entries if they were computed with another network.
+    if (table->generation != CurrentNet.generation)
+    {
+        for (color_t c = WHITE; c <= BLACK; ++c)
+            for (square_t s = SQ_A1; s <= SQ_H8; ++s)
+            {
+                NnueFinnyEntry *entry = &table->entries[c][s];
+
+                memcpy(entry->values, CurrentNet.ftBiases, sizeof(entry->values));
+                memset(entry->pieces, 0, sizeof(entry->pieces));
+            }
+
+        table->generation = CurrentNet.generation;
+    }
+
+    const square_t kingSquare = get_king_square(board, perspective);
+    NnueFinnyEntry *entry = &table->entries[perspective][kingSquare];
+    size_t added[32], removed[32];
+    int addCount = 0, removeCount = 0;
+
+    // Compute the list of features that changed since the last time the entry
+    // was used.
+    for (color_t c = WHITE; c <= BLACK; ++c)
+        for (piecetype_t pt = PAWN; pt <= QUEEN; ++pt)
+        {
+            const piece_t piece = create_piece(c, pt);
+            const bitboard_t current = piece_bb(board, c, pt);
+            bitboard_t removedBB = entry->pieces[c][pt] & ~current;
+            bitboard_t addedBB = current & ~entry->pieces[c][pt];
+
+            while (removedBB)
+                removed[removeCount++] =
+                    feature_index(perspective, kingSquare, piece, bb_pop_first_sq(&removedBB));
+
+            while (addedBB)
+                added[addCount++] =
+                    feature_index(perspective, kingSquare, piece, bb_pop_first_sq(&addedBB));
+
+            entry->pieces[c][pt] = current;
+        }
+
+    accumulator_apply(entry->values, entry->values, CurrentNet.ftWeights, added, addCount, removed,
+        removeCount);
+    memcpy(acc->values[perspective], entry->values, sizeof(entry->values));
+    acc->computed[perspective] = true;
+}
+
+// Updates the accumulator of the given stack from its parent's one.
+static void accumulator_update(Boardstack *stack, square_t kingSquare, color_t perspective)
+{
+    const DirtyPieces *dp = &stack->dirtyPieces;
+    size_t added[3], removed[3];
+    int addCount = 0, removeCount = 0;
+
+    for (int i = 0; i < dp->count; ++i)
+    {
+        // The King of the other side isn't part of the features.
+        if (piece_type(dp->piece[i]) == KING) continue;
+
+        if (dp->from[i] != SQ_NONE)
+            removed[removeCount++] = feature_index(perspective, kingSquare, dp->piece[i], dp->from[i]);
+
+        if (dp->to[i] != SQ_NONE)
+            added[addCount++] = feature_index(perspective, kingSquare, dp->piece[i], dp->to[i]);
+    }
+
+    accumulator_apply(stack->accumulator.values[perspective],
+        stack->prev->accumulator.values[perspective], CurrentNet.ftWeights, added, addCount,
+        removed, removeCount);
+    stack->accumulator.computed[perspective] = true;
+}
+
+// Checks if the King of the given color moved during the last move.
+INLINED bool king_moved(const DirtyPieces *dp, color_t color)
+{
+    for (int i = 0; i < dp->count; ++i)
+        if (dp->piece[i] == create_piece(color, KING)) return true;
+
+    return false;
+}
+
+// Makes sure the accumulator of the current position is up-to-date for the
+// given perspective.
+static void accumulator_ensure(const Board *board, color_t perspective)
+{
+    // Beyond this many plies, a full refresh is cheaper than a chain of
+    // incremental updates.
+    enum
+    {
+        MaxUpdateChain = 12
+    };
+
+    Boardstack *chain[MaxUpdateChain];
+    Boardstack *stack = board->stack;
+    int length = 0;
+
+    // Walk back the stack list until we find a computed accumulator. If the
+    // King moved along the way, the features changed entirely and we need to
+    // recompute the accumulator from scratch.
+    while (!stack->accumulator.computed[perspective])
+    {
+        if (length == MaxUpdateChain || stack->prev == NULL
+            || king_moved(&stack->dirtyPieces, perspective))
+        {
+            Worker *worker = get_worker(board);
+
+            if (worker != NULL)
+                accumulator_refresh_cached(
+                    board, &worker->finnyTable, &board->stack->accumulator, perspective);
+            else
+                accumulator_refresh(board, &board->stack->accumulator, perspective);
+
+            return;
+        }
+
+        chain[length++] = stack;
+        stack = stack->prev;
+    }
+
+    const square_t kingSquare = get_king_square(board, perspective);
+
+    // Apply the piece changes in order, keeping the intermediate accumulators
+    // so that sibling nodes can reuse them.
+    while (length--) accumulator_update(chain[length], kingSquare, perspective);
+}
+
+score_t nnue_evaluate(const Board *board)
+{
+    const color_t us = board->sideToMove, them = not_color(us);
+
+    accumulator_ensure(board, WHITE);
+    accumulator_ensure(board, BLACK);
+
+    const NnueAccumulator *acc = &board->stack->accumulator;
+    int32_t output = CurrentNet.outBias;
+
+    output += output_dot(acc->values[us], CurrentNet.outWeights);
+    output += output_dot(acc->values[them], CurrentNet.outWeights + NNUE_HIDDEN);
+
+    const int32_t score = (int64_t)output * NnueOutputScale / (NnueQA * NnueQB);
+
+    // Keep the network output out of the mate score range.
+    return (score_t)iclamp(score, -MATE_FOUND + 1, MATE_FOUND - 1);
+}
+
+static void nnue_release(void *data)
+{
+    if (data == NULL) return;
+
+#ifndef _WIN32
+    munmap(data, NnueFileSize);
+#else
+    free(data);
+#endif
+}
+
+static void *nnue_map_file(const char *path)
+{
+#ifndef _WIN32
+    const int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+    {
+        printf("info string Unable to open network '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || st.st_size != (off_t)NnueFileSize)
+    {
+        printf("info string Invalid network '%s': wrong file size\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    // Map the file read-only and shared, so that multiple engine instances
+    // loading the same network share the same physical pages.
+    void *data = mmap(NULL, NnueFileSize, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        printf("info string Unable to map network '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    return data;
+#else
+    FILE *f = fopen(path, "rb");
+
+    if (f == NULL)
+    {
+        printf("info string Unable to open network '%s': %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    void *data = malloc(NnueFileSize);
+
+    if (data == NULL)
+    {
+        perror("Unable to allocate network");
+        exit(EXIT_FAILURE);
+    }
+
+    if (fread(data, 1, NnueFileSize, f) != NnueFileSize || fgetc(f) != EOF)
+    {
+        printf("info string Invalid network '%s': wrong file size\n", path);
+        free(data);
+        data = NULL;
+    }
+
+    fclose(f);
+    return data;
+#endif
+}
+
+bool nnue_load(const char *path)
+{
+    void *data = nnue_map_file(path);
+
+    if (data == NULL) return false;
+
+    const NnueHeader *header = data;
+
+    if (memcmp(header->magic, NnueMagic, sizeof(NnueMagic)) || header->version != NnueVersion
+        || header->inputs != NNUE_INPUTS || header->hidden != NNUE_HIDDEN)
+    {
+        printf("info string Invalid network '%s': unsupported architecture\n", path);
+        nnue_release(data);
+        return false;
+    }
+
+    const int generation = CurrentNet.generation;
+
+    nnue_unload();
+
+    const char *bytes = data;
+
+    CurrentNet.ftBiases = (const int16_t *)(bytes + NnueBiasesOffset);
+    CurrentNet.ftWeights = (const int16_t *)(bytes + NnueWeightsOffset);
+    CurrentNet.outWeights = (const int8_t *)(bytes + NnueOutputOffset);
+    memcpy(&CurrentNet.outBias, bytes + NnueOutputBiasOffset, sizeof(int32_t));
+    CurrentNet.data = data;
+    CurrentNet.generation = generation + 1;
+    return true;
+}
+
+void nnue_unload(void)
+{
+    const int generation = CurrentNet.generation;
+
+    nnue_release(CurrentNet.data);
+    memset(&CurrentNet, 0, sizeof(NnueNetwork));
+    CurrentNet.generation = generation;
+    NnueEnabled = false;
+}
+
+bool nnue_is_loaded(void) { return CurrentNet.data != NULL; }
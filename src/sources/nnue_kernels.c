@@ -0,0 +1,194 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "nnue_kernels.h"
+#include "nnue.h"
+#include <string.h>
+
+#if defined(__AVX512BW__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// Fat builds compile this file once per instruction set, with a different
+// suffix for the function names.
+#ifndef NNUE_KERNEL_SUFFIX
+#define NNUE_KERNEL_SUFFIX
+#endif
+
+#if defined(__AVX512BW__)
+
+typedef __m512i vec_t;
+enum
+{
+    VecLanes = 32
+};
+#define vec_load(p) _mm512_loadu_si512((const void *)(p))
+#define vec_store(p, v) _mm512_storeu_si512((void *)(p), v)
+#define vec_add_16(a, b) _mm512_add_epi16(a, b)
+#define vec_sub_16(a, b) _mm512_sub_epi16(a, b)
+
+#elif defined(__AVX2__)
+
+typedef __m256i vec_t;
+enum
+{
+    VecLanes = 16
+};
+#define vec_load(p) _mm256_loadu_si256((const vec_t *)(p))
+#define vec_store(p, v) _mm256_storeu_si256((vec_t *)(p), v)
+#define vec_add_16(a, b) _mm256_add_epi16(a, b)
+#define vec_sub_16(a, b) _mm256_sub_epi16(a, b)
+
+#elif defined(__SSE2__)
+
+typedef __m128i vec_t;
+enum
+{
+    VecLanes = 8
+};
+#define vec_load(p) _mm_loadu_si128((const vec_t *)(p))
+#define vec_store(p, v) _mm_storeu_si128((vec_t *)(p), v)
+#define vec_add_16(a, b) _mm_add_epi16(a, b)
+#define vec_sub_16(a, b) _mm_sub_epi16(a, b)
+
+#endif
+
+void NNUE_KERNEL_NAME(nnue_accumulator_apply, NNUE_KERNEL_SUFFIX)(int16_t *dst,
+    const int16_t *src, const int16_t *weights, const size_t *added, int addCount,
+    const size_t *removed, int removeCount)
+{
+#if defined(__AVX512BW__) || defined(__AVX2__) || defined(__SSE2__)
+    enum
+    {
+        Registers = 8,
+        ChunkSize = Registers * VecLanes
+    };
+
+    // Process the accumulator in chunks small enough to fit in registers, so
+    // that each weight row is streamed through only once per chunk.
+    for (size_t chunk = 0; chunk < NNUE_HIDDEN; chunk += ChunkSize)
+    {
+        vec_t regs[Registers];
+
+        for (int k = 0; k < Registers; ++k) regs[k] = vec_load(src + chunk + k * VecLanes);
+
+        for (int i = 0; i < removeCount; ++i)
+        {
+            const int16_t *row = weights + removed[i] * NNUE_HIDDEN + chunk;
+
+            for (int k = 0; k < Registers; ++k)
+                regs[k] = vec_sub_16(regs[k], vec_load(row + k * VecLanes));
+        }
+
+        for (int i = 0; i < addCount; ++i)
+        {
+            const int16_t *row = weights + added[i] * NNUE_HIDDEN + chunk;
+
+            for (int k = 0; k < Registers; ++k)
+                regs[k] = vec_add_16(regs[k], vec_load(row + k * VecLanes));
+        }
+
+        for (int k = 0; k < Registers; ++k) vec_store(dst + chunk + k * VecLanes, regs[k]);
+    }
+#else
+    memmove(dst, src, sizeof(int16_t) * NNUE_HIDDEN);
+
+    for (int i = 0; i < removeCount; ++i)
+    {
+        const int16_t *row = weights + removed[i] * NNUE_HIDDEN;
+
+        for (size_t k = 0; k < NNUE_HIDDEN; ++k) dst[k] -= row[k];
+    }
+
+    for (int i = 0; i < addCount; ++i)
+    {
+        const int16_t *row = weights + added[i] * NNUE_HIDDEN;
+
+        for (size_t k = 0; k < NNUE_HIDDEN; ++k) dst[k] += row[k];
+    }
+#endif
+}
+
+int32_t NNUE_KERNEL_NAME(nnue_output_dot, NNUE_KERNEL_SUFFIX)(
+    const int16_t *restrict values, const int8_t *restrict weights)
+{
+#if defined(__AVX512BW__)
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i clipMax = _mm512_set1_epi16(NnueQA);
+    __m512i sum = _mm512_setzero_si512();
+
+    for (size_t i = 0; i < NNUE_HIDDEN; i += 32)
+    {
+        __m512i v = _mm512_loadu_si512((const void *)(values + i));
+        __m512i w = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i *)(weights + i)));
+
+        v = _mm512_min_epi16(_mm512_max_epi16(v, zero), clipMax);
+#if defined(__AVX512VNNI__)
+        sum = _mm512_dpwssd_epi32(sum, v, w);
+#else
+        sum = _mm512_add_epi32(sum, _mm512_madd_epi16(v, w));
+#endif
+    }
+
+    return _mm512_reduce_add_epi32(sum);
+#elif defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i clipMax = _mm256_set1_epi16(NnueQA);
+    __m256i sum = _mm256_setzero_si256();
+
+    for (size_t i = 0; i < NNUE_HIDDEN; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+        __m256i w = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)(weights + i)));
+
+        v = _mm256_min_epi16(_mm256_max_epi16(v, zero), clipMax);
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));
+    }
+
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+    return _mm_cvtsi128_si32(sum128);
+#elif defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i clipMax = _mm_set1_epi16(NnueQA);
+    __m128i sum = _mm_setzero_si128();
+
+    for (size_t i = 0; i < NNUE_HIDDEN; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(values + i));
+        __m128i w = _mm_loadl_epi64((const __m128i *)(weights + i));
+
+        // Sign-extend the weights to 16 bits.
+        w = _mm_unpacklo_epi8(w, _mm_cmpgt_epi8(zero, w));
+        v = _mm_min_epi16(_mm_max_epi16(v, zero), clipMax);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(v, w));
+    }
+
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t sum = 0;
+
+    for (size_t i = 0; i < NNUE_HIDDEN; ++i) sum += iclamp(values[i], 0, NnueQA) * weights[i];
+
+    return sum;
+#endif
+}
@@ -18,7 +18,13 @@
 
 #include "pawns.h"
 #include "evaluate.h"
+#include "profile.h"
 #include "worker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+SharedPawnTable SearchPawnTable = {0, NULL};
 
 // clang-format off
 
@@ -199,19 +205,20 @@ scorepair_t evaluate_doubled_isolated(bitboard_t bb, color_t us __attribute__((u
     return ret;
 }
 
-PawnEntry *pawn_probe(const Board *board)
+// Returns a checksum of the given entry contents, used for verifying the
+// entries of the shared table.
+INLINED hashkey_t pawn_entry_checksum(const PawnEntry *entry)
 {
-#ifndef TUNE
-    // Check if this pawn structure has already been evaluated.
-    PawnEntry *entry = get_worker(board)->pawnTable + (board->stack->pawnKey % PawnTableSize);
+    hashkey_t checksum = (uint32_t)entry->value;
 
-    if (entry->key == board->stack->pawnKey) return entry;
+    for (color_t c = WHITE; c <= BLACK; ++c)
+        checksum ^= entry->attackSpan[c] ^ entry->attacks[c] ^ entry->attacks2[c] ^ entry->passed[c];
 
-#else
-    static PawnEntry e;
-    PawnEntry *entry = &e;
-#endif
+    return checksum;
+}
 
+static void pawn_entry_compute(const Board *board, PawnEntry *entry)
+{
     // Reset the entry contents.
     entry->key = board->stack->pawnKey;
     entry->value = 0;
@@ -236,8 +243,89 @@ PawnEntry *pawn_probe(const Board *board)
     entry->value -= evaluate_passed(entry, BLACK, bpawns, wpawns);
     entry->value += evaluate_doubled_isolated(wpawns, WHITE);
     entry->value -= evaluate_doubled_isolated(bpawns, BLACK);
+}
+
+#ifndef TUNE
+static PawnEntry *shared_pawn_probe(const Board *board, Worker *worker)
+{
+    const hashkey_t key = board->stack->pawnKey;
+    PawnEntry *slot = SearchPawnTable.table + mul_hi64(key, SearchPawnTable.entryCount);
+    PawnEntry *entry = &worker->pawnScratch;
+
+    // Work on a private copy of the entry, since other workers might write to
+    // the slot at the same time.
+    *entry = *slot;
+
+    if ((entry->key ^ pawn_entry_checksum(entry)) == key)
+    {
+        worker->pawnHits++;
+        entry->key = key;
+        return entry;
+    }
+
+    pawn_entry_compute(board, entry);
+
+    // Publish the new entry for the other workers.
+    *slot = *entry;
+    slot->key = key ^ pawn_entry_checksum(entry);
+    return entry;
+}
+#endif
+
+PawnEntry *pawn_probe(const Board *board)
+{
+    PROFILE_SCOPE(PROF_PAWN_PROBE);
+
+#ifndef TUNE
+    Worker *worker = get_worker(board);
+
+    worker->pawnProbes++;
+
+    if (SearchPawnTable.table != NULL) return shared_pawn_probe(board, worker);
+
+    // Check if this pawn structure has already been evaluated.
+    PawnEntry *entry = worker->pawnTable + (board->stack->pawnKey % PawnTableSize);
+
+    if (entry->key == board->stack->pawnKey)
+    {
+        worker->pawnHits++;
+        return entry;
+    }
+
+#else
+    static _Thread_local PawnEntry e;
+    PawnEntry *entry = &e;
+#endif
+
+    pawn_entry_compute(board, entry);
 
     // Return the entry pointer since the evaluation will make use of some of
     // the fields (like the Pawn attack span).
     return entry;
 }
+
+void pawn_table_resize(size_t mbsize)
+{
+    free(SearchPawnTable.table);
+    SearchPawnTable.table = NULL;
+    SearchPawnTable.entryCount = 0;
+
+    if (mbsize == 0) return;
+
+    SearchPawnTable.entryCount = mbsize * 1024 * 1024 / sizeof(PawnEntry);
+    SearchPawnTable.table = malloc(SearchPawnTable.entryCount * sizeof(PawnEntry));
+
+    if (SearchPawnTable.table == NULL)
+    {
+        perror("Failed to allocate shared pawn table");
+        exit(EXIT_FAILURE);
+    }
+
+    pawn_table_clear();
+}
+
+void pawn_table_clear(void)
+{
+    if (SearchPawnTable.table != NULL)
+        memset(SearchPawnTable.table, 0, SearchPawnTable.entryCount * sizeof(PawnEntry));
+}
@@ -0,0 +1,67 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "profile.h"
+#include <inttypes.h>
+#include <stdio.h>
+
+#ifdef PROFILE
+
+// Counters for the threads which aren't search workers.
+static ProfileData DefaultProfile;
+
+_Thread_local ProfileData *ThreadProfile = &DefaultProfile;
+_Thread_local ProfileScope *ThreadScope = NULL;
+
+#endif
+
+static const char *ProfileNames[PROF_COUNT] = {
+    "search",
+    "evaluate",
+    "pawn_probe",
+    "generate",
+    "see_greater_than",
+    "tt_probe",
+    "do_move_gc",
+    "movepicker_next_move",
+};
+
+void profile_print(const ProfileData *profile, const char *name)
+{
+    uint64_t total = 0;
+
+    for (int i = 0; i < PROF_COUNT; ++i) total += profile->cycles[i];
+
+    printf("Profile for %s: %" PRIu64 " cycles, %" PRIu64 " nodes (%.1lf cycles/node)\n", name,
+        total, profile->nodes, profile->nodes ? (double)total / profile->nodes : 0.0);
+    printf("    %-20s %14s %12s %10s %10s %7s\n", "function", "cycles", "calls", "cyc/call",
+        "cyc/node", "share");
+
+    for (int i = 0; i < PROF_COUNT; ++i)
+    {
+        const uint64_t cycles = profile->cycles[i];
+        const uint64_t calls = profile->calls[i];
+
+        printf("    %-20s %14" PRIu64 " %12" PRIu64 " %10.1lf %10.1lf %6.2lf%%\n", ProfileNames[i],
+            cycles, calls, calls ? (double)cycles / calls : 0.0,
+            profile->nodes ? (double)cycles / profile->nodes : 0.0,
+            total ? 100.0 * cycles / total : 0.0);
+    }
+
+    fflush(stdout);
+}
@@ -0,0 +1,556 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "relay.h"
+#include "timeman.h"
+#include "transport.h"
+#include "tt.h"
+#include "uci.h"
+#include "worker.h"
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+enum
+{
+    RELAY_MAX_MEMBERS = 64,
+    RELAY_TIMEOUT = 1000,      // Maximal wait for a member's result, in milliseconds
+    RELAY_PUMP_INTERVAL = 20,  // Delay between two flushes of the shared entries
+    RELAY_INFO_PERIOD = 5,     // Number of flushes between two progress reports
+    RELAY_QUEUE_SIZE = 1024
+};
+
+// Struct for the state of a member, as seen by the leader.
+typedef struct _RelayMember
+{
+    int fd;
+    uint64_t nodes;
+    int depth;
+    int score;
+    char bestmove[8];
+    bool hasResult;
+} RelayMember;
+
+// Struct for a TT entry waiting to be sent to the other nodes.
+typedef struct _SharedEntry
+{
+    hashkey_t key;
+    score_t score;
+    score_t eval;
+    int depth;
+    int bound;
+    move_t move;
+} SharedEntry;
+
+int RelayShareDepth;
+
+static char *PositionArgs;
+static int ListenFd = -1;
+static int LeaderFd = -1;
+static RelayMember Members[RELAY_MAX_MEMBERS];
+static size_t MemberCount;
+static char ListenAddress[256];
+static pthread_t AcceptThread;
+static pthread_t PumpThread;
+static atomic_bool PumpActive;
+static pthread_mutex_t RelayMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t RelayResultCond = PTHREAD_COND_INITIALIZER;
+
+static SharedEntry EntryQueue[RELAY_QUEUE_SIZE];
+static size_t EntryCount;
+static pthread_mutex_t EntryMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Progress of the current search, reported by members to the leader.
+static int ProgressDepth;
+static int ProgressScore;
+static char ProgressMove[8] = "0000";
+
+static void *relay_accept_loop(void *data)
+{
+    (void)data;
+
+    int fd;
+
+    // Closing the listening socket makes the accept fail and ends the loop.
+    while ((fd = transport_accept(ListenFd)) >= 0)
+    {
+        pthread_mutex_lock(&RelayMutex);
+
+        if (MemberCount < RELAY_MAX_MEMBERS)
+            Members[MemberCount++] = (RelayMember){fd, 0, 0, 0, "0000", false};
+        else
+            transport_close(fd);
+
+        pthread_mutex_unlock(&RelayMutex);
+    }
+
+    return NULL;
+}
+
+// Returns the member connected on the given socket, which must be called with
+// the relay mutex held.
+static RelayMember *relay_find_member(int fd)
+{
+    for (size_t i = 0; i < MemberCount; ++i)
+        if (Members[i].fd == fd) return &Members[i];
+
+    return NULL;
+}
+
+// Removes the given member, which must be called with the relay mutex held.
+static void relay_drop_member(RelayMember *member)
+{
+    transport_close(member->fd);
+    *member = Members[--MemberCount];
+}
+
+// Sends the given message to all members except the one connected on the
+// given socket, which must be called with the relay mutex held. Members which
+// have disconnected are detected and removed by the pump thread.
+static void relay_broadcast(const char *message, int exceptFd)
+{
+    for (size_t i = 0; i < MemberCount; ++i)
+        if (Members[i].fd != exceptFd) transport_send(Members[i].fd, message);
+}
+
+// Stores a TT entry received from another node, unless we already have a
+// deeper one for the same position.
+static void relay_apply_entry(const char *line)
+{
+    uint64_t key;
+    int score, eval, depth, bound, move;
+
+    if (sscanf(line, "tt %" SCNx64 " %d %d %d %d %d", &key, &score, &eval, &depth, &bound, &move)
+        != 6)
+        return;
+
+    bool found;
+    TT_Entry *entry = tt_probe(key, &found);
+
+    if (!found || depth > entry->depth)
+        tt_save(entry, key, (score_t)score, (score_t)eval, depth, bound, (move_t)move);
+}
+
+// Sends all queued TT entries to the other nodes.
+static void relay_flush_entries(void)
+{
+    static SharedEntry entries[RELAY_QUEUE_SIZE];
+    char message[4096];
+    size_t count, length = 0;
+
+    pthread_mutex_lock(&EntryMutex);
+    count = EntryCount;
+    memcpy(entries, EntryQueue, sizeof(SharedEntry) * count);
+    EntryCount = 0;
+    pthread_mutex_unlock(&EntryMutex);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        length += sprintf(message + length, "tt %" PRIx64 " %d %d %d %d %d\n",
+            (uint64_t)entries[i].key, (int)entries[i].score, (int)entries[i].eval,
+            entries[i].depth, entries[i].bound, (int)entries[i].move);
+
+        // Send the entries by batches to limit the number of writes.
+        if (length + 128 > sizeof(message) || i + 1 == count)
+        {
+            pthread_mutex_lock(&RelayMutex);
+
+            if (ListenFd >= 0)
+                relay_broadcast(message, -1);
+            else
+                transport_send(LeaderFd, message);
+
+            pthread_mutex_unlock(&RelayMutex);
+            length = 0;
+        }
+    }
+}
+
+// Handles a line sent by a member to the leader.
+static void relay_handle_member_line(int fd, const char *line)
+{
+    pthread_mutex_lock(&RelayMutex);
+
+    RelayMember *member = relay_find_member(fd);
+    RelayMember update = *member;
+
+    if (!strncmp(line, "tt ", 3))
+    {
+        relay_apply_entry(line);
+
+        // Forward the entry to the other members.
+        char message[128];
+
+        snprintf(message, sizeof(message), "%s\n", line);
+        relay_broadcast(message, fd);
+    }
+    else if (sscanf(line, "info %" SCNu64 " %d %d %7s", &update.nodes, &update.depth,
+                 &update.score, update.bestmove)
+             == 4)
+        *member = update;
+    else if (sscanf(line, "result %7s %d %d %" SCNu64, update.bestmove, &update.score,
+                 &update.depth, &update.nodes)
+             == 4)
+    {
+        *member = update;
+        member->hasResult = true;
+        pthread_cond_broadcast(&RelayResultCond);
+    }
+
+    pthread_mutex_unlock(&RelayMutex);
+}
+
+// Leader side: reads all pending lines from the members.
+static void relay_poll_members(void)
+{
+    int fds[RELAY_MAX_MEMBERS] = {0};
+    bool ready[RELAY_MAX_MEMBERS] = {0};
+    size_t count;
+    char line[256];
+
+    pthread_mutex_lock(&RelayMutex);
+    count = MemberCount;
+
+    for (size_t i = 0; i < count; ++i) fds[i] = Members[i].fd;
+
+    pthread_mutex_unlock(&RelayMutex);
+
+    if (transport_poll(fds, ready, count, RELAY_PUMP_INTERVAL) == 0) return;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!ready[i]) continue;
+
+        if (transport_read_line(fds[i], line, sizeof(line), RELAY_TIMEOUT))
+            relay_handle_member_line(fds[i], line);
+        else
+        {
+            pthread_mutex_lock(&RelayMutex);
+            relay_drop_member(relay_find_member(fds[i]));
+            pthread_cond_broadcast(&RelayResultCond);
+            pthread_mutex_unlock(&RelayMutex);
+        }
+    }
+}
+
+// Member side: reports the progress of the current search to the leader.
+static void relay_send_progress(void)
+{
+    static uint64_t lastNodes;
+    uint64_t nodes = wpool_get_total_nodes(&SearchWorkerPool);
+    char message[128];
+
+    // Don't send anything while we're idle.
+    if (nodes == lastNodes) return;
+
+    lastNodes = nodes;
+
+    pthread_mutex_lock(&RelayMutex);
+    snprintf(message, sizeof(message), "info %" PRIu64 " %d %d %s\n", nodes, ProgressDepth,
+        ProgressScore, ProgressMove);
+    transport_send(LeaderFd, message);
+    pthread_mutex_unlock(&RelayMutex);
+}
+
+static void *relay_pump_loop(void *data)
+{
+    (void)data;
+
+    for (int flushes = 0; atomic_load_explicit(&PumpActive, memory_order_relaxed); ++flushes)
+    {
+        relay_flush_entries();
+
+        if (ListenFd >= 0)
+            relay_poll_members();
+        else
+        {
+            if (flushes % RELAY_INFO_PERIOD == 0) relay_send_progress();
+
+            transport_poll(NULL, NULL, 0, RELAY_PUMP_INTERVAL);
+        }
+    }
+
+    return NULL;
+}
+
+static void relay_start_pump(void)
+{
+    atomic_store_explicit(&PumpActive, true, memory_order_relaxed);
+
+    if (pthread_create(&PumpThread, NULL, &relay_pump_loop, NULL))
+    {
+        perror("Unable to start relay");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void relay_stop_pump(void)
+{
+    atomic_store_explicit(&PumpActive, false, memory_order_relaxed);
+    pthread_join(PumpThread, NULL);
+}
+
+bool relay_serve(const char *address)
+{
+    if (ListenFd >= 0 || LeaderFd >= 0)
+    {
+        puts("info string Relay already active");
+        return false;
+    }
+
+    if (strlen(address) >= sizeof(ListenAddress))
+    {
+        printf("info string Relay address '%s' is too long\n", address);
+        return false;
+    }
+
+    ListenFd = transport_listen(address);
+
+    if (ListenFd < 0)
+    {
+        perror("Unable to open relay socket");
+        return false;
+    }
+
+    strcpy(ListenAddress, address);
+
+    if (pthread_create(&AcceptThread, NULL, &relay_accept_loop, NULL))
+    {
+        perror("Unable to start relay");
+        exit(EXIT_FAILURE);
+    }
+
+    relay_start_pump();
+    printf("info string Relay listening on '%s'\n", address);
+    return true;
+}
+
+void relay_join(const char *address)
+{
+    if (ListenFd >= 0 || LeaderFd >= 0)
+    {
+        puts("info string Relay already active");
+        return;
+    }
+
+    LeaderFd = transport_connect(address);
+
+    if (LeaderFd < 0)
+    {
+        perror("Unable to join relay");
+        return;
+    }
+
+    relay_start_pump();
+    printf("info string Joined relay on '%s'\n", address);
+    fflush(stdout);
+
+    char line[16384];
+
+    // Execute the leader's commands until it closes the connection. TT entries
+    // shared by the other nodes are stored directly.
+    while (transport_read_line(LeaderFd, line, sizeof(line), -1))
+    {
+        if (!strncmp(line, "tt ", 3))
+            relay_apply_entry(line);
+        else if (execute_uci_cmd(line) == 0)
+            break;
+    }
+
+    execute_uci_cmd("stop");
+    relay_stop_pump();
+    transport_close(LeaderFd);
+    LeaderFd = -1;
+    RelayShareDepth = 0;
+}
+
+void relay_close(void)
+{
+    if (ListenFd >= 0)
+    {
+        relay_stop_pump();
+        transport_close(ListenFd);
+        pthread_join(AcceptThread, NULL);
+        transport_cleanup(ListenAddress);
+        ListenFd = -1;
+        RelayShareDepth = 0;
+
+        // Closing the connections makes all members leave the relay.
+        pthread_mutex_lock(&RelayMutex);
+
+        while (MemberCount) relay_drop_member(&Members[MemberCount - 1]);
+
+        pthread_mutex_unlock(&RelayMutex);
+    }
+
+    free(PositionArgs);
+    PositionArgs = NULL;
+}
+
+void relay_set_position(const char *args)
+{
+    free(PositionArgs);
+    PositionArgs = strdup(args ? args : "startpos");
+
+    if (PositionArgs == NULL)
+    {
+        perror("Unable to allocate relay position");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void relay_start_search(void)
+{
+    // Only share TT entries while we're part of a relay.
+    RelayShareDepth = (ListenFd >= 0 || LeaderFd >= 0) ? (int)UciOptionFields.clusterDepth : 0;
+
+    pthread_mutex_lock(&EntryMutex);
+    EntryCount = 0;
+    pthread_mutex_unlock(&EntryMutex);
+
+    if (LeaderFd >= 0)
+    {
+        ProgressDepth = 0;
+        ProgressScore = 0;
+        strcpy(ProgressMove, "0000");
+    }
+
+    if (ListenFd < 0) return;
+
+    char message[16384];
+
+    snprintf(message, sizeof(message),
+        "setoption name ClusterDepth value %ld\nposition %s\ngo infinite\n",
+        UciOptionFields.clusterDepth, PositionArgs ? PositionArgs : "startpos");
+
+    pthread_mutex_lock(&RelayMutex);
+
+    for (size_t i = 0; i < MemberCount; ++i)
+    {
+        Members[i].nodes = 0;
+        Members[i].depth = 0;
+        Members[i].hasResult = false;
+    }
+
+    relay_broadcast(message, -1);
+    pthread_mutex_unlock(&RelayMutex);
+}
+
+void relay_share_entry(
+    hashkey_t key, score_t score, score_t eval, int depth, int bound, move_t move)
+{
+    pthread_mutex_lock(&EntryMutex);
+
+    // Drop the entry if the pump thread can't keep up.
+    if (EntryCount < RELAY_QUEUE_SIZE)
+        EntryQueue[EntryCount++] = (SharedEntry){key, score, eval, depth, bound, move};
+
+    pthread_mutex_unlock(&EntryMutex);
+}
+
+void relay_update_progress(int depth, score_t score, const char *bestmove)
+{
+    if (LeaderFd < 0) return;
+
+    pthread_mutex_lock(&RelayMutex);
+    ProgressDepth = depth;
+    ProgressScore = score;
+    snprintf(ProgressMove, sizeof(ProgressMove), "%s", bestmove);
+    pthread_mutex_unlock(&RelayMutex);
+}
+
+uint64_t relay_member_nodes(void)
+{
+    uint64_t nodes = 0;
+
+    if (ListenFd < 0) return 0;
+
+    pthread_mutex_lock(&RelayMutex);
+
+    for (size_t i = 0; i < MemberCount; ++i) nodes += Members[i].nodes;
+
+    pthread_mutex_unlock(&RelayMutex);
+    return nodes;
+}
+
+void relay_collect_results(uint64_t nodes, int depth, clock_t elapsed)
+{
+    if (ListenFd < 0) return;
+
+    struct timespec deadline;
+    bool waiting = true;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += RELAY_TIMEOUT / 1000;
+
+    pthread_mutex_lock(&RelayMutex);
+    relay_broadcast("stop\n", -1);
+
+    // Wait for the results of all members, which are received by the pump
+    // thread.
+    while (waiting)
+    {
+        waiting = false;
+
+        for (size_t i = 0; i < MemberCount; ++i) waiting |= !Members[i].hasResult;
+
+        if (waiting && pthread_cond_timedwait(&RelayResultCond, &RelayMutex, &deadline)) break;
+    }
+
+    uint64_t memberNodes = 0;
+    int clusterDepth = depth;
+
+    for (size_t i = 0; i < MemberCount; ++i)
+    {
+        const RelayMember *member = &Members[i];
+
+        if (member->hasResult)
+            printf("info string relay member %zu depth %d score cp %d nodes %" PRIu64
+                   " bestmove %s\n",
+                i, member->depth, member->score, member->nodes, member->bestmove);
+        else
+            printf("info string relay member %zu sent no result\n", i);
+
+        memberNodes += member->nodes;
+
+        if (clusterDepth < member->depth) clusterDepth = member->depth;
+    }
+
+    nodes += memberNodes;
+    printf("info string relay members %zu nodes %" PRIu64 "\n", MemberCount, memberNodes);
+    printf("info string cluster depth %d nodes %" PRIu64 " nps %" PRIu64 "\n", clusterDepth, nodes,
+        nodes / (uint64_t)(elapsed + !elapsed) * 1000);
+    pthread_mutex_unlock(&RelayMutex);
+}
+
+void relay_report(const char *bestmove, score_t score, int depth, uint64_t nodes)
+{
+    if (LeaderFd < 0) return;
+
+    char message[128];
+
+    snprintf(message, sizeof(message), "result %s %d %d %" PRIu64 "\n", bestmove, (int)score, depth,
+        nodes);
+
+    pthread_mutex_lock(&RelayMutex);
+    transport_send(LeaderFd, message);
+    pthread_mutex_unlock(&RelayMutex);
+}
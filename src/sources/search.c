@@ -20,6 +20,9 @@
 #include "board.h"
 #include "evaluate.h"
 #include "movepick.h"
+#include "profile.h"
+#include "relay.h"
+#include "syzygy.h"
 #include "timeman.h"
 #include "tt.h"
 #include "types.h"
@@ -27,10 +30,71 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static int Reductions[2][256];
 int Pruning[2][16];
 
+// Depth skipping patterns for helper workers. Helpers skip the iterations for
+// which (depth + SkipPhase) / SkipSize is odd, so that they don't all search
+// the same depths at the same time.
+enum
+{
+    SKIP_PATTERNS = 20
+};
+
+static const int SkipSize[SKIP_PATTERNS] = {
+    1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static const int SkipPhase[SKIP_PATTERNS] = {
+    0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+// Table of the moves currently searched by the workers, used by ABDADA to let
+// other workers defer them. Each entry holds a key built from the position key
+// and the move.
+enum
+{
+    ABDADA_SIZE = 32768,
+    ABDADA_MIN_DEPTH = 4
+};
+
+static _Atomic hashkey_t AbdadaTable[ABDADA_SIZE];
+
+INLINED hashkey_t abdada_move_key(hashkey_t key, move_t move)
+{
+    return key ^ ((hashkey_t)move * 0x9E3779B97F4A7C15ull);
+}
+
+INLINED _Atomic hashkey_t *abdada_entry(hashkey_t moveKey)
+{
+    return &AbdadaTable[moveKey % ABDADA_SIZE];
+}
+
+INLINED bool abdada_is_searching(hashkey_t moveKey)
+{
+    return atomic_load_explicit(abdada_entry(moveKey), memory_order_relaxed) == moveKey;
+}
+
+INLINED void abdada_start(hashkey_t moveKey)
+{
+    atomic_store_explicit(abdada_entry(moveKey), moveKey, memory_order_relaxed);
+}
+
+INLINED void abdada_finish(hashkey_t moveKey)
+{
+    // Only clear the entry if no other move overwrote it in the meantime.
+    atomic_compare_exchange_strong_explicit(
+        abdada_entry(moveKey), &moveKey, 0, memory_order_relaxed, memory_order_relaxed);
+}
+
+// Stops a standalone search once it has used its node budget. The first
+// iteration is always completed, so that the worker has a move to report.
+INLINED void check_node_budget(Worker *worker)
+{
+    const uint64_t nodes = atomic_load_explicit(&worker->nodes, memory_order_relaxed);
+
+    if (worker->completedDepth && nodes >= worker->pool->params->nodes) worker->stopped = true;
+}
+
 void init_search_tables(void)
 {
     // Compute the LMR base values.
@@ -48,9 +112,10 @@ void init_search_tables(void)
     }
 }
 
-int lmr_base_value(int depth, int movecount, bool improving, bool isQuiet)
+int lmr_base_value(int depth, int movecount, bool improving, bool isQuiet, int bias)
 {
-    return (-415 + Reductions[isQuiet][depth] * Reductions[isQuiet][movecount] + !improving * 538)
+    return (-415 + Reductions[isQuiet][depth] * Reductions[isQuiet][movecount] + !improving * 538
+               + bias)
            / 1024;
 }
 
@@ -125,20 +190,22 @@ void update_pv(move_t *pv, move_t bestmove, move_t *subPv)
 
 void main_worker_search(Worker *worker)
 {
+    WorkerPool *wpool = worker->pool;
+    SearchParams *params = wpool->params;
     Board *board = &worker->board;
 
     // Special case for perft searches.
-    if (UciSearchParams.perft)
+    if (params->perft)
     {
         clock_t time = chess_clock();
-        uint64_t nodes = perft(board, (unsigned int)UciSearchParams.perft);
+        uint64_t nodes = perft(board, (unsigned int)params->perft);
 
         time = chess_clock() - time;
 
         uint64_t nps = nodes / (time + !time) * 1000;
 
-        printf("info nodes %" FMT_INFO " nps %" FMT_INFO " time %" FMT_INFO "\n", (info_t)nodes,
-            (info_t)nps, (info_t)time);
+        fprintf(wpool->output, "info nodes %" FMT_INFO " nps %" FMT_INFO " time %" FMT_INFO "\n",
+            (info_t)nodes, (info_t)nps, (info_t)time);
 
         return;
     }
@@ -147,49 +214,112 @@ void main_worker_search(Worker *worker)
     // checkmate/stalemate.
     if (worker->rootCount == 0)
     {
-        printf("info depth 0 score %s 0\n", (board->stack->checkers) ? "mate" : "cp");
-        fflush(stdout);
+        fprintf(wpool->output, "info depth 0 score %s 0\n",
+            (board->stack->checkers) ? "mate" : "cp");
+        fflush(wpool->output);
     }
     else
     {
         // The main thread initializes all the shared things for search here:
         // node counter, time manager, workers' board and threads, and TT reset.
         tt_clear();
-        wpool_new_search(&SearchWorkerPool);
-        timeman_init(board, &SearchTimeman, &UciSearchParams, chess_clock());
+        wpool_new_search(wpool);
+
+        // Filter the root moves with the tablebases, and share the result with
+        // the helper workers.
+        tb_rank_root_moves(wpool, board, worker->rootMoves, &worker->rootCount);
+
+        for (size_t i = 1; i < wpool->size; ++i)
+        {
+            Worker *helper = wpool->workerList[i];
+
+            helper->rootCount = worker->rootCount;
+            memcpy(helper->rootMoves, worker->rootMoves, sizeof(RootMove) * worker->rootCount);
+        }
 
-        if (UciSearchParams.depth == 0) UciSearchParams.depth = MAX_PLIES;
+        timeman_init(board, wpool->timeman, params, chess_clock());
 
-        if (UciSearchParams.nodes == 0) --UciSearchParams.nodes;
+        if (params->depth == 0) params->depth = MAX_PLIES;
 
-        wpool_start_workers(&SearchWorkerPool);
+        if (params->nodes == 0) --params->nodes;
+
+        wpool_start_workers(wpool);
+
+        if (wpool_is_main(wpool)) relay_start_search();
         worker_search(worker);
     }
 
     // UCI protocol specifies that we shouldn't send the bestmove command
     // before the GUI sends us the "stop" in infinite mode
     // or "ponderhit" in ponder mode.
-    while (!wpool_is_stopped(&SearchWorkerPool)
-           && (wpool_is_pondering(&SearchWorkerPool) || UciSearchParams.infinite))
+    while (!wpool_is_stopped(wpool) && (wpool_is_pondering(wpool) || params->infinite))
         ;
 
-    wpool_stop(&SearchWorkerPool);
+    wpool_stop(wpool);
 
     if (worker->rootCount == 0)
     {
-        puts("bestmove 0000");
-        fflush(stdout);
+        fputs("bestmove 0000\n", wpool->output);
+        fflush(wpool->output);
         free(worker->rootMoves);
         free_boardstack(worker->stack);
         return;
     }
 
-    // Wait for all threads to stop searching.
-    wpool_wait_search_end(&SearchWorkerPool);
+    // Wait for all threads to stop searching, and for the relay members if
+    // we're leading a relay.
+    wpool_wait_search_end(wpool);
+
+    if (wpool_is_main(wpool))
+        relay_collect_results(wpool_get_total_nodes(wpool), worker->completedDepth,
+            chess_clock() - wpool->timeman->start);
+
+    // Report the eval cache and Pawn table usage in debug mode.
+    {
+        uint64_t probes = 0, hits = 0, pawnProbes = 0, pawnHits = 0;
+
+        for (size_t i = 0; i < wpool->size; ++i)
+        {
+            probes += wpool->workerList[i]->evalCacheProbes;
+            hits += wpool->workerList[i]->evalCacheHits;
+            pawnProbes += wpool->workerList[i]->pawnProbes;
+            pawnHits += wpool->workerList[i]->pawnHits;
+        }
+
+        debug_printf("info string Eval cache hits %" FMT_INFO "/%" FMT_INFO " (%.2lf%%)\n",
+            (info_t)hits, (info_t)probes, probes ? 100.0 * hits / probes : 0.0);
+        debug_printf("info string Pawn table hits %" FMT_INFO "/%" FMT_INFO " (%.2lf%%)\n",
+            (info_t)pawnHits, (info_t)pawnProbes, pawnProbes ? 100.0 * pawnHits / pawnProbes : 0.0);
+    }
+
+#ifdef SEARCH_STATS
+    // Report the search statistics of all workers.
+    {
+        SearchStats stats;
+
+        wpool_get_search_stats(wpool, &stats);
+        search_stats_print(&stats, wpool_get_total_nodes(wpool), wpool->output);
+    }
+#endif
 
-    printf("bestmove %s", move_to_str(worker->rootMoves->move, board->chess960));
+    // Select the worker with the best results, and display its PV if it
+    // isn't the main worker.
+    Worker *bestWorker = wpool_best_worker(wpool);
 
-    move_t ponderMove = worker->rootMoves->pv[1];
+    if (bestWorker != worker)
+        print_pv(board, bestWorker->rootMoves, 1, bestWorker->completedDepth,
+            chess_clock() - wpool->timeman->start, EXACT_BOUND);
+
+    // Send our result to the relay leader if we're a relay member.
+    if (wpool_is_main(wpool))
+        relay_report(move_to_str(bestWorker->rootMoves->move, board->chess960),
+            bestWorker->rootMoves->prevScore, bestWorker->completedDepth,
+            wpool_get_total_nodes(wpool));
+
+    fprintf(
+        wpool->output, "bestmove %s", move_to_str(bestWorker->rootMoves->move, board->chess960));
+
+    move_t ponderMove = bestWorker->rootMoves->pv[1];
 
     // If we finished searching with a fail-high, try to see if we can get a ponder
     // move in TT.
@@ -199,9 +329,9 @@ void main_worker_search(Worker *worker)
         TT_Entry *entry;
         bool found;
 
-        do_move(board, worker->rootMoves->move, &stack);
+        do_move(board, bestWorker->rootMoves->move, &stack);
         entry = tt_probe(board->stack->boardKey, &found);
-        undo_move(board, worker->rootMoves->move);
+        undo_move(board, bestWorker->rootMoves->move);
 
         if (found)
         {
@@ -213,29 +343,50 @@ void main_worker_search(Worker *worker)
         }
     }
 
-    if (ponderMove != NO_MOVE) printf(" ponder %s", move_to_str(ponderMove, board->chess960));
+    if (ponderMove != NO_MOVE)
+        fprintf(wpool->output, " ponder %s", move_to_str(ponderMove, board->chess960));
 
-    putchar('\n');
-    fflush(stdout);
+    fputc('\n', wpool->output);
+    fflush(wpool->output);
 
-    free(worker->rootMoves);
-    free_boardstack(worker->stack);
+    // Release the root moves of all workers, which were kept for the best
+    // worker selection.
+    for (size_t i = 0; i < wpool->size; ++i)
+    {
+        free(wpool->workerList[i]->rootMoves);
+        free_boardstack(wpool->workerList[i]->stack);
+    }
 }
 
 void worker_search(Worker *worker)
 {
+    PROFILE_SCOPE(PROF_SEARCH);
+
+    WorkerPool *wpool = worker->pool;
+    const SearchParams *params = wpool->params;
     Board *board = &worker->board;
 
     // Clamp MultiPV to the maximal number of lines available.
-    const int multiPv = imin(UciOptionFields.multiPv, worker->rootCount);
+    const int multiPv = imin(wpool->options->multiPv, worker->rootCount);
     Searchstack sstack[256];
 
     init_searchstack(sstack);
+    worker->stopped = false;
 
-    for (int iterDepth = 0; iterDepth < UciSearchParams.depth; ++iterDepth)
+    for (int iterDepth = 0; iterDepth < params->depth; ++iterDepth)
     {
         bool hasSearchAborted;
 
+        // Skip some iterations for helper workers if asked, except the last
+        // one, since helpers keep searching at the maximal depth.
+        if (worker->idx && !worker->standalone && wpool->options->helperDepthSkip
+            && iterDepth != params->depth - 1)
+        {
+            const int i = (worker->idx - 1) % SKIP_PATTERNS;
+
+            if ((iterDepth + SkipPhase[i]) / SkipSize[i] % 2) continue;
+        }
+
         for (worker->pvLine = 0; worker->pvLine < multiPv; ++worker->pvLine)
         {
             // Reset the seldepth value after each depth increment, and for each
@@ -266,7 +417,7 @@ retry_search:
             search(true, board, depth + 1, alpha, beta, &sstack[4], false);
 
             // Catch search aborting.
-            hasSearchAborted = wpool_is_stopped(&SearchWorkerPool);
+            hasSearchAborted = worker_is_stopped(worker);
 
             sort_root_moves(
                 worker->rootMoves + worker->pvLine, worker->rootMoves + worker->rootCount);
@@ -282,16 +433,16 @@ retry_search:
             if (bound == EXACT_BOUND)
                 sort_root_moves(worker->rootMoves, worker->rootMoves + multiPv);
 
-            if (!worker->idx)
+            if (!worker->idx && !worker->standalone)
             {
-                clock_t time = chess_clock() - SearchTimeman.start;
+                clock_t time = chess_clock() - wpool->timeman->start;
 
                 // Don't update Multi-PV lines if they are not all analysed at current depth
                 // and not enough time has passed to avoid flooding the standard output.
                 if (multiPv == 1 && (bound == EXACT_BOUND || time > 3000))
                 {
                     print_pv(board, worker->rootMoves, 1, iterDepth, time, bound);
-                    fflush(stdout);
+                    fflush(wpool->output);
                 }
                 else if (multiPv > 1 && bound == EXACT_BOUND
                          && (worker->pvLine == multiPv - 1 || time > 3000))
@@ -299,7 +450,7 @@ retry_search:
                     for (int i = 0; i < multiPv; ++i)
                         print_pv(board, worker->rootMoves + i, i + 1, iterDepth, time, bound);
 
-                    fflush(stdout);
+                    fflush(wpool->output);
                 }
             }
 
@@ -323,40 +474,54 @@ retry_search:
             }
         }
 
-        // Reset root moves' score for the next search.
+        // Reset root moves' score for the next search. If the search was
+        // aborted, keep the previous scores of the moves it didn't finish, so
+        // that the best move is still reported with a meaningful score.
         for (RootMove *i = worker->rootMoves; i < worker->rootMoves + worker->rootCount; ++i)
         {
-            i->prevScore = i->score;
+            if (!hasSearchAborted || i->score != -INF_SCORE) i->prevScore = i->score;
+
             i->score = -INF_SCORE;
         }
 
         if (hasSearchAborted) break;
 
+        worker->completedDepth = iterDepth + 1;
+
         // If we went over optimal time usage, we just finished our iteration,
         // so we can safely return our bestmove.
-        if (!worker->idx)
+        if (!worker->idx && !worker->standalone)
         {
+            if (wpool_is_main(wpool))
+                relay_update_progress(worker->completedDepth, worker->rootMoves->prevScore,
+                    move_to_str(worker->rootMoves->move, board->chess960));
+
             timeman_update(
-                &SearchTimeman, board, worker->rootMoves->move, worker->rootMoves->prevScore);
-            if (timeman_can_stop_search(&SearchTimeman, chess_clock())) break;
+                wpool->timeman, board, worker->rootMoves->move, worker->rootMoves->prevScore);
+            if (timeman_can_stop_search(wpool, chess_clock())) break;
         }
 
+        // Don't start a new iteration once a standalone search has used its node
+        // budget.
+        if (worker->standalone
+            && atomic_load_explicit(&worker->nodes, memory_order_relaxed) >= params->nodes)
+            break;
+
         // If we're searching for mate and have found a mate equal or better than the given one,
         // stop the search.
-        if (UciSearchParams.mate
-            && worker->rootMoves->prevScore >= mate_in(UciSearchParams.mate * 2))
+        if (params->mate
+            && worker->rootMoves->prevScore >= mate_in(params->mate * 2))
             break;
 
         // During fixed depth or infinite searches, allow the non-main workers to keep searching
         // as long as the main worker hasn't finished.
-        if (worker->idx && iterDepth == UciSearchParams.depth - 1) --iterDepth;
+        if (worker->idx && !worker->standalone && iterDepth == params->depth - 1)
+            --iterDepth;
     }
 
-    if (worker->idx)
-    {
-        free(worker->rootMoves);
-        free_boardstack(worker->stack);
-    }
+#ifdef PROFILE
+    worker->profile.nodes += atomic_load_explicit(&worker->nodes, memory_order_relaxed);
+#endif
 }
 
 score_t search(bool pvNode, Board *board, int depth, score_t alpha, score_t beta, Searchstack *ss,
@@ -379,14 +544,18 @@ score_t search(bool pvNode, Board *board, int depth, score_t alpha, score_t beta
     move_t pv[256];
     score_t bestScore = -INF_SCORE;
 
-    // Verify the time usage if we're the main thread.
-    if (!worker->idx) check_time();
+    // Verify the time usage if we're the main thread, or the node budget if
+    // we're searching on our own.
+    if (worker->standalone)
+        check_node_budget(worker);
+    else if (!worker->idx)
+        check_time(worker->pool);
 
     // Update the seldepth value if needed.
     if (pvNode && worker->seldepth < ss->plies + 1) worker->seldepth = ss->plies + 1;
 
     // Stop the search if the game is drawn or the timeman/UCI thread asks for a stop.
-    if (!rootNode && (wpool_is_stopped(&SearchWorkerPool) || game_is_drawn(board, ss->plies)))
+    if (!rootNode && (worker_is_stopped(worker) || game_is_drawn(board, ss->plies)))
         return draw_score(worker);
 
     // Stop the search after MAX_PLIES recursive search calls.
@@ -415,6 +584,9 @@ score_t search(bool pvNode, Board *board, int depth, score_t alpha, score_t beta
     TT_Entry *entry = tt_probe(key, &found);
     score_t eval;
 
+    STAT_INC(worker, ttProbes);
+    STAT_ADD(worker, ttHits, found);
+
     if (found)
     {
         ttScore = score_from_tt(entry->score, ss->plies);
@@ -430,10 +602,66 @@ score_t search(bool pvNode, Board *board, int depth, score_t alpha, score_t beta
                 if ((ttBound & LOWER_BOUND) && !is_capture_or_promotion(board, ttMove))
                     update_quiet_history(board, depth, ttMove, NULL, 0, ss);
 
+                STAT_INC(worker, ttCutoffs);
                 return ttScore;
             }
     }
 
+    score_t maxScore = INF_SCORE;
+
+    // Probe the WDL tablebases for positions with few enough pieces, when the
+    // last move zeroed the 50-move counter.
+    if (!rootNode && !ss->excludedMove && worker->pool->tbCardinality && board->stack->rule50 == 0
+        && !board->stack->castlings)
+    {
+        const int pieces = popcount(occupancy_bb(board));
+
+        if (pieces < worker->pool->tbCardinality
+            || (pieces == worker->pool->tbCardinality && depth >= worker->pool->tbProbeDepth))
+        {
+            int result;
+            const int wdl = tb_probe_wdl(board, &result);
+
+            if (result != TB_FAIL)
+            {
+                atomic_fetch_add_explicit(&worker->tbHits, 1, memory_order_relaxed);
+
+                // Scale the score so that TB wins are just below mate scores,
+                // and favor shorter wins.
+                const int drawScore = worker->pool->tbUseRule50;
+                const score_t tbScore = (wdl < -drawScore) ? -MATE_FOUND + ss->plies + 1
+                                        : (wdl > drawScore) ? MATE_FOUND - ss->plies - 1
+                                                            : DRAW + 2 * wdl * drawScore;
+                const int tbBound = (wdl < -drawScore)  ? UPPER_BOUND
+                                    : (wdl > drawScore) ? LOWER_BOUND
+                                                        : EXACT_BOUND;
+
+                if (tbBound == EXACT_BOUND
+                    || (tbBound == LOWER_BOUND ? tbScore >= beta : tbScore <= alpha))
+                {
+                    const score_t ttEval = inCheck ? NO_SCORE
+                                           : found ? entry->eval
+                                                   : evaluate_cached(board);
+
+                    tt_save(entry, key, score_to_tt(tbScore, ss->plies), ttEval,
+                        imin(MAX_PLIES - 1, depth + 6), tbBound, NO_MOVE);
+                    return tbScore;
+                }
+
+                if (pvNode)
+                {
+                    if (tbBound == LOWER_BOUND)
+                    {
+                        bestScore = tbScore;
+                        alpha = imax(alpha, tbScore);
+                    }
+                    else
+                        maxScore = tbScore;
+                }
+            }
+        }
+    }
+
     (ss + 2)->killers[0] = (ss + 2)->killers[1] = NO_MOVE;
     ss->doubleExtensions = (ss - 1)->doubleExtensions;
 
@@ -455,7 +683,7 @@ score_t search(bool pvNode, Board *board, int depth, score_t alpha, score_t beta
     // Call the evaluation function otherwise.
     else
     {
-        eval = ss->staticEval = evaluate(board);
+        eval = ss->staticEval = evaluate_cached(board);
 
         // Save the eval in TT so that other workers won't have to recompute it.
         tt_save(entry, key, NO_SCORE, eval, 0, NO_BOUND, NO_MOVE);
@@ -493,6 +721,7 @@ score_t search(bool pvNode, Board *board, int depth, score_t alpha, score_t beta
 
         do_null_move(board, &stack);
         atomic_fetch_add_explicit(&get_worker(board)->nodes, 1, memory_order_relaxed);
+        STAT_INC(worker, nmpTries);
 
         // Perform the reduced search.
         score_t score = -search(false, board, depth - R, -beta, -beta + 1, ss + 1, !cutNode);
@@ -506,7 +735,11 @@ score_t search(bool pvNode, Board *board, int depth, score_t alpha, score_t beta
 
             // Do not trust win claims for the same reason as above, and do not
             // return early for high-depth searches.
-            if (worker->verifPlies || (depth <= 12 && abs(beta) < VICTORY)) return score;
+            if (worker->verifPlies || (depth <= 12 && abs(beta) < VICTORY))
+            {
+                STAT_INC(worker, nmpCutoffs);
+                return score;
+            }
 
             // Zugzwang checking. For high depth nodes, we perform a second
             // reduced search at the same depth, but this time with NMP disabled
@@ -517,7 +750,11 @@ score_t search(bool pvNode, Board *board, int depth, score_t alpha, score_t beta
             score_t zzscore = search(false, board, depth - R, beta - 1, beta, ss, false);
             worker->verifPlies = 0;
 
-            if (zzscore >= beta) return score;
+            if (zzscore >= beta)
+            {
+                STAT_INC(worker, nmpCutoffs);
+                return score;
+            }
         }
     }
 
@@ -562,6 +799,7 @@ score_t search(bool pvNode, Board *board, int depth, score_t alpha, score_t beta
             {
                 tt_save(entry, key, score_to_tt(probCutScore, ss->plies), ss->staticEval, depth - 3,
                     LOWER_BOUND, currmove);
+                STAT_INC(worker, probcutCutoffs);
                 return probCutScore;
             }
         }
@@ -581,8 +819,15 @@ main_loop:
     move_t captures[64];
     int ccount = 0;
     bool skipQuiets = false;
-
-    while ((currmove = movepicker_next_move(&mp, skipQuiets, 0)) != NO_MOVE)
+    move_t deferred[64];
+    int dcount = 0;
+    int dnext = 0;
+    const bool useAbdada = worker->pool->options->abdada && worker->pool->size > 1 && !rootNode
+                           && depth >= ABDADA_MIN_DEPTH;
+
+    // Once the movepicker is exhausted, search the moves deferred by ABDADA.
+    while ((dnext == 0 && (currmove = movepicker_next_move(&mp, skipQuiets, 0)) != NO_MOVE)
+           || (dnext < dcount && (currmove = deferred[dnext++]) != NO_MOVE))
     {
         if (rootNode)
         {
@@ -597,6 +842,21 @@ main_loop:
             if (!move_is_legal(board, currmove) || currmove == ss->excludedMove) continue;
         }
 
+        // Deferred moves bypass the movepicker, so skip the quiet ones here
+        // once the pruning rules want to skip quiet moves.
+        if (dnext && skipQuiets && !is_capture_or_promotion(board, currmove)) continue;
+
+        const hashkey_t moveKey = abdada_move_key(key, currmove);
+
+        // ABDADA. If another worker is currently searching this move, and we
+        // already searched at least one move, defer it to the end of the move
+        // list, so that workers search different subtrees.
+        if (useAbdada && moveCount && !dnext && dcount < 64 && abdada_is_searching(moveKey))
+        {
+            deferred[dcount++] = currmove;
+            continue;
+        }
+
         moveCount++;
 
         bool isQuiet = !is_capture_or_promotion(board, currmove);
@@ -605,7 +865,8 @@ main_loop:
         {
             // Late Move Pruning. For low-depth nodes, stop searching quiets
             // after a certain movecount has been reached.
-            if (depth <= 8 && moveCount > Pruning[improving][depth]) skipQuiets = true;
+            if (depth <= 8 && moveCount > Pruning[improving][depth] + worker->lmpBias)
+                skipQuiets = true;
 
             // Futility Pruning. For low-depth nodes, stop searching quiets if
             // the eval suggests that only captures will save the day.
@@ -626,11 +887,12 @@ main_loop:
         }
 
         // Report currmove info if enough time has passed.
-        if (rootNode && !worker->idx && chess_clock() - SearchTimeman.start > 3000)
+        if (rootNode && !worker->idx && !worker->standalone
+            && chess_clock() - worker->pool->timeman->start > 3000)
         {
-            printf("info depth %d currmove %s currmovenumber %d\n", depth,
+            fprintf(worker->pool->output, "info depth %d currmove %s currmovenumber %d\n", depth,
                 move_to_str(currmove, board->chess960), moveCount + worker->pvLine);
-            fflush(stdout);
+            fflush(worker->pool->output);
         }
 
         Boardstack stack;
@@ -661,6 +923,7 @@ main_loop:
                 score_t singularScore = search(
                     false, board, singularDepth, singularBeta - 1, singularBeta, ss, cutNode);
                 ss->excludedMove = NO_MOVE;
+                STAT_INC(worker, singularSearches);
 
                 // Our singular search failed to produce a cutoff, extend the TT
                 // move.
@@ -673,6 +936,8 @@ main_loop:
                     }
                     else
                         extension = 1;
+
+                    STAT_INC(worker, singularExtensions);
                 }
 
                 // Multicut Pruning. If our singular search produced a cutoff,
@@ -680,7 +945,10 @@ main_loop:
                 // search, assume that there are multiple moves that beat beta
                 // in the current node, and return a search score early.
                 else if (singularBeta >= beta)
+                {
+                    STAT_INC(worker, multicuts);
                     return singularBeta;
+                }
             }
             // Check Extensions. Extend non-LMR searches by one ply for moves
             // that give check.
@@ -698,6 +966,8 @@ main_loop:
         do_move_gc(board, currmove, &stack, givesCheck);
         atomic_fetch_add_explicit(&get_worker(board)->nodes, 1, memory_order_relaxed);
 
+        if (useAbdada) abdada_start(moveKey);
+
         const bool do_lmr = depth >= 3 && moveCount > 1 + 3 * pvNode;
 
         // Late Move Reductions. For nodes not too close to qsearch (since
@@ -708,7 +978,7 @@ main_loop:
         {
             // Set the base depth reduction value based on depth and
             // movecount.
-            R = lmr_base_value(depth, moveCount, improving, isQuiet);
+            R = lmr_base_value(depth, moveCount, improving, isQuiet, worker->lmrBias);
 
             // Increase the reduction for non-PV nodes.
             R += !pvNode;
@@ -732,7 +1002,11 @@ main_loop:
         else
             R = 0;
 
-        if (do_lmr) score = -search(false, board, newDepth - R, -alpha - 1, -alpha, ss + 1, true);
+        if (do_lmr)
+        {
+            score = -search(false, board, newDepth - R, -alpha - 1, -alpha, ss + 1, true);
+            STAT_INC(worker, lmrSearches);
+        }
 
         newDepth += extension;
 
@@ -743,7 +1017,11 @@ main_loop:
             score = -search(false, board, newDepth, -alpha - 1, -alpha, ss + 1, !cutNode);
 
             // Update continuation histories for post-LMR searches.
-            if (R) update_cont_histories(ss, depth, movedPiece, to_sq(currmove), score > alpha);
+            if (R)
+            {
+                update_cont_histories(ss, depth, movedPiece, to_sq(currmove), score > alpha);
+                STAT_INC(worker, lmrResearches);
+            }
         }
 
         // In PV nodes, perform an additional full-window search for the first
@@ -757,8 +1035,10 @@ main_loop:
 
         undo_move(board, currmove);
 
+        if (useAbdada) abdada_finish(moveKey);
+
         // Check for search abortion here.
-        if (wpool_is_stopped(&SearchWorkerPool)) return 0;
+        if (worker_is_stopped(worker)) return 0;
 
         if (rootNode)
         {
@@ -801,6 +1081,9 @@ main_loop:
                     if (isQuiet) update_quiet_history(board, depth, bestmove, quiets, qcount, ss);
                     if (moveCount != 1)
                         update_capture_history(board, depth, bestmove, captures, ccount, ss);
+
+                    STAT_INC(worker, betaCutoffs);
+                    STAT_ADD(worker, firstMoveCutoffs, moveCount == 1);
                     break;
                 }
             }
@@ -813,11 +1096,17 @@ main_loop:
             captures[ccount++] = currmove;
     }
 
+    STAT_ADD(worker, expandedNodes, moveCount != 0);
+    STAT_ADD(worker, searchedMoves, moveCount);
+
     // Are we in checkmate/stalemate ? Take care of not returning a wrong draw
     // or mate score in singular searches.
     if (moveCount == 0)
         bestScore = (ss->excludedMove) ? alpha : (board->stack->checkers) ? mated_in(ss->plies) : 0;
 
+    // Don't return a score better than the tablebase one in PV nodes.
+    if (pvNode) bestScore = imin(bestScore, maxScore);
+
     // Only save TT for the first MultiPV move in root nodes.
     if (!rootNode || worker->pvLine == 0)
     {
@@ -827,6 +1116,11 @@ main_loop:
 
         tt_save(
             entry, key, score_to_tt(bestScore, ss->plies), ss->staticEval, depth, bound, bestmove);
+
+        // Share high-depth entries with the other relay nodes.
+        if (RelayShareDepth && depth >= RelayShareDepth)
+            relay_share_entry(key, score_to_tt(bestScore, ss->plies), ss->staticEval, depth, bound,
+                bestmove);
     }
 
     return bestScore;
@@ -839,14 +1133,18 @@ score_t qsearch(bool pvNode, Board *board, score_t alpha, score_t beta, Searchst
     Movepicker mp;
     move_t pv[256];
 
-    // Verify the time usage if we're the main thread.
-    if (!worker->idx) check_time();
+    // Verify the time usage if we're the main thread, or the node budget if
+    // we're searching on our own.
+    if (worker->standalone)
+        check_node_budget(worker);
+    else if (!worker->idx)
+        check_time(worker->pool);
 
     // Update the seldepth value if needed.
     if (pvNode && worker->seldepth < ss->plies + 1) worker->seldepth = ss->plies + 1;
 
     // Stop the search if the game is drawn or the timeman/UCI thread asks for a stop.
-    if (wpool_is_stopped(&SearchWorkerPool) || game_is_drawn(board, ss->plies))
+    if (worker_is_stopped(worker) || game_is_drawn(board, ss->plies))
         return draw_score(worker);
 
     // Stop the search after MAX_PLIES recursive search calls.
@@ -865,6 +1163,9 @@ score_t qsearch(bool pvNode, Board *board, score_t alpha, score_t beta, Searchst
     bool found;
     TT_Entry *entry = tt_probe(board->stack->boardKey, &found);
 
+    STAT_INC(worker, ttProbes);
+    STAT_ADD(worker, ttHits, found);
+
     if (found)
     {
         ttBound = entry->genbound & 3;
@@ -874,7 +1175,10 @@ score_t qsearch(bool pvNode, Board *board, score_t alpha, score_t beta, Searchst
         if (!pvNode
             && (((ttBound & LOWER_BOUND) && ttScore >= beta)
                 || ((ttBound & UPPER_BOUND) && ttScore <= alpha)))
+        {
+            STAT_INC(worker, ttCutoffs);
             return ttScore;
+        }
     }
 
     bool inCheck = !!board->stack->checkers;
@@ -899,7 +1203,7 @@ score_t qsearch(bool pvNode, Board *board, score_t alpha, score_t beta, Searchst
         }
         // Call the evaluation function otherwise.
         else
-            eval = bestScore = evaluate(board);
+            eval = bestScore = evaluate_cached(board);
 
         // Stand Pat. If not playing a capture is better because of better quiet
         // moves, allow for a simple eval return.
@@ -965,12 +1269,13 @@ score_t qsearch(bool pvNode, Board *board, score_t alpha, score_t beta, Searchst
 
         do_move_gc(board, currmove, &stack, givesCheck);
         atomic_fetch_add_explicit(&get_worker(board)->nodes, 1, memory_order_relaxed);
+        STAT_INC(worker, qsearchNodes);
 
         score_t score = -qsearch(pvNode, board, -beta, -alpha, ss + 1);
         undo_move(board, currmove);
 
         // Check for search abortion here.
-        if (wpool_is_stopped(&SearchWorkerPool)) return 0;
+        if (worker_is_stopped(worker)) return 0;
 
         // Check if our score improves the current best score.
         if (bestScore < score)
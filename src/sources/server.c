@@ -0,0 +1,712 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "server.h"
+#include "timeman.h"
+#include "transport.h"
+#include "uci.h"
+#include "worker.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+enum
+{
+    SERVER_MAX_CONNECTIONS = 63,  // One poll slot is kept for the listening socket
+    SERVER_MAX_SESSIONS = 256,
+    SERVER_POLL_INTERVAL = 100,   // Delay between two checks of the server status
+    SERVER_TIMEOUT = 1000         // Maximal wait for the end of a line, in milliseconds
+};
+
+// Struct for the per-session values of the UCI options.
+typedef struct _SessionOptions
+{
+    long threads;
+    long multiPv;
+    bool chess960;
+    bool showWDL;
+    bool normalizeScore;
+} SessionOptions;
+
+// Struct for a client session. While searching, a session owns a slice of the
+// worker pool, along with its own search state.
+typedef struct _Session
+{
+    char id[32];
+    int fd;
+    char *position;
+    char *goArgs;
+    SessionOptions options;
+    clock_t queuedAt;
+    bool queued;
+    bool searching;
+    bool closing;
+    Board board;
+    SearchParams params;
+    Timeman timeman;
+    Movelist searchMoves;
+    OptionFields fields;
+    WorkerPool pool;
+    Worker *workers[MAX_THREADS];
+    int outputFd;
+    pthread_t forwarder;
+} Session;
+
+#ifndef _WIN32
+
+static int ListenFd = -1;
+static int Connections[SERVER_MAX_CONNECTIONS];
+static size_t ConnectionCount;
+static char ListenAddress[256];
+
+static Session *Sessions[SERVER_MAX_SESSIONS];
+static Session *RunQueue[SERVER_MAX_SESSIONS];
+static size_t QueueCount;
+static SessionOptions DefaultOptions;
+
+// Workers of the main pool currently lent to a session.
+static bool Busy[MAX_THREADS];
+static size_t BusyCount;
+static size_t SearchCount;
+static int PendingCommands;
+
+static atomic_bool Running;
+static pthread_t IoThread;
+static pthread_t ScheduleThread;
+static pthread_mutex_t ServerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t QueueCond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t IdleCond = PTHREAD_COND_INITIALIZER;
+
+// Sends a line to the client of the given session, which must be called with
+// the server mutex held.
+static void server_reply(const Session *session, const char *line)
+{
+    char message[16384 + 64];
+
+    if (session->fd < 0) return;
+
+    snprintf(message, sizeof(message), "%s %s\n", session->id, line);
+    transport_send(session->fd, message);
+}
+
+static void server_free_session(Session *session)
+{
+    for (size_t i = 0; i < SERVER_MAX_SESSIONS; ++i)
+        if (Sessions[i] == session) Sessions[i] = NULL;
+
+    free_boardstack(session->board.stack);
+    free(session->position);
+    free(session->goArgs);
+    free(session);
+}
+
+// Removes the given session from the run queue, which must be called with the
+// server mutex held.
+static void server_dequeue(Session *session)
+{
+    for (size_t i = 0; i < QueueCount; ++i)
+        if (RunQueue[i] == session)
+        {
+            memmove(RunQueue + i, RunQueue + i + 1, sizeof(Session *) * (QueueCount - i - 1));
+            --QueueCount;
+            break;
+        }
+
+    session->queued = false;
+}
+
+// Closes the given session, which must be called with the server mutex held.
+// A searching session is only released by its search runner once its search
+// ends.
+static void server_close_session(Session *session)
+{
+    server_dequeue(session);
+
+    if (session->searching)
+    {
+        session->fd = -1;
+        session->closing = true;
+        wpool_stop(&session->pool);
+        return;
+    }
+
+    server_free_session(session);
+}
+
+// Returns the session with the given identifier on the given connection,
+// creating it if needed. Returns NULL if all session slots are in use.
+static Session *server_get_session(int fd, const char *id)
+{
+    Session **freeSlot = NULL;
+
+    for (size_t i = 0; i < SERVER_MAX_SESSIONS; ++i)
+    {
+        if (Sessions[i] == NULL)
+        {
+            if (freeSlot == NULL) freeSlot = &Sessions[i];
+        }
+        else if (Sessions[i]->fd == fd && !strcmp(Sessions[i]->id, id))
+            return Sessions[i];
+    }
+
+    if (freeSlot == NULL) return NULL;
+
+    Session *session = calloc(1, sizeof(Session));
+
+    if (session == NULL)
+    {
+        perror("Unable to allocate session");
+        exit(EXIT_FAILURE);
+    }
+
+    snprintf(session->id, sizeof(session->id), "%s", id);
+    session->fd = fd;
+    session->options = DefaultOptions;
+    session->pool.workerList = session->workers;
+    session->pool.params = &session->params;
+    session->pool.timeman = &session->timeman;
+    session->pool.searchMoves = &session->searchMoves;
+    session->pool.options = &session->fields;
+    *freeSlot = session;
+    return session;
+}
+
+// Replaces the given string with a copy of the given value.
+static void server_set_string(char **str, const char *value)
+{
+    free(*str);
+    *str = strdup(value);
+
+    if (*str == NULL)
+    {
+        perror("Unable to allocate session");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void server_uci(Session *session)
+{
+    char line[128];
+
+    server_reply(session, "id name Stash " UCI_VERSION);
+    server_reply(session, "id author Morgan Houppin");
+    snprintf(line, sizeof(line), "option name Threads type spin default %ld min 1 max %zu",
+        session->options.threads, SearchWorkerPool.size);
+    server_reply(session, line);
+    snprintf(line, sizeof(line), "option name MultiPV type spin default %ld min 1 max 500",
+        session->options.multiPv);
+    server_reply(session, line);
+    snprintf(line, sizeof(line), "option name UCI_Chess960 type check default %s",
+        session->options.chess960 ? "true" : "false");
+    server_reply(session, line);
+    snprintf(line, sizeof(line), "option name UCI_ShowWDL type check default %s",
+        session->options.showWDL ? "true" : "false");
+    server_reply(session, line);
+    snprintf(line, sizeof(line), "option name NormalizeScore type check default %s",
+        session->options.normalizeScore ? "true" : "false");
+    server_reply(session, line);
+    server_reply(session, "uciok");
+}
+
+// Sets a per-session option. All other options are shared by the sessions,
+// and can only be set on the server's standard input.
+static void server_setoption(Session *session, char *args)
+{
+    char *nameToken = get_next_token(&args);
+    char *name = get_next_token(&args);
+    char *valueToken = get_next_token(&args);
+    char *value = get_next_token(&args);
+    char line[128];
+
+    if (nameToken == NULL || name == NULL || valueToken == NULL || value == NULL
+        || strcmp(nameToken, "name") || strcmp(valueToken, "value"))
+        server_reply(session, "info string Usage: setoption name <name> value <value>");
+    else if (!strcasecmp(name, "Threads"))
+        session->options.threads = imax(1, imin(MAX_THREADS, (int)strtol(value, NULL, 10)));
+    else if (!strcasecmp(name, "MultiPV"))
+        session->options.multiPv = strtol(value, NULL, 10) < 1 ? 1 : strtol(value, NULL, 10);
+    else if (!strcasecmp(name, "UCI_Chess960"))
+        session->options.chess960 = !strcasecmp(value, "true");
+    else if (!strcasecmp(name, "UCI_ShowWDL"))
+        session->options.showWDL = !strcasecmp(value, "true");
+    else if (!strcasecmp(name, "NormalizeScore"))
+        session->options.normalizeScore = !strcasecmp(value, "true");
+    else
+    {
+        snprintf(line, sizeof(line), "info string Option '%s' is shared by all sessions", name);
+        server_reply(session, line);
+    }
+}
+
+// Rewrites the search arguments of a queued session, removing the given token
+// if not NULL, and charging the given time to the clock of the side to move.
+static void server_rewrite_go(Session *session, const char *removed, clock_t elapsed)
+{
+    const char *clock = (session->board.sideToMove == WHITE) ? "wtime" : "btime";
+    char *ptr = session->goArgs;
+    char *token;
+    char args[16384] = {0};
+    char value[32];
+    bool charged = false;
+
+    while ((token = get_next_token(&ptr)) != NULL)
+    {
+        if (removed != NULL && !strcmp(token, removed)) continue;
+
+        if (charged)
+        {
+            const long long remaining = strtoll(token, NULL, 10) - (long long)elapsed;
+
+            snprintf(value, sizeof(value), "%lld", remaining > 1 ? remaining : 1);
+            token = value;
+        }
+
+        charged = elapsed > 0 && !strcmp(token, clock);
+
+        if (strlen(args) + strlen(token) + 2 < sizeof(args))
+        {
+            strcat(args, " ");
+            strcat(args, token);
+        }
+    }
+
+    server_set_string(&session->goArgs, args);
+}
+
+// Handles a line received from a client, which must be called with the server
+// mutex held.
+static void server_handle_line(int fd, char *line)
+{
+    char *ptr = line;
+    char *id = get_next_token(&ptr);
+
+    if (id == NULL) return;
+
+    Session *session = server_get_session(fd, id);
+
+    if (session == NULL)
+    {
+        transport_send(fd, "info string Too many sessions\n");
+        return;
+    }
+
+    char *args = ptr;
+    char *command = get_next_token(&args);
+
+    if (command == NULL) return;
+
+    if (!strcmp(command, "uci"))
+        server_uci(session);
+    else if (!strcmp(command, "isready"))
+        server_reply(session, "readyok");
+    else if (!strcmp(command, "setoption"))
+        server_setoption(session, args);
+    else if (!strcmp(command, "position"))
+        server_set_string(&session->position, args);
+    else if (!strcmp(command, "go"))
+    {
+        // A search requested while the previous one is still ending waits for
+        // it in the queue.
+        if (session->queued)
+            server_reply(session, "info string Search already queued");
+        else
+        {
+            server_set_string(&session->goArgs, args);
+            session->queuedAt = chess_clock();
+            session->queued = true;
+            RunQueue[QueueCount++] = session;
+            pthread_cond_signal(&QueueCond);
+        }
+    }
+    else if (!strcmp(command, "stop"))
+    {
+        // Queued searches still run, but only briefly, so that the client
+        // receives a bestmove.
+        if (session->queued)
+            server_set_string(&session->goArgs, "depth 1");
+        else if (session->searching)
+            wpool_stop(&session->pool);
+    }
+    else if (!strcmp(command, "ponderhit"))
+    {
+        if (session->queued)
+        {
+            // The session's clock only starts running once pondering ends.
+            server_rewrite_go(session, "ponder", 0);
+            session->queuedAt = chess_clock();
+        }
+        else if (session->searching)
+            wpool_ponderhit(&session->pool);
+    }
+    else if (!strcmp(command, "quit"))
+        server_close_session(session);
+    else if (strcmp(command, "ucinewgame"))
+        server_reply(session, "info string Unsupported command in server mode");
+}
+
+static void server_drop_connection(size_t idx)
+{
+    int fd = Connections[idx];
+
+    pthread_mutex_lock(&ServerMutex);
+
+    for (size_t i = 0; i < SERVER_MAX_SESSIONS; ++i)
+        if (Sessions[i] != NULL && Sessions[i]->fd == fd) server_close_session(Sessions[i]);
+
+    pthread_mutex_unlock(&ServerMutex);
+    transport_close(fd);
+    Connections[idx] = Connections[--ConnectionCount];
+}
+
+// Accepts new clients and reads their commands.
+static void *server_io_loop(void *data)
+{
+    (void)data;
+
+    int fds[SERVER_MAX_CONNECTIONS + 1] = {0};
+    bool ready[SERVER_MAX_CONNECTIONS + 1] = {0};
+    char line[16384];
+
+    while (atomic_load_explicit(&Running, memory_order_relaxed))
+    {
+        fds[0] = ListenFd;
+        memcpy(fds + 1, Connections, sizeof(int) * ConnectionCount);
+
+        size_t count = ConnectionCount + 1;
+
+        if (transport_poll(fds, ready, count, SERVER_POLL_INTERVAL) == 0) continue;
+
+        // Handle the connections in reverse order, since dropping one moves
+        // the last connection in its slot.
+        for (size_t i = count - 1; i > 0; --i)
+        {
+            if (!ready[i]) continue;
+
+            if (!transport_read_line(fds[i], line, sizeof(line), SERVER_TIMEOUT))
+            {
+                server_drop_connection(i - 1);
+                continue;
+            }
+
+            // Remove the carriage return sent by some clients.
+            line[strcspn(line, "\r")] = '\0';
+
+            pthread_mutex_lock(&ServerMutex);
+            server_handle_line(fds[i], line);
+            pthread_mutex_unlock(&ServerMutex);
+        }
+
+        if (ready[0])
+        {
+            int fd = transport_accept(ListenFd);
+
+            if (fd < 0) continue;
+
+            if (ConnectionCount < SERVER_MAX_CONNECTIONS)
+                Connections[ConnectionCount++] = fd;
+            else
+                transport_close(fd);
+        }
+    }
+
+    return NULL;
+}
+
+static void server_start_thread(pthread_t *thread, void *(*routine)(void *), void *data)
+{
+    if (pthread_create(thread, NULL, routine, data))
+    {
+        perror("Unable to start server");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Sends the search output of a session to its client.
+static void *server_forward_loop(void *data)
+{
+    Session *session = data;
+    char line[16384];
+
+    while (transport_read_line(session->outputFd, line, sizeof(line), -1))
+    {
+        pthread_mutex_lock(&ServerMutex);
+        server_reply(session, line);
+        pthread_mutex_unlock(&ServerMutex);
+    }
+
+    return NULL;
+}
+
+// Waits for the end of a session's search, and gives its workers back.
+static void *server_run_loop(void *data)
+{
+    Session *session = data;
+
+    worker_wait_search_end(wpool_main_worker(&session->pool));
+
+    // Closing the write end of the output ends the forwarder's loop once all
+    // the output of the search has been sent.
+    fclose(session->pool.output);
+    pthread_join(session->forwarder, NULL);
+    transport_close(session->outputFd);
+
+    pthread_mutex_lock(&ServerMutex);
+
+    for (size_t i = 0; i < SearchWorkerPool.size; ++i)
+        for (size_t k = 0; k < session->pool.size; ++k)
+            if (SearchWorkerPool.workerList[i] == session->workers[k])
+            {
+                session->workers[k]->idx = i;
+                session->workers[k]->pool = &SearchWorkerPool;
+                Busy[i] = false;
+                --BusyCount;
+            }
+
+    session->pool.size = 0;
+    session->searching = false;
+    --SearchCount;
+
+    if (session->closing) server_free_session(session);
+
+    pthread_cond_signal(&QueueCond);
+    pthread_cond_broadcast(&IdleCond);
+    pthread_mutex_unlock(&ServerMutex);
+    return NULL;
+}
+
+// Pops the first queued session which isn't searching anymore, which must be
+// called with the server mutex held. Returns NULL if there is none.
+static Session *server_next_session(void)
+{
+    for (size_t i = 0; i < QueueCount; ++i)
+        if (!RunQueue[i]->searching)
+        {
+            Session *session = RunQueue[i];
+
+            server_dequeue(session);
+            return session;
+        }
+
+    return NULL;
+}
+
+// Starts the search of the given session on a slice of the free workers, which
+// must be called with the server mutex held, so that stop commands can't be
+// lost.
+static void server_start_search(Session *session)
+{
+    const size_t threads = (size_t)session->options.threads;
+    int output[2];
+    pthread_t runner;
+
+    // Lend the free workers to the session, renumbering them so that the first
+    // one leads the slice's search.
+    for (size_t i = 0; i < SearchWorkerPool.size && session->pool.size < threads; ++i)
+        if (!Busy[i])
+        {
+            Worker *worker = SearchWorkerPool.workerList[i];
+
+            Busy[i] = true;
+            ++BusyCount;
+            worker->idx = session->pool.size;
+            session->workers[session->pool.size++] = worker;
+        }
+
+    // Shared options are read when the search starts, since they can't change
+    // while a search is running.
+    session->fields = UciOptionFields;
+    session->fields.threads = (long)session->pool.size;
+    session->fields.multiPv = session->options.multiPv;
+    session->fields.chess960 = session->options.chess960;
+    session->fields.showWDL = session->options.showWDL;
+    session->fields.normalizeScore = session->options.normalizeScore;
+    uci_parse_position(&session->board, session->position ? session->position : "startpos",
+        session->options.chess960);
+
+    // Charge the time spent in the queue to the session's clock.
+    if (strstr(session->goArgs, "ponder") == NULL)
+        server_rewrite_go(session, NULL, chess_clock() - session->queuedAt);
+
+    uci_parse_go(&session->board, session->goArgs, &session->params, &session->searchMoves);
+
+    // Route the search output to a forwarder thread, which sends it to the
+    // session's client.
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, output)
+        || (session->pool.output = fdopen(output[1], "w")) == NULL)
+    {
+        perror("Unable to create session output");
+        exit(EXIT_FAILURE);
+    }
+
+    session->outputFd = output[0];
+    session->searching = true;
+    ++SearchCount;
+    wpool_start_search(&session->pool, &session->board, &session->params);
+    server_start_thread(&session->forwarder, &server_forward_loop, session);
+    server_start_thread(&runner, &server_run_loop, session);
+    pthread_detach(runner);
+}
+
+// Starts the searches of the queued sessions as long as some workers are free.
+static void *server_schedule_loop(void *data)
+{
+    (void)data;
+
+    pthread_mutex_lock(&ServerMutex);
+
+    while (true)
+    {
+        Session *session = NULL;
+
+        // Let the commands received outside of the server run once all
+        // searches are done.
+        while (atomic_load_explicit(&Running, memory_order_relaxed)
+               && (PendingCommands > 0 || BusyCount == SearchWorkerPool.size
+                   || (session = server_next_session()) == NULL))
+            pthread_cond_wait(&QueueCond, &ServerMutex);
+
+        if (!atomic_load_explicit(&Running, memory_order_relaxed)) break;
+
+        server_start_search(session);
+    }
+
+    pthread_mutex_unlock(&ServerMutex);
+    return NULL;
+}
+
+bool server_start(const char *address)
+{
+    if (ListenFd >= 0)
+    {
+        puts("info string Server already active");
+        return false;
+    }
+
+    if (strlen(address) >= sizeof(ListenAddress))
+    {
+        printf("info string Server address '%s' is too long\n", address);
+        return false;
+    }
+
+    ListenFd = transport_listen(address);
+
+    if (ListenFd < 0)
+    {
+        perror("Unable to open server socket");
+        return false;
+    }
+
+    strcpy(ListenAddress, address);
+
+    // New sessions start with the option values of the server, except for the
+    // thread count, since sessions share the workers.
+    DefaultOptions = (SessionOptions){1, UciOptionFields.multiPv, UciOptionFields.chess960,
+        UciOptionFields.showWDL, UciOptionFields.normalizeScore};
+    printf("info string Server listening on '%s'\n", address);
+    fflush(stdout);
+
+    atomic_store_explicit(&Running, true, memory_order_relaxed);
+    server_start_thread(&ScheduleThread, &server_schedule_loop, NULL);
+    server_start_thread(&IoThread, &server_io_loop, NULL);
+    return true;
+}
+
+void server_close(void)
+{
+    if (ListenFd < 0) return;
+
+    pthread_mutex_lock(&ServerMutex);
+    atomic_store_explicit(&Running, false, memory_order_relaxed);
+    pthread_cond_signal(&QueueCond);
+
+    for (size_t i = 0; i < SERVER_MAX_SESSIONS; ++i)
+        if (Sessions[i] != NULL && Sessions[i]->searching) wpool_stop(&Sessions[i]->pool);
+
+    while (SearchCount > 0) pthread_cond_wait(&IdleCond, &ServerMutex);
+
+    pthread_mutex_unlock(&ServerMutex);
+    pthread_join(IoThread, NULL);
+    pthread_join(ScheduleThread, NULL);
+
+    while (ConnectionCount) server_drop_connection(ConnectionCount - 1);
+
+    transport_close(ListenFd);
+    transport_cleanup(ListenAddress);
+    ListenFd = -1;
+}
+
+bool server_run_command(const char *name, void (*call)(const char *), const char *args)
+{
+    // Search commands would need the workers lent to the sessions.
+    static const char *Refused[] = {"analyse", "bench", "datagen", "go", "ponderhit", "position",
+        "server", "stop", "ucinewgame", NULL};
+    static const char *Unguarded[] = {"debug", "isready", "quit", "uci", NULL};
+
+    if (ListenFd < 0) return false;
+
+    for (size_t i = 0; Refused[i] != NULL; ++i)
+        if (!strcmp(name, Refused[i]))
+        {
+            printf("info string Command '%s' is unavailable while the server is active\n", name);
+            fflush(stdout);
+            return true;
+        }
+
+    for (size_t i = 0; Unguarded[i] != NULL; ++i)
+        if (!strcmp(name, Unguarded[i])) return false;
+
+    // Other commands change the shared state, so run them once all searches
+    // are done.
+    pthread_mutex_lock(&ServerMutex);
+    ++PendingCommands;
+
+    while (SearchCount > 0) pthread_cond_wait(&IdleCond, &ServerMutex);
+
+    call(args);
+    --PendingCommands;
+    pthread_cond_signal(&QueueCond);
+    pthread_mutex_unlock(&ServerMutex);
+    return true;
+}
+
+#else
+
+bool server_start(const char *address)
+{
+    (void)address;
+    puts("info string Server mode is not supported on this platform");
+    return false;
+}
+
+void server_close(void) {}
+
+bool server_run_command(const char *name, void (*call)(const char *), const char *args)
+{
+    (void)name;
+    (void)call;
+    (void)args;
+    return false;
+}
+
+#endif
@@ -0,0 +1,1695 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// The decoding logic below follows the reference Syzygy probing code by
+// Ronald de Man, as adapted in Stockfish's tbprobe.cpp.
+
+#include "syzygy.h"
+#include "bitbase.h"
+#include "movelist.h"
+#include "psq_score.h"
+#include "random.h"
+#include "uci.h"
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TB_PATH_SEPARATOR ':'
+#else
+#define TB_PATH_SEPARATOR ';'
+#endif
+
+enum
+{
+    // Flags of the compressed tables
+    TB_FLAG_STM = 1,
+    TB_FLAG_MAPPED = 2,
+    TB_FLAG_WIN_PLIES = 4,
+    TB_FLAG_LOSS_PLIES = 8,
+    TB_FLAG_WIDE = 16,
+    TB_FLAG_SINGLE_VALUE = 128,
+
+    // Flags of the file headers
+    TB_HEADER_SPLIT = 1,
+    TB_HEADER_HAS_PAWNS = 2,
+
+    WDL_TABLE = 0,
+    DTZ_TABLE = 1,
+
+    TB_HASH_SIZE = 1 << 14
+};
+
+// Struct for the low-level indexing information of a compressed table. A WDL
+// file has one table per side to move (unless both sides have the same
+// material), and files with pawns have one table per leading pawn file.
+typedef struct _PairsData
+{
+    uint8_t flags;
+    uint8_t maxSymLen;
+    uint8_t minSymLen;
+    uint32_t numBlocks;
+    size_t blockSize;
+    size_t span;
+    const uint8_t *lowestSym;   // Lowest symbol of each length (16-bit LE)
+    const uint8_t *btree;       // Left and right children of each symbol (2x12 bits)
+    const uint8_t *blockLength; // Number of values minus one in each block (16-bit LE)
+    uint32_t blockLengthSize;
+    const uint8_t *sparseIndex; // Block and offset of every span-th value (6 bytes)
+    size_t sparseIndexSize;
+    const uint8_t *data;
+    uint64_t *base64; // Lowest symbol of each length, left-aligned to 64 bits
+    uint8_t *symlen;  // Number of values minus one represented by each symbol
+    size_t symCount;
+    piece_t pieces[TB_MAX_PIECES];
+    uint64_t groupIdx[TB_MAX_PIECES + 1];
+    int groupLen[TB_MAX_PIECES + 1];
+    uint16_t mapIdx[4];
+} PairsData;
+
+// Struct for a WDL or DTZ table file. The indexing information is filled when
+// the file gets mapped on first access.
+typedef struct _TbTable
+{
+    atomic_bool ready;
+    int type;
+    char name[16];
+    void *mapping;
+    size_t mappingSize;
+    const uint8_t *map;
+    hashkey_t key;
+    hashkey_t key2;
+    int pieceCount;
+    bool hasPawns;
+    bool hasUniquePieces;
+    uint8_t pawnCount[COLOR_NB]; // Leading color, other color
+    PairsData items[COLOR_NB][4];
+} TbTable;
+
+typedef struct _TbEntry
+{
+    TbTable tables[2];
+} TbEntry;
+
+typedef struct _TbHashSlot
+{
+    hashkey_t key;
+    int index; // Index of the entry plus one, zero for an empty slot
+} TbHashSlot;
+
+int TbMaxCardinality;
+
+static TbEntry *TbEntries;
+static int TbEntryCount;
+static int TbEntryCapacity;
+static TbHashSlot TbHash[TB_HASH_SIZE];
+static char *TbPaths;
+static pthread_mutex_t TbMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static int MapPawns[SQUARE_NB];
+static int MapB1H1H7[SQUARE_NB];
+static int MapA1D1D4[SQUARE_NB];
+static int MapKK[10][SQUARE_NB];
+static uint64_t Binomial[6][SQUARE_NB];
+static uint64_t LeadPawnIdx[6][SQUARE_NB];
+static uint64_t LeadPawnsSize[6][4];
+
+static const char PieceLetters[] = " PNBRQK";
+
+INLINED uint16_t read_le16(const uint8_t *ptr) { return (uint16_t)(ptr[0] | (ptr[1] << 8)); }
+
+INLINED uint32_t read_le32(const uint8_t *ptr)
+{
+    return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+INLINED uint32_t read_be32(const uint8_t *ptr)
+{
+    uint32_t value;
+
+    memcpy(&value, ptr, sizeof(value));
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+
+    return value;
+}
+
+INLINED uint64_t read_be64(const uint8_t *ptr)
+{
+    uint64_t value;
+
+    memcpy(&value, ptr, sizeof(value));
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+
+    return value;
+}
+
+INLINED int btree_left(const PairsData *d, int sym)
+{
+    const uint8_t *lr = d->btree + 3 * sym;
+
+    return ((lr[1] & 0xF) << 8) | lr[0];
+}
+
+INLINED int btree_right(const PairsData *d, int sym)
+{
+    const uint8_t *lr = d->btree + 3 * sym;
+
+    return (lr[2] << 4) | (lr[1] >> 4);
+}
+
+INLINED int block_length(const PairsData *d, uint32_t block)
+{
+    return read_le16(d->blockLength + 2 * block);
+}
+
+// Returns the signed distance of the square to the A1-H8 diagonal.
+INLINED int off_a1h8(square_t square) { return (int)sq_rank(square) - (int)sq_file(square); }
+
+INLINED int edge_distance(file_t file) { return imin(file, FILE_H - file); }
+
+INLINED int sign_of(int value) { return (value > 0) - (value < 0); }
+
+INLINED PairsData *table_item(TbTable *table, int stm, int file)
+{
+    return &table->items[table->type == WDL_TABLE ? stm : 0][table->hasPawns ? file : 0];
+}
+
+// DTZ tables don't store valid scores for zeroing moves, but we can recover
+// the DTZ of the previous move from the WDL score of the position.
+INLINED int dtz_before_zeroing(int wdl)
+{
+    return wdl == TB_WIN            ? 1
+           : wdl == TB_CURSED_WIN   ? 101
+           : wdl == TB_BLESSED_LOSS ? -101
+           : wdl == TB_LOSS         ? -1
+                                    : 0;
+}
+
+INLINED bool tb_is_capture(const Board *board, move_t move)
+{
+    return move_type(move) == EN_PASSANT
+           || (move_type(move) != CASTLING && !empty_square(board, to_sq(move)));
+}
+
+static void tb_init_tables(void)
+{
+    int code = 0;
+
+    // MapB1H1H7[] encodes the squares below the A1-H8 diagonal to 0..27.
+    for (square_t s = SQ_A1; s <= SQ_H8; ++s)
+        if (off_a1h8(s) < 0) MapB1H1H7[s] = code++;
+
+    // MapA1D1D4[] encodes the squares of the A1-D1-D4 triangle to 0..9, with
+    // the diagonal squares encoded last.
+    static const square_t Triangle[] = {SQ_A1, SQ_B1, SQ_C1, SQ_D1, SQ_A2, SQ_B2, SQ_C2, SQ_D2,
+        SQ_A3, SQ_B3, SQ_C3, SQ_D3, SQ_A4, SQ_B4, SQ_C4, SQ_D4};
+    square_t diagonal[4];
+    int diagonalCount = 0;
+
+    code = 0;
+
+    for (int i = 0; i < 16; ++i)
+    {
+        if (off_a1h8(Triangle[i]) < 0)
+            MapA1D1D4[Triangle[i]] = code++;
+        else if (off_a1h8(Triangle[i]) == 0)
+            diagonal[diagonalCount++] = Triangle[i];
+    }
+
+    for (int i = 0; i < diagonalCount; ++i) MapA1D1D4[diagonal[i]] = code++;
+
+    // MapKK[] encodes the 462 legal placements of two Kings where the first one
+    // is in the A1-D1-D4 triangle, and the second one isn't above the A1-H8
+    // diagonal when the first one is on it. Placements with both Kings on the
+    // diagonal are encoded last.
+    int bothOnDiagonal[64][2];
+    int bothCount = 0;
+
+    code = 0;
+
+    for (int idx = 0; idx < 10; ++idx)
+        for (square_t s1 = SQ_A1; s1 <= SQ_D4; ++s1)
+        {
+            if (MapA1D1D4[s1] != idx || (idx == 0 && s1 != SQ_B1)) continue;
+
+            for (square_t s2 = SQ_A1; s2 <= SQ_H8; ++s2)
+            {
+                if ((king_moves(s1) | square_bb(s1)) & square_bb(s2)) continue;
+
+                if (!off_a1h8(s1) && off_a1h8(s2) > 0) continue;
+
+                if (!off_a1h8(s1) && !off_a1h8(s2))
+                {
+                    bothOnDiagonal[bothCount][0] = idx;
+                    bothOnDiagonal[bothCount++][1] = s2;
+                }
+                else
+                    MapKK[idx][s2] = code++;
+            }
+        }
+
+    for (int i = 0; i < bothCount; ++i) MapKK[bothOnDiagonal[i][0]][bothOnDiagonal[i][1]] = code++;
+
+    // Binomial[k][n] is the number of ways to choose k elements from n.
+    memset(Binomial, 0, sizeof(Binomial));
+    Binomial[0][0] = 1;
+
+    for (int n = 1; n < 64; ++n)
+        for (int k = 0; k < 6 && k <= n; ++k)
+            Binomial[k][n] =
+                (k > 0 ? Binomial[k - 1][n - 1] : 0) + (k < n ? Binomial[k][n - 1] : 0);
+
+    // MapPawns[] encodes the squares A2-H7 to 0..47, such that the leading pawn
+    // (the one closest to the edge, and with the lowest rank for equal files)
+    // has the highest value. LeadPawnIdx[] and LeadPawnsSize[] store the
+    // indexes of the leading pawn groups for each leading file.
+    int availableSquares = 47;
+
+    for (int leadPawnsCnt = 1; leadPawnsCnt <= 5; ++leadPawnsCnt)
+        for (file_t f = FILE_A; f <= FILE_D; ++f)
+        {
+            uint64_t idx = 0;
+
+            for (rank_t r = RANK_2; r <= RANK_7; ++r)
+            {
+                const square_t sq = create_sq(f, r);
+
+                if (leadPawnsCnt == 1)
+                {
+                    MapPawns[sq] = availableSquares--;
+                    MapPawns[sq ^ 7] = availableSquares--;
+                }
+
+                LeadPawnIdx[leadPawnsCnt][sq] = idx;
+                idx += Binomial[leadPawnsCnt - 1][MapPawns[sq]];
+            }
+
+            LeadPawnsSize[leadPawnsCnt][f] = idx;
+        }
+}
+
+// Computes the material key of the given piece counts, with the same layout
+// as in set_boardstack().
+static hashkey_t tb_material_key(int counts[COLOR_NB][PIECETYPE_NB], bool flip)
+{
+    hashkey_t key = 0;
+
+    for (color_t c = WHITE; c <= BLACK; ++c)
+        for (piecetype_t pt = PAWN; pt <= KING; ++pt)
+        {
+            const int count = (pt == KING) ? 1 : counts[c][pt];
+
+            for (int i = 0; i < count; ++i)
+                key ^= ZobristPsq[create_piece(flip ? not_color(c) : c, pt)][i];
+        }
+
+    return key;
+}
+
+// Opens the given table file in one of the Syzygy directories.
+static FILE *tb_open_file(const char *filename)
+{
+    const char *path = TbPaths;
+
+    while (path != NULL && *path != '\0')
+    {
+        const char *end = strchr(path, TB_PATH_SEPARATOR);
+        const int len = (end == NULL) ? (int)strlen(path) : (int)(end - path);
+        char fullname[4096];
+
+        snprintf(fullname, sizeof(fullname), "%.*s/%s", len, path, filename);
+
+        FILE *f = fopen(fullname, "rb");
+
+        if (f != NULL) return f;
+
+        path = (end == NULL) ? NULL : end + 1;
+    }
+
+    return NULL;
+}
+
+static TbTable *tb_find(hashkey_t key, int type)
+{
+    for (size_t i = key & (TB_HASH_SIZE - 1);; i = (i + 1) & (TB_HASH_SIZE - 1))
+    {
+        if (TbHash[i].index == 0) return NULL;
+
+        if (TbHash[i].key == key) return &TbEntries[TbHash[i].index - 1].tables[type];
+    }
+}
+
+static void tb_insert(hashkey_t key, int index)
+{
+    size_t i = key & (TB_HASH_SIZE - 1);
+
+    while (TbHash[i].index != 0) i = (i + 1) & (TB_HASH_SIZE - 1);
+
+    TbHash[i].key = key;
+    TbHash[i].index = index + 1;
+}
+
+// Registers the tables of the given material if the WDL file exists.
+static void tb_add(int counts[COLOR_NB][PIECETYPE_NB])
+{
+    const hashkey_t key = tb_material_key(counts, false);
+
+    if (tb_find(key, WDL_TABLE) != NULL) return;
+
+    char name[16];
+    char filename[32];
+    char *ptr = name;
+    int pieceCount = 2;
+
+    for (color_t c = WHITE; c <= BLACK; ++c)
+    {
+        if (c == BLACK) *ptr++ = 'v';
+
+        *ptr++ = 'K';
+
+        for (piecetype_t pt = QUEEN; pt >= PAWN; --pt)
+            for (int i = 0; i < counts[c][pt]; ++i, ++pieceCount) *ptr++ = PieceLetters[pt];
+    }
+
+    *ptr = '\0';
+    snprintf(filename, sizeof(filename), "%s.rtbw", name);
+
+    FILE *f = tb_open_file(filename);
+
+    // Only check for the WDL file, the DTZ one is looked up on first access.
+    if (f == NULL) return;
+
+    fclose(f);
+
+    if (TbEntryCount == TbEntryCapacity)
+    {
+        TbEntryCapacity = TbEntryCapacity ? TbEntryCapacity * 2 : 64;
+        TbEntries = realloc(TbEntries, sizeof(TbEntry) * TbEntryCapacity);
+
+        if (TbEntries == NULL)
+        {
+            perror("Unable to allocate tablebase entries");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    TbEntry *entry = &TbEntries[TbEntryCount];
+    TbTable *wdl = &entry->tables[WDL_TABLE];
+
+    memset(entry, 0, sizeof(TbEntry));
+    strcpy(wdl->name, name);
+    wdl->key = key;
+    wdl->key2 = tb_material_key(counts, true);
+    wdl->pieceCount = pieceCount;
+    wdl->hasPawns = counts[WHITE][PAWN] + counts[BLACK][PAWN] != 0;
+
+    for (color_t c = WHITE; c <= BLACK; ++c)
+        for (piecetype_t pt = PAWN; pt <= QUEEN; ++pt)
+            if (counts[c][pt] == 1) wdl->hasUniquePieces = true;
+
+    // The leading color is the side with the fewest pawns, as it leads to
+    // better compression.
+    const int wpawns = counts[WHITE][PAWN];
+    const int bpawns = counts[BLACK][PAWN];
+    const color_t lead = (!bpawns || (wpawns && bpawns >= wpawns)) ? WHITE : BLACK;
+
+    wdl->pawnCount[0] = counts[lead][PAWN];
+    wdl->pawnCount[1] = counts[not_color(lead)][PAWN];
+
+    entry->tables[DTZ_TABLE] = *wdl;
+    entry->tables[DTZ_TABLE].type = DTZ_TABLE;
+    atomic_init(&wdl->ready, false);
+    atomic_init(&entry->tables[DTZ_TABLE].ready, false);
+
+    // Insert both color orientations of the material.
+    tb_insert(wdl->key, TbEntryCount);
+
+    if (wdl->key2 != wdl->key) tb_insert(wdl->key2, TbEntryCount);
+
+    TbEntryCount++;
+    TbMaxCardinality = imax(TbMaxCardinality, pieceCount);
+}
+
+static void tb_release_table(TbTable *table)
+{
+    for (int i = 0; i < COLOR_NB; ++i)
+        for (int f = 0; f < 4; ++f)
+        {
+            free(table->items[i][f].base64);
+            free(table->items[i][f].symlen);
+        }
+
+    if (table->mapping == NULL) return;
+
+#ifndef _WIN32
+    munmap(table->mapping, table->mappingSize);
+#else
+    free(table->mapping);
+#endif
+}
+
+void tb_free(void)
+{
+    for (int i = 0; i < TbEntryCount; ++i)
+    {
+        tb_release_table(&TbEntries[i].tables[WDL_TABLE]);
+        tb_release_table(&TbEntries[i].tables[DTZ_TABLE]);
+    }
+
+    free(TbEntries);
+    TbEntries = NULL;
+    TbEntryCount = TbEntryCapacity = 0;
+    TbMaxCardinality = 0;
+    memset(TbHash, 0, sizeof(TbHash));
+    free(TbPaths);
+    TbPaths = NULL;
+}
+
+void tb_init(const char *paths)
+{
+    tb_free();
+
+    if (paths == NULL || *paths == '\0' || !strcmp(paths, "<empty>")) return;
+
+    TbPaths = strdup(paths);
+
+    if (TbPaths == NULL)
+    {
+        perror("Unable to allocate tablebase paths");
+        exit(EXIT_FAILURE);
+    }
+
+    tb_init_tables();
+
+    // List all the material distributions with at most 5 non-King pieces, as
+    // piece counts from Pawns to Queens.
+    enum
+    {
+        MaxSets = 252
+    };
+
+    static int Sets[MaxSets][PIECETYPE_NB];
+    int setCount = 0;
+    const int maxOthers = TB_MAX_PIECES - 2;
+
+    for (int code = 0; code < 6 * 6 * 6 * 6 * 6; ++code)
+    {
+        int counts[PIECETYPE_NB] = {0};
+        int total = 0;
+
+        for (int c = code, pt = PAWN; pt <= QUEEN; ++pt, c /= 6) total += counts[pt] = c % 6;
+
+        if (total <= maxOthers) memcpy(Sets[setCount++], counts, sizeof(counts));
+    }
+
+    for (int w = 0; w < setCount; ++w)
+        for (int b = 0; b < setCount; ++b)
+        {
+            int counts[COLOR_NB][PIECETYPE_NB];
+            int total = 0;
+
+            memcpy(counts[WHITE], Sets[w], sizeof(counts[WHITE]));
+            memcpy(counts[BLACK], Sets[b], sizeof(counts[BLACK]));
+
+            for (piecetype_t pt = PAWN; pt <= QUEEN; ++pt)
+                total += counts[WHITE][pt] + counts[BLACK][pt];
+
+            if (total != 0 && total <= maxOthers) tb_add(counts);
+        }
+
+    printf("info string Found %d tablebases\n", TbEntryCount);
+}
+
+// Groups together the pieces which are encoded together: pieces of the same
+// type and color, or the leading group formed by the three first pieces (or
+// the King pair when there are no unique pieces) for pawnless tables.
+static void set_groups(const TbTable *table, PairsData *d, const int order[2], int file)
+{
+    int n = 0;
+    int firstLen = table->hasPawns ? 0 : table->hasUniquePieces ? 3 : 2;
+
+    d->groupLen[n] = 1;
+
+    for (int i = 1; i < table->pieceCount; ++i)
+        if (--firstLen > 0 || d->pieces[i] == d->pieces[i - 1])
+            d->groupLen[n]++;
+        else
+            d->groupLen[++n] = 1;
+
+    d->groupLen[++n] = 0;
+
+    // The groups are encoded in the per-table order given in the file: the
+    // leading group is at order[0], and the remaining pawns (if any) at order[1].
+    const bool pp = table->hasPawns && table->pawnCount[1];
+    int next = pp ? 2 : 1;
+    int freeSquares = 64 - d->groupLen[0] - (pp ? d->groupLen[1] : 0);
+    uint64_t idx = 1;
+
+    for (int k = 0; next < n || k == order[0] || k == order[1]; ++k)
+    {
+        if (k == order[0])
+        {
+            d->groupIdx[0] = idx;
+            idx *= table->hasPawns          ? LeadPawnsSize[d->groupLen[0]][file]
+                   : table->hasUniquePieces ? 31332
+                                            : 462;
+        }
+        else if (k == order[1])
+        {
+            d->groupIdx[1] = idx;
+            idx *= Binomial[d->groupLen[1]][48 - d->groupLen[0]];
+        }
+        else
+        {
+            d->groupIdx[next] = idx;
+            idx *= Binomial[d->groupLen[next]][freeSquares];
+            freeSquares -= d->groupLen[next++];
+        }
+    }
+
+    d->groupIdx[n] = idx;
+}
+
+// Computes the number of values represented by a symbol, by recursively
+// expanding it into its pair of children symbols.
+static uint8_t set_symlen(PairsData *d, int sym, bool *visited)
+{
+    visited[sym] = true;
+
+    const int right = btree_right(d, sym);
+
+    if (right == 0xFFF) return 0;
+
+    const int left = btree_left(d, sym);
+
+    if (!visited[left]) d->symlen[left] = set_symlen(d, left, visited);
+
+    if (!visited[right]) d->symlen[right] = set_symlen(d, right, visited);
+
+    return d->symlen[left] + d->symlen[right] + 1;
+}
+
+static const uint8_t *set_sizes(PairsData *d, const uint8_t *data)
+{
+    d->flags = *data++;
+
+    if (d->flags & TB_FLAG_SINGLE_VALUE)
+    {
+        d->numBlocks = d->blockLengthSize = 0;
+        d->span = d->sparseIndexSize = 0;
+        d->minSymLen = *data++; // Single value of the table
+        return data;
+    }
+
+    int groups = 0;
+
+    while (d->groupLen[groups]) ++groups;
+
+    const uint64_t tbSize = d->groupIdx[groups];
+
+    d->blockSize = (size_t)1 << *data++;
+    d->span = (size_t)1 << *data++;
+    d->sparseIndexSize = (size_t)((tbSize + d->span - 1) / d->span);
+
+    const uint8_t padding = *data++;
+
+    d->numBlocks = read_le32(data);
+    data += 4;
+    d->blockLengthSize = d->numBlocks + padding;
+    d->maxSymLen = *data++;
+    d->minSymLen = *data++;
+    d->lowestSym = data;
+
+    if (d->minSymLen == 0 || d->maxSymLen < d->minSymLen) return NULL;
+
+    const int base64Size = d->maxSymLen - d->minSymLen + 1;
+
+    d->base64 = calloc(base64Size, sizeof(uint64_t));
+
+    if (d->base64 == NULL)
+    {
+        perror("Unable to allocate tablebase data");
+        exit(EXIT_FAILURE);
+    }
+
+    // The canonical Huffman code is ordered such that longer symbols have lower
+    // numeric values, so the lowest symbols of each length are decreasing.
+    for (int i = base64Size - 2; i >= 0; --i)
+        d->base64[i] = (d->base64[i + 1] + read_le16(d->lowestSym + 2 * i)
+                           - read_le16(d->lowestSym + 2 * (i + 1)))
+                       / 2;
+
+    for (int i = 0; i < base64Size; ++i) d->base64[i] <<= 64 - i - d->minSymLen;
+
+    data += base64Size * 2;
+    d->symCount = read_le16(data);
+    data += 2;
+    d->btree = data;
+    d->symlen = calloc(d->symCount + 1, 1);
+
+    bool *visited = calloc(d->symCount + 1, sizeof(bool));
+
+    if (d->symlen == NULL || visited == NULL)
+    {
+        perror("Unable to allocate tablebase data");
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t sym = 0; sym < d->symCount; ++sym)
+        if (!visited[sym]) d->symlen[sym] = set_symlen(d, (int)sym, visited);
+
+    free(visited);
+    return data + d->symCount * 3 + (d->symCount & 1);
+}
+
+static const uint8_t *set_dtz_map(TbTable *table, const uint8_t *data, int maxFile)
+{
+    table->map = data;
+
+    for (int f = FILE_A; f <= maxFile; ++f)
+    {
+        PairsData *d = table_item(table, 0, f);
+
+        if (!(d->flags & TB_FLAG_MAPPED)) continue;
+
+        if (d->flags & TB_FLAG_WIDE)
+        {
+            data += (uintptr_t)data & 1;
+
+            for (int i = 0; i < 4; ++i)
+            {
+                d->mapIdx[i] = (uint16_t)((data - table->map) / 2 + 1);
+                data += 2 * read_le16(data) + 2;
+            }
+        }
+        else
+            for (int i = 0; i < 4; ++i)
+            {
+                d->mapIdx[i] = (uint16_t)(data - table->map + 1);
+                data += *data + 1;
+            }
+    }
+
+    return data + ((uintptr_t)data & 1);
+}
+
+// Fills the indexing information of the table from the mapped file data.
+static bool tb_setup_table(TbTable *table, const uint8_t *data, const uint8_t *end)
+{
+    const bool split = table->key != table->key2;
+
+    if (!!(*data & TB_HEADER_HAS_PAWNS) != table->hasPawns || !!(*data & TB_HEADER_SPLIT) != split)
+        return false;
+
+    data++;
+
+    const int sides = (table->type == WDL_TABLE && split) ? 2 : 1;
+    const int maxFile = table->hasPawns ? FILE_D : FILE_A;
+    const bool pp = table->hasPawns && table->pawnCount[1];
+
+    for (int f = FILE_A; f <= maxFile; ++f)
+    {
+        const int order[2][2] = {{*data & 0xF, pp ? data[1] & 0xF : 0xF},
+            {*data >> 4, pp ? data[1] >> 4 : 0xF}};
+
+        data += 1 + pp;
+
+        for (int k = 0; k < table->pieceCount; ++k, ++data)
+            for (int i = 0; i < sides; ++i)
+                table->items[i][f].pieces[k] = (piece_t)(i ? *data >> 4 : *data & 0xF);
+
+        for (int i = 0; i < sides; ++i) set_groups(table, &table->items[i][f], order[i], f);
+    }
+
+    data += (uintptr_t)data & 1;
+
+    for (int f = FILE_A; f <= maxFile; ++f)
+        for (int i = 0; i < sides; ++i)
+            if ((data = set_sizes(&table->items[i][f], data)) == NULL) return false;
+
+    if (table->type == DTZ_TABLE) data = set_dtz_map(table, data, maxFile);
+
+    for (int f = FILE_A; f <= maxFile; ++f)
+        for (int i = 0; i < sides; ++i)
+        {
+            table->items[i][f].sparseIndex = data;
+            data += table->items[i][f].sparseIndexSize * 6;
+        }
+
+    for (int f = FILE_A; f <= maxFile; ++f)
+        for (int i = 0; i < sides; ++i)
+        {
+            table->items[i][f].blockLength = data;
+            data += table->items[i][f].blockLengthSize * 2;
+        }
+
+    for (int f = FILE_A; f <= maxFile; ++f)
+        for (int i = 0; i < sides; ++i)
+        {
+            // The compressed blocks are aligned on 64 bytes.
+            data = (const uint8_t *)(((uintptr_t)data + 0x3F) & ~(uintptr_t)0x3F);
+            table->items[i][f].data = data;
+            data += table->items[i][f].numBlocks * table->items[i][f].blockSize;
+        }
+
+    return data <= end;
+}
+
+// Maps the file of the given table, and checks its magic number.
+static const uint8_t *tb_map_file(TbTable *table)
+{
+    static const uint8_t Magics[2][4] = {{0x71, 0xE8, 0x23, 0x5D}, {0xD7, 0x66, 0x0C, 0xA5}};
+    char filename[32];
+
+    snprintf(filename, sizeof(filename), "%s%s", table->name,
+        table->type == WDL_TABLE ? ".rtbw" : ".rtbz");
+
+    FILE *f = tb_open_file(filename);
+
+    if (f == NULL) return NULL;
+
+#ifndef _WIN32
+    struct stat st;
+
+    // Valid files have a 16-byte header followed by 64-byte aligned data.
+    if (fstat(fileno(f), &st) < 0 || st.st_size % 64 != 16)
+    {
+        printf("info string Corrupted tablebase file '%s'\n", filename);
+        fclose(f);
+        return NULL;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fileno(f), 0);
+
+    fclose(f);
+
+    if (mapping == MAP_FAILED)
+    {
+        printf("info string Unable to map tablebase '%s': %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    madvise(mapping, st.st_size, MADV_RANDOM);
+    table->mappingSize = st.st_size;
+#else
+    fseek(f, 0, SEEK_END);
+
+    const long size = ftell(f);
+
+    fseek(f, 0, SEEK_SET);
+
+    if (size < 0 || size % 64 != 16)
+    {
+        printf("info string Corrupted tablebase file '%s'\n", filename);
+        fclose(f);
+        return NULL;
+    }
+
+    void *mapping = malloc(size);
+
+    if (mapping == NULL)
+    {
+        perror("Unable to allocate tablebase");
+        exit(EXIT_FAILURE);
+    }
+
+    if (fread(mapping, 1, size, f) != (size_t)size)
+    {
+        printf("info string Unable to read tablebase '%s'\n", filename);
+        free(mapping);
+        fclose(f);
+        return NULL;
+    }
+
+    fclose(f);
+    table->mappingSize = size;
+#endif
+
+    table->mapping = mapping;
+
+    if (memcmp(mapping, Magics[table->type], 4))
+    {
+        printf("info string Corrupted tablebase file '%s'\n", filename);
+        tb_release_table(table);
+        table->mapping = NULL;
+        return NULL;
+    }
+
+    return (const uint8_t *)mapping + 4;
+}
+
+// Returns the base address of the table, mapping it on first access. This is
+// thread-safe, as tables are probed concurrently by all workers.
+static const void *tb_mapped(TbTable *table)
+{
+    if (atomic_load_explicit(&table->ready, memory_order_acquire)) return table->mapping;
+
+    pthread_mutex_lock(&TbMutex);
+
+    if (!atomic_load_explicit(&table->ready, memory_order_relaxed))
+    {
+        const uint8_t *data = tb_map_file(table);
+
+        if (data != NULL
+            && !tb_setup_table(table, data, (const uint8_t *)table->mapping + table->mappingSize))
+        {
+            printf("info string Corrupted tablebase file '%s'\n", table->name);
+            tb_release_table(table);
+            memset(table->items, 0, sizeof(table->items));
+            table->mapping = NULL;
+        }
+
+        atomic_store_explicit(&table->ready, true, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&TbMutex);
+    return table->mapping;
+}
+
+// Decompresses the value at the given index of the table. Tables are split in
+// blocks of Huffman-coded symbols, where each symbol represents one or more
+// values through Recursive Pairing.
+static int decompress_pairs(const PairsData *d, uint64_t idx)
+{
+    if (d->flags & TB_FLAG_SINGLE_VALUE) return d->minSymLen;
+
+    // Locate the block containing the value with the sparse index, which
+    // stores the block and offset of the value at index k * span + span / 2.
+    const uint32_t k = (uint32_t)(idx / d->span);
+    uint32_t block = read_le32(d->sparseIndex + 6 * k);
+    int offset = read_le16(d->sparseIndex + 6 * k + 4);
+
+    offset += (int)(idx % d->span) - (int)(d->span / 2);
+
+    while (offset < 0) offset += block_length(d, --block) + 1;
+
+    while (offset > block_length(d, block)) offset -= block_length(d, block++) + 1;
+
+    const uint8_t *ptr = d->data + (uint64_t)block * d->blockSize;
+    uint64_t buf64 = read_be64(ptr);
+    int buf64Size = 64;
+    int sym;
+
+    ptr += 8;
+
+    while (true)
+    {
+        int len = 0;
+
+        // Find the symbol length, then the symbol itself, since all symbols of
+        // a given length are consecutive integers.
+        while (buf64 < d->base64[len]) ++len;
+
+        sym = (int)((buf64 - d->base64[len]) >> (64 - len - d->minSymLen));
+        sym += read_le16(d->lowestSym + 2 * len);
+
+        if (offset < d->symlen[sym] + 1) break;
+
+        offset -= d->symlen[sym] + 1;
+        len += d->minSymLen;
+        buf64 <<= len;
+        buf64Size -= len;
+
+        // Refill the buffer.
+        if (buf64Size <= 32)
+        {
+            buf64Size += 32;
+            buf64 |= (uint64_t)read_be32(ptr) << (64 - buf64Size);
+            ptr += 4;
+        }
+    }
+
+    // Expand the symbol until reaching the leaf which stores our value.
+    while (d->symlen[sym])
+    {
+        const int left = btree_left(d, sym);
+
+        if (offset < d->symlen[left] + 1)
+            sym = left;
+        else
+        {
+            offset -= d->symlen[left] + 1;
+            sym = btree_right(d, sym);
+        }
+    }
+
+    return btree_left(d, sym);
+}
+
+// Converts the stored value to a WDL score or to a DTZ in plies.
+static int map_score(TbTable *table, int file, int value, int wdl)
+{
+    static const int WDLMap[] = {1, 3, 0, 2, 0};
+
+    if (table->type == WDL_TABLE) return value - 2;
+
+    const PairsData *d = table_item(table, 0, file);
+
+    if (d->flags & TB_FLAG_MAPPED)
+    {
+        const int idx = d->mapIdx[WDLMap[wdl + 2]] + value;
+
+        value = (d->flags & TB_FLAG_WIDE) ? read_le16(table->map + 2 * idx) : table->map[idx];
+    }
+
+    if ((wdl == TB_WIN && !(d->flags & TB_FLAG_WIN_PLIES))
+        || (wdl == TB_LOSS && !(d->flags & TB_FLAG_LOSS_PLIES)) || wdl == TB_CURSED_WIN
+        || wdl == TB_BLESSED_LOSS)
+        value *= 2;
+
+    return value + 1;
+}
+
+// Sorts the pawn squares by increasing MapPawns[] value.
+static void sort_pawns(square_t *squares, int count)
+{
+    for (int i = 1; i < count; ++i)
+    {
+        const square_t sq = squares[i];
+        int j = i - 1;
+
+        for (; j >= 0 && MapPawns[squares[j]] > MapPawns[sq]; --j) squares[j + 1] = squares[j];
+
+        squares[j + 1] = sq;
+    }
+}
+
+static void sort_squares(square_t *squares, int count)
+{
+    for (int i = 1; i < count; ++i)
+    {
+        const square_t sq = squares[i];
+        int j = i - 1;
+
+        for (; j >= 0 && squares[j] > sq; --j) squares[j + 1] = squares[j];
+
+        squares[j + 1] = sq;
+    }
+}
+
+// Computes the index of the position in the table, and probes it.
+static int do_probe_table(const Board *board, TbTable *table, int wdl, int *result)
+{
+    square_t squares[TB_MAX_PIECES];
+    piece_t pieces[TB_MAX_PIECES];
+    uint64_t idx;
+    int next = 0, size = 0, leadPawnsCnt = 0;
+    bitboard_t b, leadPawns = 0;
+    int tbFile = FILE_A;
+
+    // Tables are computed with White as the stronger side, and symmetric
+    // tables only store the White to move case, so flip the colors and the
+    // squares if needed.
+    const bool blackSymmetric = board->sideToMove == BLACK && table->key == table->key2;
+    const bool blackStronger = board->stack->materialKey != table->key;
+    const int flip = blackSymmetric || blackStronger;
+    const int flipColor = flip * 8;
+    const int flipSquares = flip * 56;
+    const int stm = flip ^ board->sideToMove;
+
+    // For tables with pawns, there are 4 tables depending on the file of the
+    // leading pawn, i.e. the one with the highest MapPawns[] value.
+    if (table->hasPawns)
+    {
+        const piece_t pc = table->items[0][0].pieces[0] ^ flipColor;
+        int best = 0;
+
+        leadPawns = b = piece_bb(board, piece_color(pc), PAWN);
+
+        while (b) squares[size++] = bb_pop_first_sq(&b) ^ flipSquares;
+
+        leadPawnsCnt = size;
+
+        for (int i = 1; i < leadPawnsCnt; ++i)
+            if (MapPawns[squares[i]] > MapPawns[squares[best]]) best = i;
+
+        const square_t tmp = squares[0];
+
+        squares[0] = squares[best];
+        squares[best] = tmp;
+        tbFile = edge_distance(sq_file(squares[0]));
+    }
+
+    // DTZ tables are one-sided, so exit early if they store the other side.
+    if (table->type == DTZ_TABLE)
+    {
+        const PairsData *d = table_item(table, stm, tbFile);
+
+        if ((d->flags & TB_FLAG_STM) != stm && (table->key != table->key2 || table->hasPawns))
+        {
+            *result = TB_CHANGE_STM;
+            return 0;
+        }
+    }
+
+    b = occupancy_bb(board) ^ leadPawns;
+
+    while (b)
+    {
+        const square_t s = bb_pop_first_sq(&b);
+
+        squares[size] = s ^ flipSquares;
+        pieces[size++] = piece_on(board, s) ^ flipColor;
+    }
+
+    const PairsData *d = table_item(table, stm, tbFile);
+
+    // Reorder the pieces to follow the sequence stored in the table.
+    for (int i = leadPawnsCnt; i < size - 1; ++i)
+        for (int j = i + 1; j < size; ++j)
+            if (d->pieces[i] == pieces[j])
+            {
+                const piece_t tmpPiece = pieces[i];
+                const square_t tmpSquare = squares[i];
+
+                pieces[i] = pieces[j];
+                pieces[j] = tmpPiece;
+                squares[i] = squares[j];
+                squares[j] = tmpSquare;
+                break;
+            }
+
+    // Map the squares so that the leading piece is on the files A-D.
+    if (sq_file(squares[0]) > FILE_D)
+        for (int i = 0; i < size; ++i) squares[i] ^= 7;
+
+    if (table->hasPawns)
+    {
+        idx = LeadPawnIdx[leadPawnsCnt][squares[0]];
+        sort_pawns(squares + 1, leadPawnsCnt - 1);
+
+        for (int i = 1; i < leadPawnsCnt; ++i) idx += Binomial[i][MapPawns[squares[i]]];
+
+        goto encode_remaining;
+    }
+
+    // Without pawns, also map the leading piece to the ranks 1-4, and the
+    // first piece of the leading group which isn't on the A1-H8 diagonal
+    // below it.
+    if (sq_rank(squares[0]) > RANK_4)
+        for (int i = 0; i < size; ++i) squares[i] ^= 56;
+
+    for (int i = 0; i < d->groupLen[0]; ++i)
+    {
+        if (!off_a1h8(squares[i])) continue;
+
+        if (off_a1h8(squares[i]) > 0)
+            for (int j = i; j < size; ++j)
+                squares[j] = ((squares[j] >> 3) | (squares[j] << 3)) & 63;
+
+        break;
+    }
+
+    // Encode the leading group: either the three first unique pieces, or the
+    // King pair.
+    if (table->hasUniquePieces)
+    {
+        const int adjust1 = squares[1] > squares[0];
+        const int adjust2 = (squares[2] > squares[0]) + (squares[2] > squares[1]);
+
+        if (off_a1h8(squares[0]))
+            idx = ((uint64_t)MapA1D1D4[squares[0]] * 63 + (squares[1] - adjust1)) * 62 + squares[2]
+                  - adjust2;
+
+        else if (off_a1h8(squares[1]))
+            idx = (6 * 63 + sq_rank(squares[0]) * 28 + MapB1H1H7[squares[1]]) * 62 + squares[2]
+                  - adjust2;
+
+        else if (off_a1h8(squares[2]))
+            idx = 6 * 63 * 62 + 4 * 28 * 62 + sq_rank(squares[0]) * 7 * 28
+                  + (sq_rank(squares[1]) - adjust1) * 28 + MapB1H1H7[squares[2]];
+
+        else
+            idx = 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + sq_rank(squares[0]) * 7 * 6
+                  + (sq_rank(squares[1]) - adjust1) * 6 + (sq_rank(squares[2]) - adjust2);
+    }
+    else
+        idx = MapKK[MapA1D1D4[squares[0]]][squares[1]];
+
+encode_remaining:
+    idx *= d->groupIdx[0];
+
+    square_t *groupSq = squares + d->groupLen[0];
+    bool remainingPawns = table->hasPawns && table->pawnCount[1];
+
+    // Encode the remaining pawns, then the remaining pieces, by increasing
+    // square order in each group.
+    while (d->groupLen[++next])
+    {
+        uint64_t n = 0;
+
+        sort_squares(groupSq, d->groupLen[next]);
+
+        for (int i = 0; i < d->groupLen[next]; ++i)
+        {
+            // Skip the squares already occupied by the previous groups.
+            int adjust = 0;
+
+            for (const square_t *s = squares; s < groupSq; ++s) adjust += groupSq[i] > *s;
+
+            n += Binomial[i + 1][groupSq[i] - adjust - 8 * remainingPawns];
+        }
+
+        remainingPawns = false;
+        idx += n * d->groupIdx[next];
+        groupSq += d->groupLen[next];
+    }
+
+    return map_score(table, tbFile, decompress_pairs(d, idx), wdl);
+}
+
+static int probe_table(const Board *board, int type, int wdl, int *result)
+{
+    // KvK is always a draw.
+    if (popcount(occupancy_bb(board)) == 2) return TB_DRAW;
+
+    TbTable *table = tb_find(board->stack->materialKey, type);
+
+    if (table == NULL || tb_mapped(table) == NULL)
+    {
+        *result = TB_FAIL;
+        return 0;
+    }
+
+    return do_probe_table(board, table, wdl, result);
+}
+
+// Tables store "don't care" values for positions where the side to move has a
+// winning capture (or zeroing move for DTZ), and may store losses for drawn
+// positions with a drawing capture, so we need to search the captures and
+// take the best result between them and the table value.
+static int tb_search(Board *board, int *result, bool checkZeroingMoves)
+{
+    int value, bestValue = TB_LOSS;
+    Movelist list;
+    Boardstack stack;
+    size_t moveCount = 0;
+
+    list_all(&list, board);
+
+    for (const ExtendedMove *extmove = movelist_begin(&list); extmove < movelist_end(&list);
+         ++extmove)
+    {
+        const move_t move = extmove->move;
+
+        if (!tb_is_capture(board, move)
+            && (!checkZeroingMoves || piece_type(moved_piece(board, move)) != PAWN))
+            continue;
+
+        moveCount++;
+
+        do_move(board, move, &stack);
+        value = -tb_search(board, result, false);
+        undo_move(board, move);
+
+        if (*result == TB_FAIL) return TB_DRAW;
+
+        if (value > bestValue)
+        {
+            bestValue = value;
+
+            if (value >= TB_WIN)
+            {
+                *result = TB_ZEROING_BEST_MOVE;
+                return value;
+            }
+        }
+    }
+
+    // If all legal moves were searched, we don't need to probe the table, whose
+    // value could be wrong (for example with en passant captures available).
+    const bool noMoreMoves = moveCount != 0 && moveCount == movelist_size(&list);
+
+    if (noMoreMoves)
+        value = bestValue;
+    else
+    {
+        value = probe_table(board, WDL_TABLE, TB_DRAW, result);
+
+        if (*result == TB_FAIL) return TB_DRAW;
+    }
+
+    if (bestValue >= value)
+    {
+        *result = (bestValue > TB_DRAW || noMoreMoves) ? TB_ZEROING_BEST_MOVE : TB_OK;
+        return bestValue;
+    }
+
+    *result = TB_OK;
+    return value;
+}
+
+int tb_probe_wdl(Board *board, int *result)
+{
+    *result = TB_OK;
+    return tb_search(board, result, false);
+}
+
+int tb_probe_dtz(Board *board, int *result)
+{
+    *result = TB_OK;
+
+    const int wdl = tb_search(board, result, true);
+
+    // DTZ tables don't store draws.
+    if (*result == TB_FAIL || wdl == TB_DRAW) return 0;
+
+    // The table stores a "don't care" value if the best move is zeroing.
+    if (*result == TB_ZEROING_BEST_MOVE) return dtz_before_zeroing(wdl);
+
+    int dtz = probe_table(board, DTZ_TABLE, wdl, result);
+
+    if (*result == TB_FAIL) return 0;
+
+    if (*result != TB_CHANGE_STM)
+        return (dtz + 100 * (wdl == TB_BLESSED_LOSS || wdl == TB_CURSED_WIN)) * sign_of(wdl);
+
+    // The table stores the other side to move, so do a 1-ply search and find
+    // the move which minimizes the DTZ.
+    Movelist list;
+    Boardstack stack;
+    int minDtz = 0xFFFF;
+
+    list_all(&list, board);
+
+    for (const ExtendedMove *extmove = movelist_begin(&list); extmove < movelist_end(&list);
+         ++extmove)
+    {
+        const move_t move = extmove->move;
+        const bool zeroing =
+            tb_is_capture(board, move) || piece_type(moved_piece(board, move)) == PAWN;
+
+        do_move(board, move, &stack);
+
+        // For zeroing moves, we want the DTZ of the move before doing it, so
+        // only search the resulting position to get the sign of the score.
+        dtz = zeroing ? -dtz_before_zeroing(tb_search(board, result, false))
+                      : -tb_probe_dtz(board, result);
+
+        // If the move mates, force the DTZ to 1.
+        if (dtz == 1 && board->stack->checkers)
+        {
+            Movelist replies;
+
+            list_all(&replies, board);
+
+            if (movelist_size(&replies) == 0) minDtz = 1;
+        }
+
+        if (!zeroing) dtz += sign_of(dtz);
+
+        // Skip the draws, and only pick positive DTZs if we're winning.
+        if (dtz < minDtz && sign_of(dtz) == sign_of(wdl)) minDtz = dtz;
+
+        undo_move(board, move);
+
+        if (*result == TB_FAIL) return 0;
+    }
+
+    // When there are no legal moves, the side to move is mated.
+    return minDtz == 0xFFFF ? -1 : minDtz;
+}
+
+// Checks if a position was repeated since the last zeroing move.
+static bool tb_has_repeated(const Board *board)
+{
+    const Boardstack *stack = board->stack;
+    int plies = imin(stack->rule50, stack->pliesFromNullMove);
+
+    while (plies-- >= 4 && stack != NULL)
+    {
+        if (stack->repetition) return true;
+
+        stack = stack->prev;
+    }
+
+    return false;
+}
+
+// Ranks the root moves with the DTZ tables. Returns false if a probe failed.
+static bool tb_root_probe(Board *board, RootMove *rootMoves, size_t rootCount, bool useRule50)
+{
+    const int cnt50 = board->stack->rule50;
+    const bool rep = tb_has_repeated(board);
+    const int bound = useRule50 ? 900 : 1;
+    Boardstack stack;
+    int result = TB_OK;
+
+    for (size_t i = 0; i < rootCount; ++i)
+    {
+        RootMove *rm = &rootMoves[i];
+        int dtz;
+
+        do_move(board, rm->move, &stack);
+
+        // For zeroing moves, the DTZ is one of -101/-1/0/1/101.
+        if (board->stack->rule50 == 0)
+            dtz = dtz_before_zeroing(-tb_probe_wdl(board, &result));
+
+        // Root moves leading to a 3-fold repetition or to the 50-move rule are
+        // draws.
+        else if (game_is_drawn(board, 1))
+            dtz = 0;
+
+        // Otherwise, take the DTZ of the new position, corrected by 1 ply.
+        else
+        {
+            dtz = -tb_probe_dtz(board, &result);
+            dtz += sign_of(dtz);
+        }
+
+        // Make sure that a mating move is assigned a DTZ of 1.
+        if (board->stack->checkers && dtz == 2)
+        {
+            Movelist replies;
+
+            list_all(&replies, board);
+
+            if (movelist_size(&replies) == 0) dtz = 1;
+        }
+
+        undo_move(board, rm->move);
+
+        if (result == TB_FAIL) return false;
+
+        // Better moves are ranked higher. Certain wins are ranked equally, and
+        // losing moves are ranked equally unless a 50-move draw is in sight.
+        const int r = (dtz > 0)   ? (dtz + cnt50 <= 99 && !rep) ? TB_MAX_DTZ
+                                                                : TB_MAX_DTZ - (dtz + cnt50)
+                      : (dtz < 0) ? (-dtz * 2 + cnt50 < 100) ? -TB_MAX_DTZ
+                                                             : -TB_MAX_DTZ + (-dtz + cnt50)
+                                  : 0;
+
+        rm->tbRank = r;
+
+        // Give at least 1cp to cursed wins, and let the score grow to half a
+        // Pawn as the position gets closer to a real win.
+        rm->tbScore = r >= bound   ? MATE_FOUND - 1
+                      : r > 0      ? imax(3, r - (TB_MAX_DTZ - 200)) * PAWN_EG_SCORE / 200
+                      : r == 0     ? DRAW
+                      : r > -bound ? imin(-3, r + (TB_MAX_DTZ - 200)) * PAWN_EG_SCORE / 200
+                                   : -MATE_FOUND + 1;
+    }
+
+    return true;
+}
+
+// Ranks the root moves with the WDL tables, as a fallback when DTZ tables are
+// missing. Returns false if a probe failed.
+static bool tb_root_probe_wdl(
+    Board *board, RootMove *rootMoves, size_t rootCount, bool useRule50)
+{
+    static const int WDLToRank[] = {
+        -TB_MAX_DTZ, -TB_MAX_DTZ + 101, 0, TB_MAX_DTZ - 101, TB_MAX_DTZ};
+    static const score_t WDLToScore[] = {-MATE_FOUND + 1, DRAW - 2, DRAW, DRAW + 2, MATE_FOUND - 1};
+
+    Boardstack stack;
+    int result = TB_OK;
+
+    for (size_t i = 0; i < rootCount; ++i)
+    {
+        RootMove *rm = &rootMoves[i];
+        int wdl;
+
+        do_move(board, rm->move, &stack);
+        wdl = game_is_drawn(board, 1) ? TB_DRAW : -tb_probe_wdl(board, &result);
+        undo_move(board, rm->move);
+
+        if (result == TB_FAIL) return false;
+
+        rm->tbRank = WDLToRank[wdl + 2];
+
+        if (!useRule50) wdl = (wdl > TB_DRAW) ? TB_WIN : (wdl < TB_DRAW) ? TB_LOSS : TB_DRAW;
+
+        rm->tbScore = WDLToScore[wdl + 2];
+    }
+
+    return true;
+}
+
+void tb_rank_root_moves(WorkerPool *wpool, Board *board, RootMove *rootMoves, size_t *rootCount)
+{
+    bool dtzAvailable = true;
+
+    wpool->tbRootInTb = false;
+    wpool->tbUseRule50 = wpool->options->syzygy50MoveRule;
+    wpool->tbProbeDepth = (int)wpool->options->syzygyProbeDepth;
+    wpool->tbCardinality = (int)wpool->options->syzygyProbeLimit;
+
+    // Tables with fewer pieces than the probe limit are probed at all depths.
+    if (wpool->tbCardinality > TbMaxCardinality)
+    {
+        wpool->tbCardinality = TbMaxCardinality;
+        wpool->tbProbeDepth = 0;
+    }
+
+    if (*rootCount == 0 || wpool->tbCardinality < popcount(occupancy_bb(board))
+        || board->stack->castlings)
+        return;
+
+    wpool->tbRootInTb = tb_root_probe(board, rootMoves, *rootCount, wpool->tbUseRule50);
+
+    if (!wpool->tbRootInTb)
+    {
+        dtzAvailable = false;
+        wpool->tbRootInTb = tb_root_probe_wdl(board, rootMoves, *rootCount, wpool->tbUseRule50);
+    }
+
+    if (!wpool->tbRootInTb) return;
+
+    // Only keep the best ranked moves, so that the search can't pick a move
+    // which spoils the tablebase result.
+    int bestRank = rootMoves[0].tbRank;
+    size_t kept = 0;
+
+    for (size_t i = 1; i < *rootCount; ++i) bestRank = imax(bestRank, rootMoves[i].tbRank);
+
+    for (size_t i = 0; i < *rootCount; ++i)
+        if (rootMoves[i].tbRank == bestRank)
+        {
+            if (kept != i) rootMoves[kept] = rootMoves[i];
+
+            kept++;
+        }
+
+    *rootCount = kept;
+
+    // Only probe during search if DTZ tables are missing and we are winning.
+    if (dtzAvailable || rootMoves[0].tbScore <= DRAW) wpool->tbCardinality = 0;
+}
+
+// Places the pieces of the given material class on random squares. Returns
+// false if the resulting position is illegal.
+static bool tb_random_position(
+    Board *restrict board, Boardstack *restrict stack, const char *name, uint64_t *seed)
+{
+    char grid[SQUARE_NB] = {0};
+    char fen[128];
+    char *ptr = fen;
+    bool white = true;
+
+    for (const char *c = name; *c; ++c)
+    {
+        if (*c == 'v')
+        {
+            white = false;
+            continue;
+        }
+
+        square_t square;
+
+        do square = (square_t)(qrandom(seed) % SQUARE_NB);
+        while (grid[square] || (*c == 'P' && (square < SQ_A2 || square > SQ_H7)));
+
+        grid[square] = white ? *c : (char)tolower(*c);
+    }
+
+    for (int rank = RANK_8; rank >= RANK_1; --rank)
+    {
+        int empty = 0;
+
+        for (file_t file = FILE_A; file <= FILE_H; ++file)
+        {
+            const char piece = grid[create_sq(file, (rank_t)rank)];
+
+            if (!piece)
+                ++empty;
+            else
+            {
+                if (empty) *ptr++ = (char)('0' + empty);
+
+                *ptr++ = piece;
+                empty = 0;
+            }
+        }
+
+        if (empty) *ptr++ = (char)('0' + empty);
+
+        *ptr++ = (rank == RANK_1) ? ' ' : '/';
+    }
+
+    sprintf(ptr, "%c - - 0 1", (qrandom(seed) & 1) ? 'b' : 'w');
+
+    if (board_from_fen(board, fen, false, stack) < 0) return false;
+
+    // The side not to move must not be in check.
+    const color_t us = board->sideToMove;
+
+    return !(attackers_to(board, get_king_square(board, not_color(us))) & color_bb(board, us));
+}
+
+// Checks the WDL and DTZ results of the given position against the results
+// one ply deeper, and against the bitbases if available. Returns a description
+// of the first mismatch, or NULL if none was found. Sets *probed to false if
+// a table is missing.
+static const char *tb_check_position(Board *board, bool *probed)
+{
+    int result, dtzResult;
+    const int wdl = tb_probe_wdl(board, &result);
+    const int dtz = tb_probe_dtz(board, &dtzResult);
+
+    if (result == TB_FAIL || dtzResult == TB_FAIL)
+    {
+        *probed = false;
+        return NULL;
+    }
+
+    const Bitbase *bitbase = bitbase_find(board);
+
+    if (bitbase != NULL)
+    {
+        const int expected = bitbase_probe(bitbase, board);
+
+        if (sign_of(wdl) != (expected == BITBASE_WIN) - (expected == BITBASE_LOSS))
+            return "WDL doesn't match the bitbase";
+    }
+
+    // DTZ values are given in plies, and may be rounded up by one ply.
+    if (sign_of(dtz) != sign_of(wdl)
+        || (wdl == TB_WIN || wdl == TB_LOSS) != (abs(dtz) >= 1 && abs(dtz) <= 101)
+        || (wdl == TB_CURSED_WIN || wdl == TB_BLESSED_LOSS) != (abs(dtz) >= 100))
+        return "DTZ doesn't match WDL";
+
+    Movelist list;
+    Boardstack next;
+    int bestSign = -1;
+    int minDtz = 0xFFFF;
+
+    list_all(&list, board);
+
+    if (movelist_size(&list) == 0)
+        return sign_of(wdl) != (board->stack->checkers ? -1 : 0) ? "WDL of a final position" : NULL;
+
+    for (const ExtendedMove *extmove = movelist_begin(&list); extmove < movelist_end(&list);
+         ++extmove)
+    {
+        const move_t move = extmove->move;
+        const bool zeroing =
+            tb_is_capture(board, move) || piece_type(moved_piece(board, move)) == PAWN;
+        int moveDtz = 0;
+        Movelist replies;
+
+        do_move(board, move, &next);
+        list_all(&replies, board);
+
+        const int childWdl = tb_probe_wdl(board, &result);
+
+        if (result != TB_FAIL && zeroing)
+            moveDtz = dtz_before_zeroing(-childWdl);
+        else if (result != TB_FAIL && movelist_size(&replies) == 0 && board->stack->checkers)
+            moveDtz = 1;
+        else if (result != TB_FAIL)
+        {
+            moveDtz = -tb_probe_dtz(board, &result);
+            moveDtz += sign_of(moveDtz);
+        }
+
+        undo_move(board, move);
+
+        if (result == TB_FAIL)
+        {
+            *probed = false;
+            return NULL;
+        }
+
+        if (bestSign < -sign_of(childWdl)) bestSign = -sign_of(childWdl);
+
+        if (moveDtz < minDtz && sign_of(moveDtz) == sign_of(wdl)) minDtz = moveDtz;
+    }
+
+    if (bestSign != sign_of(wdl)) return "WDL doesn't match the best move";
+
+    if (wdl != TB_DRAW && abs(dtz - minDtz) > 1) return "DTZ doesn't match the best move";
+
+    return NULL;
+}
+
+void tb_check(const char *name, size_t count)
+{
+    const char *separator = strchr(name, 'v');
+    uint64_t seed = 1048592ul;
+    size_t checked = 0, unprobed = 0, mismatches = 0;
+
+    // Classes are written as "KQvKR", with only one King on each side.
+    if (strlen(name) > TB_MAX_PIECES + 1 || name[0] != 'K' || separator == NULL
+        || separator[1] != 'K' || strspn(name + 1, "QRBNP") != (size_t)(separator - name - 1)
+        || strspn(separator + 2, "QRBNP") != strlen(separator + 2))
+    {
+        printf("info string Invalid material class '%s'\n", name);
+        return;
+    }
+
+    while (checked + unprobed < count)
+    {
+        Board board;
+        Boardstack stack;
+        bool probed = true;
+
+        if (!tb_random_position(&board, &stack, name, &seed)) continue;
+
+        const char *mismatch = tb_check_position(&board, &probed);
+
+        if (!probed)
+        {
+            ++unprobed;
+            continue;
+        }
+
+        ++checked;
+
+        if (mismatch != NULL && mismatches++ < 10)
+            printf("info string %s: %s\n", mismatch, board_fen(&board));
+    }
+
+    printf("info string %s checked %zu unprobed %zu mismatches %zu\n", name, checked, unprobed,
+        mismatches);
+}
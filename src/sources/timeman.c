@@ -180,19 +180,19 @@ void timeman_update(Timeman *tm, const Board *board, move_t bestmove, score_t sc
     debug_printf("info optimal_time %" FMT_INFO "\n", (info_t)tm->optimalTime);
 }
 
-void check_time(void)
+void check_time(WorkerPool *wpool)
 {
-    if (--SearchWorkerPool.checks > 0) return;
+    if (--wpool->checks > 0) return;
 
     // Reset the verification counter.
-    SearchWorkerPool.checks = SearchTimeman.checkFrequency;
+    wpool->checks = wpool->timeman->checkFrequency;
 
     // If we are in infinite mode, or the stop has already been set,
     // we can safely return.
-    if (UciSearchParams.infinite || wpool_is_stopped(&SearchWorkerPool)) return;
+    if (wpool->params->infinite || wpool_is_stopped(wpool)) return;
 
     // Check if we went over the requested node count or the maximal time usage.
-    if (wpool_get_total_nodes(&SearchWorkerPool) >= UciSearchParams.nodes
-        || timeman_must_stop_search(&SearchTimeman, chess_clock()))
-        wpool_stop(&SearchWorkerPool);
+    if (wpool_get_total_nodes(wpool) >= wpool->params->nodes
+        || timeman_must_stop_search(wpool, chess_clock()))
+        wpool_stop(wpool);
 }
@@ -0,0 +1,433 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "transport.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Struct for a transport backend.
+typedef struct _Transport
+{
+    const char *prefix;
+    int (*listen)(const char *address);
+    int (*connect)(const char *address);
+    void (*cleanup)(const char *address);
+} Transport;
+
+enum
+{
+    TRANSPORT_MAX_BUFFERS = 256,
+    TRANSPORT_BUFFER_SIZE = 16384
+};
+
+// Struct for the data received on a socket but not read yet. Each socket is
+// only read by a single thread, but buffers are allocated and released under
+// a lock.
+typedef struct _TransportBuffer
+{
+    int fd;
+    size_t start;
+    size_t end;
+    char data[TRANSPORT_BUFFER_SIZE];
+} TransportBuffer;
+
+static TransportBuffer *Buffers[TRANSPORT_MAX_BUFFERS];
+static pthread_mutex_t BufferLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Returns the read buffer of the given socket, allocating it if requested.
+static TransportBuffer *transport_buffer(int fd, bool create)
+{
+    TransportBuffer *buffer = NULL;
+    size_t freeSlot = TRANSPORT_MAX_BUFFERS;
+
+    pthread_mutex_lock(&BufferLock);
+
+    for (size_t i = 0; i < TRANSPORT_MAX_BUFFERS && buffer == NULL; ++i)
+    {
+        if (Buffers[i] == NULL)
+            freeSlot = (freeSlot == TRANSPORT_MAX_BUFFERS) ? i : freeSlot;
+
+        else if (Buffers[i]->fd == fd)
+            buffer = Buffers[i];
+    }
+
+    if (buffer == NULL && create)
+    {
+        if (freeSlot == TRANSPORT_MAX_BUFFERS || (buffer = malloc(sizeof(TransportBuffer))) == NULL)
+        {
+            perror("Unable to allocate socket buffer");
+            exit(EXIT_FAILURE);
+        }
+
+        buffer->fd = fd;
+        buffer->start = buffer->end = 0;
+        Buffers[freeSlot] = buffer;
+    }
+
+    pthread_mutex_unlock(&BufferLock);
+    return buffer;
+}
+
+// Releases the read buffer of the given socket, if any.
+static void transport_release_buffer(int fd)
+{
+    pthread_mutex_lock(&BufferLock);
+
+    for (size_t i = 0; i < TRANSPORT_MAX_BUFFERS; ++i)
+        if (Buffers[i] != NULL && Buffers[i]->fd == fd)
+        {
+            free(Buffers[i]);
+            Buffers[i] = NULL;
+        }
+
+    pthread_mutex_unlock(&BufferLock);
+}
+
+// Checks if the given buffer holds a complete line.
+static bool transport_has_line(const TransportBuffer *buffer)
+{
+    return buffer != NULL
+           && memchr(buffer->data + buffer->start, '\n', buffer->end - buffer->start) != NULL;
+}
+
+static bool unix_address(const char *path, struct sockaddr_un *addr)
+{
+    if (strlen(path) >= sizeof(addr->sun_path))
+    {
+        printf("info string Socket path '%s' is too long\n", path);
+        return false;
+    }
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy(addr->sun_path, path);
+    return true;
+}
+
+static int unix_listen(const char *path)
+{
+    struct sockaddr_un addr;
+
+    if (!unix_address(path, &addr)) return -1;
+
+    // Remove any socket file left over by a previous process.
+    unlink(path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd >= 0 && (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) || listen(fd, 64)))
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    return fd;
+}
+
+static int unix_connect(const char *path)
+{
+    struct sockaddr_un addr;
+
+    if (!unix_address(path, &addr)) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)))
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    return fd;
+}
+
+static void unix_cleanup(const char *path) { unlink(path); }
+
+// Resolves a "<host>:<port>" address, with an empty host meaning all local
+// interfaces when listening.
+static struct addrinfo *tcp_resolve(const char *address, bool passive)
+{
+    const char *colon = strrchr(address, ':');
+    struct addrinfo hints, *result;
+    char host[256];
+
+    if (colon == NULL || (size_t)(colon - address) >= sizeof(host))
+    {
+        printf("info string Invalid TCP address '%s'\n", address);
+        return NULL;
+    }
+
+    memcpy(host, address, colon - address);
+    host[colon - address] = '\0';
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+    if (getaddrinfo(*host ? host : NULL, colon + 1, &hints, &result))
+    {
+        printf("info string Unable to resolve '%s'\n", address);
+        return NULL;
+    }
+
+    return result;
+}
+
+static int tcp_open(const char *address, bool passive)
+{
+    struct addrinfo *result = tcp_resolve(address, passive);
+    int fd = -1;
+
+    if (result == NULL) return -1;
+
+    for (struct addrinfo *ai = result; ai != NULL && fd < 0; ai = ai->ai_next)
+    {
+        const int one = 1;
+
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+        if (fd < 0) continue;
+
+        // Messages are small and latency-sensitive, so disable Nagle's
+        // algorithm.
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if (passive) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if (passive ? bind(fd, ai->ai_addr, ai->ai_addrlen) || listen(fd, 64)
+                    : connect(fd, ai->ai_addr, ai->ai_addrlen))
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(result);
+    return fd;
+}
+
+static int tcp_listen(const char *address) { return tcp_open(address, true); }
+
+static int tcp_connect(const char *address) { return tcp_open(address, false); }
+
+static const Transport Transports[] = {
+    {"tcp:", &tcp_listen, &tcp_connect, NULL},
+    {"unix:", &unix_listen, &unix_connect, &unix_cleanup},
+};
+
+// Returns the backend for the given address, and strips the address prefix.
+static const Transport *transport_for(const char **address)
+{
+    for (size_t i = 0; i < sizeof(Transports) / sizeof(Transport); ++i)
+        if (!strncmp(*address, Transports[i].prefix, strlen(Transports[i].prefix)))
+        {
+            *address += strlen(Transports[i].prefix);
+            return &Transports[i];
+        }
+
+    // Use Unix sockets by default.
+    return &Transports[1];
+}
+
+int transport_listen(const char *address)
+{
+    const Transport *transport = transport_for(&address);
+
+    return transport->listen(address);
+}
+
+int transport_connect(const char *address)
+{
+    const Transport *transport = transport_for(&address);
+
+    return transport->connect(address);
+}
+
+int transport_accept(int fd) { return accept(fd, NULL, NULL); }
+
+void transport_close(int fd)
+{
+    // Release the buffer while we still own the descriptor, since another
+    // thread may get the same number back as soon as it is closed. Shutting
+    // down the socket first also wakes up any thread blocked on it.
+    transport_release_buffer(fd);
+    shutdown(fd, SHUT_RDWR);
+    close(fd);
+}
+
+void transport_cleanup(const char *address)
+{
+    const Transport *transport = transport_for(&address);
+
+    if (transport->cleanup) transport->cleanup(address);
+}
+
+int transport_poll(const int *fds, bool *ready, size_t count, int timeout)
+{
+    struct pollfd pfds[64];
+    bool buffered[64];
+    int bufferedCount = 0;
+
+    if (count > sizeof(pfds) / sizeof(pfds[0])) count = sizeof(pfds) / sizeof(pfds[0]);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        pfds[i].fd = fds[i];
+        pfds[i].events = POLLIN;
+        pfds[i].revents = 0;
+        buffered[i] = transport_has_line(transport_buffer(fds[i], false));
+        bufferedCount += buffered[i];
+    }
+
+    // Don't wait if complete lines are already buffered.
+    int result = poll(pfds, count, bufferedCount ? 0 : timeout);
+
+    if (result < 0) result = 0;
+
+    // Report errors and hangups as readable, so that the next read detects
+    // the disconnection.
+    for (size_t i = 0; i < count; ++i)
+    {
+        ready[i] = buffered[i] || pfds[i].revents;
+        result += buffered[i] && !pfds[i].revents;
+    }
+
+    return result;
+}
+
+bool transport_send(int fd, const char *message)
+{
+    size_t length = strlen(message);
+
+    while (length)
+    {
+        ssize_t written = send(fd, message, length, MSG_NOSIGNAL);
+
+        if (written <= 0) return false;
+
+        message += written;
+        length -= (size_t)written;
+    }
+
+    return true;
+}
+
+bool transport_read_line(int fd, char *buffer, size_t size, int timeout)
+{
+    TransportBuffer *tb = transport_buffer(fd, true);
+    struct pollfd pfd = {fd, POLLIN, 0};
+
+    while (true)
+    {
+        const char *start = tb->data + tb->start;
+        const size_t pending = tb->end - tb->start;
+        const char *newline = memchr(start, '\n', pending);
+
+        // Return the next line, splitting it if it does not fit in the
+        // output buffer.
+        if (newline != NULL || pending + 1 >= size || pending == TRANSPORT_BUFFER_SIZE)
+        {
+            size_t length = (newline != NULL) ? (size_t)(newline - start) : pending;
+
+            if (length + 1 > size) length = size - 1;
+
+            memcpy(buffer, start, length);
+            buffer[length] = '\0';
+            tb->start += length + (newline != NULL && start + length == newline);
+            return true;
+        }
+
+        // Move the pending data to the start of the buffer before reading
+        // more.
+        memmove(tb->data, start, pending);
+        tb->start = 0;
+        tb->end = pending;
+
+        if (poll(&pfd, 1, timeout) <= 0) return false;
+
+        const ssize_t received = recv(fd, tb->data + tb->end, TRANSPORT_BUFFER_SIZE - tb->end, 0);
+
+        if (received <= 0) return false;
+
+        tb->end += (size_t)received;
+    }
+}
+
+#else
+
+int transport_listen(const char *address)
+{
+    (void)address;
+    return -1;
+}
+
+int transport_connect(const char *address)
+{
+    (void)address;
+    return -1;
+}
+
+int transport_accept(int fd)
+{
+    (void)fd;
+    return -1;
+}
+
+void transport_close(int fd) { (void)fd; }
+
+void transport_cleanup(const char *address) { (void)address; }
+
+int transport_poll(const int *fds, bool *ready, size_t count, int timeout)
+{
+    (void)fds;
+    (void)timeout;
+
+    for (size_t i = 0; i < count; ++i) ready[i] = false;
+
+    return 0;
+}
+
+bool transport_send(int fd, const char *message)
+{
+    (void)fd;
+    (void)message;
+    return false;
+}
+
+bool transport_read_line(int fd, char *buffer, size_t size, int timeout)
+{
+    (void)fd;
+    (void)buffer;
+    (void)size;
+    (void)timeout;
+    return false;
+}
+
+#endif
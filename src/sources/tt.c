@@ -17,12 +17,30 @@
 */
 
 #include "tt.h"
+#include "profile.h"
 #include "uci.h"
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-TranspositionTable SearchTT = {0, NULL, 0};
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+TranspositionTable SearchTT = {0, NULL, &SearchTT.localGeneration, 0, false, false};
+
+// Name of the shared memory segment currently mapped, if any.
+static char SharedName[256];
+
+enum
+{
+    SHARED_TT_WAIT_TRIES = 500,  // Checks for the size of a new shared segment
+    SHARED_TT_WAIT_DELAY = 10000 // Delay between two checks, in microseconds
+};
 
 typedef struct _BzeroThread
 {
@@ -44,6 +62,10 @@ void *tt_bzero_thread(void *data)
 
 void tt_bzero(size_t threadCount)
 {
+    // Only the creator of a shared table may clear it, since other processes
+    // are still using its contents.
+    if (SearchTT.shared && !SearchTT.sharedOwner) return;
+
     // Guard against thread count being zero.
     if (threadCount == 0)
     {
@@ -86,27 +108,128 @@ void tt_bzero(size_t threadCount)
 
 int tt_hashfull(void)
 {
+    const uint8_t generation = tt_generation();
     int count = 0;
 
     for (int i = 0; i < 1000; ++i)
         for (int j = 0; j < ClusterSize; ++j)
-            count += (SearchTT.table[i].clEntry[j].genbound & 0xFC) == SearchTT.generation;
+            count += (SearchTT.table[i].clEntry[j].genbound & 0xFC) == generation;
 
     return count / ClusterSize;
 }
 
+static void tt_release(void)
+{
+    if (SearchTT.table == NULL) return;
+
+#ifndef _WIN32
+    if (SearchTT.shared)
+    {
+        munmap(SearchTT.table - 1, (SearchTT.clusterCount + 1) * sizeof(TT_Cluster));
+
+        // The process which created the segment removes it when done with it.
+        if (SearchTT.sharedOwner) shm_unlink(SharedName);
+
+        SearchTT.shared = SearchTT.sharedOwner = false;
+        SearchTT.table = NULL;
+        SearchTT.generation = &SearchTT.localGeneration;
+        return;
+    }
+#endif
+
+    free(SearchTT.table);
+    SearchTT.table = NULL;
+}
+
+static bool tt_map_shared(const char *name, size_t mbsize)
+{
+#ifndef _WIN32
+    // POSIX shared memory names must start with a slash.
+    snprintf(SharedName, sizeof(SharedName), "%s%s", name[0] == '/' ? "" : "/", name);
+
+    int fd = shm_open(SharedName, O_RDWR | O_CREAT | O_EXCL, 0600);
+    const bool owner = (fd >= 0);
+    struct stat st;
+
+    if (!owner) fd = shm_open(SharedName, O_RDWR, 0600);
+
+    if (fd < 0)
+    {
+        perror("Unable to open shared hashtable");
+        exit(EXIT_FAILURE);
+    }
+
+    // The creator of the segment sets its size, new segments being zero-filled.
+    if (owner && ftruncate(fd, (off_t)(mbsize * 1024 * 1024)))
+    {
+        perror("Unable to resize shared hashtable");
+        exit(EXIT_FAILURE);
+    }
+
+    // The creator may not have resized the segment yet, so give it some time
+    // before giving up on an empty segment.
+    for (int tries = 0; true; ++tries)
+    {
+        if (fstat(fd, &st))
+        {
+            perror("Unable to open shared hashtable");
+            exit(EXIT_FAILURE);
+        }
+
+        if (st.st_size != 0 || tries == SHARED_TT_WAIT_TRIES) break;
+
+        usleep(SHARED_TT_WAIT_DELAY);
+    }
+
+    // The first cluster of the segment holds the shared header.
+    const size_t segmentClusters = (size_t)st.st_size / sizeof(TT_Cluster);
+    TT_SharedHeader *header = segmentClusters < 2
+                                  ? MAP_FAILED
+                                  : mmap(NULL, segmentClusters * sizeof(TT_Cluster),
+                                      PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (header == MAP_FAILED)
+    {
+        perror("Unable to map shared hashtable");
+        exit(EXIT_FAILURE);
+    }
+
+    SearchTT.clusterCount = segmentClusters - 1;
+    SearchTT.table = (TT_Cluster *)(header + 1);
+    SearchTT.generation = &header->generation;
+
+    SearchTT.shared = true;
+    SearchTT.sharedOwner = owner;
+
+    printf("info string %s shared hashtable '%s' (%" FMT_INFO " MB)\n",
+        owner ? "Created" : "Joined", SharedName,
+        (info_t)(SearchTT.clusterCount * sizeof(TT_Cluster) / (1024 * 1024)));
+    return true;
+#else
+    (void)name;
+    (void)mbsize;
+    puts("info string Shared hashtables are not supported on this platform");
+    return false;
+#endif
+}
+
 void tt_resize(size_t mbsize)
 {
     // Free the old TT if it exists.
-    if (SearchTT.table) free(SearchTT.table);
+    tt_release();
 
     if (mbsize == 0)
     {
         SearchTT.clusterCount = 0;
-        SearchTT.table = NULL;
         return;
     }
 
+    const char *name = UciOptionFields.sharedHashName;
+
+    if (name != NULL && *name != '\0' && strcmp(name, "<empty>") && tt_map_shared(name, mbsize))
+        return;
+
     SearchTT.clusterCount = mbsize * 1024 * 1024 / sizeof(TT_Cluster);
     SearchTT.table = malloc(SearchTT.clusterCount * sizeof(TT_Cluster));
 
@@ -123,14 +246,17 @@ void tt_resize(size_t mbsize)
 
 TT_Entry *tt_probe(hashkey_t key, bool *found)
 {
+    PROFILE_SCOPE(PROF_TT_PROBE);
+
     TT_Entry *entry = tt_entry_at(key);
+    const uint8_t generation = tt_generation();
 
     // Try to find an entry matching the given key.
     for (int i = 0; i < ClusterSize; ++i)
         if (!entry[i].key || entry[i].key == key)
         {
             // Refresh the generation counter to prevent it from being cleared.
-            entry[i].genbound = (uint8_t)(SearchTT.generation | (entry[i].genbound & 0x3));
+            entry[i].genbound = (uint8_t)(generation | (entry[i].genbound & 0x3));
             *found = (bool)entry[i].key;
             return entry + i;
         }
@@ -139,8 +265,8 @@ TT_Entry *tt_probe(hashkey_t key, bool *found)
 
     // Find the slot with the minimal (depth + generation * 4) score.
     for (int i = 1; i < ClusterSize; ++i)
-        if (replace->depth - ((259 + SearchTT.generation - replace->genbound) & 0xFC)
-            > entry[i].depth - ((259 + SearchTT.generation - entry[i].genbound) & 0xFC))
+        if (replace->depth - ((259 + generation - replace->genbound) & 0xFC)
+            > entry[i].depth - ((259 + generation - entry[i].genbound) & 0xFC))
             replace = entry + i;
 
     *found = false;
@@ -157,7 +283,7 @@ void tt_save(TT_Entry *entry, hashkey_t k, score_t s, score_t e, int d, int b, m
         entry->key = k;
         entry->score = s;
         entry->eval = e;
-        entry->genbound = SearchTT.generation | (uint8_t)b;
+        entry->genbound = tt_generation() | (uint8_t)b;
         entry->depth = d;
     }
 }
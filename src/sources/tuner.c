@@ -17,6 +17,7 @@
 */
 
 #include "tuner.h"
+#include "datagen.h"
 #include "types.h"
 #include <math.h>
 #include <pthread.h>
@@ -24,6 +25,11 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 void start_tuning_session(const char *filename)
 {
 #ifdef TUNE
@@ -217,7 +223,7 @@ void init_base_values(tp_vector_t base)
 
 void init_tuner_entries(tune_data_t *data, const char *filename)
 {
-    FILE *f = fopen(filename, "r");
+    FILE *f = fopen(filename, "rb");
 
     if (f == NULL)
     {
@@ -225,6 +231,16 @@ void init_tuner_entries(tune_data_t *data, const char *filename)
         exit(EXIT_FAILURE);
     }
 
+    // Packed datasets are mapped and loaded in parallel.
+    if (dataset_is_packed(f))
+    {
+        init_packed_entries(data, f);
+        fclose(f);
+        return;
+    }
+
+    rewind(f);
+
     Board board = {};
     Boardstack stack = {};
     char linebuf[1024];
@@ -245,22 +261,9 @@ void init_tuner_entries(tune_data_t *data, const char *filename)
 
         tune_entry_t *cur = &data->entries[data->size];
 
-        char *ptr = strrchr(linebuf, ' ');
-
-        *ptr = '\0';
-
-        if (sscanf(ptr + 1, "%hd", &cur->gameScore) == 0)
+        if (!dataset_parse_line(linebuf, &cur->gameResult, &cur->gameScore))
         {
-            fputs("Unable to read game score\n", stdout);
-            exit(EXIT_FAILURE);
-        }
-
-        ptr = strrchr(linebuf, ' ');
-
-        *ptr = '\0';
-        if (sscanf(ptr + 1, "%lf", &cur->gameResult) == 0)
-        {
-            fputs("Unable to read game result\n", stdout);
+            fputs("Unable to read game result and score\n", stdout);
             exit(EXIT_FAILURE);
         }
 
@@ -276,9 +279,111 @@ void init_tuner_entries(tune_data_t *data, const char *filename)
             }
         }
     }
+    fclose(f);
     putchar('\n');
 }
 
+void init_packed_entries(tune_data_t *data, FILE *f)
+{
+    fseek(f, 0, SEEK_END);
+
+    const long fileSize = ftell(f);
+    const size_t count = (fileSize - DATASET_MAGIC_SIZE) / sizeof(PackedBoard);
+
+#ifndef _WIN32
+    void *mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+
+    if (mapping == MAP_FAILED)
+    {
+        perror("Unable to map dataset");
+        exit(EXIT_FAILURE);
+    }
+
+    madvise(mapping, fileSize, MADV_SEQUENTIAL);
+
+    const PackedBoard *records =
+        (const PackedBoard *)((const char *)mapping + DATASET_MAGIC_SIZE);
+#else
+    PackedBoard *records = malloc(sizeof(PackedBoard) * count + !count);
+
+    fseek(f, DATASET_MAGIC_SIZE, SEEK_SET);
+
+    if (records == NULL || fread(records, sizeof(PackedBoard), count, f) != count)
+    {
+        perror("Unable to read dataset");
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    data->maxSize = count;
+    data->entries = malloc(sizeof(tune_entry_t) * count + !count);
+
+    if (data->entries == NULL)
+    {
+        perror("Unable to allocate dataset entries");
+        exit(EXIT_FAILURE);
+    }
+
+    // Give each thread its own slice of records, and load them into the
+    // matching slice of entries.
+    pthread_t threads[THREADS];
+    tune_loader_t loaders[THREADS];
+
+    for (int i = 0; i < THREADS; ++i)
+    {
+        const size_t start = count * i / THREADS;
+        const size_t end = count * (i + 1) / THREADS;
+
+        loaders[i] = (tune_loader_t){records + start, data->entries + start, end - start, 0};
+
+        if (pthread_create(&threads[i], NULL, &init_packed_slice, &loaders[i]))
+        {
+            perror("Unable to create loader thread");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Skipped positions leave holes at the end of each slice, so move the
+    // loaded entries together once all threads are done.
+    for (int i = 0; i < THREADS; ++i)
+    {
+        pthread_join(threads[i], NULL);
+        memmove(data->entries + data->size, loaders[i].entries,
+            sizeof(tune_entry_t) * loaders[i].loaded);
+        data->size += loaders[i].loaded;
+    }
+
+#ifndef _WIN32
+    munmap(mapping, fileSize);
+#else
+    free(records);
+#endif
+
+    printf("%u positions loaded\n\n", (unsigned int)data->size);
+    fflush(stdout);
+}
+
+void *init_packed_slice(void *ptr)
+{
+    tune_loader_t *loader = ptr;
+    Board board;
+    Boardstack stack;
+
+    for (size_t i = 0; i < loader->count; ++i)
+    {
+        const PackedBoard *record = &loader->records[i];
+        tune_entry_t *cur = &loader->entries[loader->loaded];
+
+        if (board_from_packed(&board, record, &stack) < 0) continue;
+
+        cur->gameResult = record->result / 2.0;
+        cur->gameScore = record->score;
+        loader->loaded += init_tuner_entry(cur, &board);
+    }
+
+    return NULL;
+}
+
 bool init_tuner_entry(tune_entry_t *entry, const Board *board)
 {
     entry->staticEval = evaluate(board);
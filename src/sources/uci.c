@@ -17,9 +17,14 @@
 */
 
 #include "uci.h"
+#include "bitbase.h"
 #include "evaluate.h"
 #include "movelist.h"
+#include "nnue.h"
 #include "option.h"
+#include "relay.h"
+#include "server.h"
+#include "syzygy.h"
 #include "tt.h"
 #include "types.h"
 #include <ctype.h>
@@ -31,22 +36,27 @@
 #include <string.h>
 #include <unistd.h>
 
-#define UCI_VERSION "v35.6"
-
 // clang-format off
 
 static const CommandMap UciCommands[] =
 {
+    {"analyse", &uci_analyse},
     {"bench", &uci_bench},
+    {"bitbase", &uci_bitbase},
+    {"convert", &uci_convert},
     {"d", &uci_d},
+    {"datagen", &uci_datagen},
     {"debug", &uci_debug},
     {"go", &uci_go},
     {"isready", &uci_isready},
     {"ponderhit", &uci_ponderhit},
     {"position", &uci_position},
     {"quit", &uci_quit},
+    {"relay", &uci_relay},
+    {"server", &uci_server},
     {"setoption", &uci_setoption},
     {"stop", &uci_stop},
+    {"tbcheck", &uci_tbcheck},
     {"uci", &uci_uci},
     {"ucinewgame", &uci_ucinewgame},
     {NULL, NULL}
@@ -88,7 +98,9 @@ char *get_next_token(char **str)
 
 const char *move_to_str(move_t move, bool isChess960)
 {
-    static char buf[6];
+    // The buffer is per thread, since the searches of server sessions run
+    // concurrently.
+    static _Thread_local char buf[6];
 
     // Handle side-cases early.
     if (move == NO_MOVE) return "none";
@@ -153,11 +165,11 @@ int winrate_model(score_t score, int ply)
     return (int)(0.5 + 1000.0 / (1.0 + exp((a - v) / b)));
 }
 
-const char *score_to_wdl(score_t score, int ply)
+const char *score_to_wdl(score_t score, int ply, bool showWDL)
 {
-    static char buf[17];
+    static _Thread_local char buf[17];
 
-    if (!UciOptionFields.showWDL)
+    if (!showWDL)
         buf[0] = '\0';
 
     else
@@ -172,17 +184,17 @@ const char *score_to_wdl(score_t score, int ply)
     return buf;
 }
 
-const char *score_to_str(score_t score)
+const char *score_to_str(score_t score, bool normalize)
 {
     static const score_t NormalizeScore = 154;
-    static char buf[12];
+    static _Thread_local char buf[12];
 
     if (abs(score) >= MATE_FOUND)
         sprintf(buf, "mate %d", (score > 0 ? MATE - score + 1 : -MATE - score) / 2);
 
     else
     {
-        if (UciOptionFields.normalizeScore) score = (int32_t)score * 100 / NormalizeScore;
+        if (normalize) score = (int32_t)score * 100 / NormalizeScore;
 
         sprintf(buf, "cp %d", score);
     }
@@ -195,11 +207,23 @@ void print_pv(
 {
     static const char *BoundStr[] = {"", " upperbound", " lowerbound", ""};
 
-    uint64_t nodes = wpool_get_total_nodes(&SearchWorkerPool);
+    WorkerPool *wpool = get_worker(board)->pool;
+    uint64_t nodes = wpool_get_total_nodes(wpool);
+
+    if (wpool_is_main(wpool)) nodes += relay_member_nodes();
+
     uint64_t nps = nodes / (time + !time) * 1000;
     bool searchedMove = (rootMove->score != -INF_SCORE);
     score_t rootScore = (searchedMove) ? rootMove->score : rootMove->prevScore;
 
+    // Root moves are only counted once as tablebase hits.
+    uint64_t tbHits = wpool_get_total_tbhits(wpool);
+
+    if (wpool->tbRootInTb) tbHits += wpool_main_worker(wpool)->rootCount;
+
+    // Display the tablebase score if the search didn't find a mate.
+    if (wpool->tbRootInTb && abs(rootScore) < MATE_FOUND) rootScore = rootMove->tbScore;
+
     // At most 256 moves stored in (each taking 5 bytes) + 16 more bytes for
     // potential promotions + 1 byte for the final nullbyte.
     char pvBuffer[256 * 5 + 16 + 1];
@@ -214,7 +238,7 @@ void print_pv(
     }
 
     // clang-format off
-    printf("info"
+    fprintf(wpool->output, "info"
         " depth %d"
         " seldepth %d"
         " multipv %d"
@@ -222,19 +246,22 @@ void print_pv(
         " nodes %" FMT_INFO
         " nps %" FMT_INFO
         " hashfull %d"
+        " tbhits %" FMT_INFO
         " time %" FMT_INFO
         " pv%s\n",
         imax(depth + searchedMove, 1),
         rootMove->seldepth,
         multiPv,
-        score_to_str(rootScore), BoundStr[bound], score_to_wdl(rootScore, board->ply),
+        score_to_str(rootScore, wpool->options->normalizeScore), BoundStr[bound],
+        score_to_wdl(rootScore, board->ply, wpool->options->showWDL),
         (info_t)nodes,
         (info_t)nps,
         tt_hashfull(),
+        (info_t)tbHits,
         (info_t)time,
         pvBuffer);
     // clang-format on
-    fflush(stdout);
+    fflush(wpool->output);
 }
 
 int debug_printf(const char *fmt, ...)
@@ -280,8 +307,9 @@ void uci_ucinewgame(const char *args)
     // Wait for any unfinished search to complete.
     worker_wait_search_end(wpool_main_worker(&SearchWorkerPool));
 
-    // Reset the TT contents.
+    // Reset the TT and shared Pawn table contents.
     tt_bzero((size_t)UciOptionFields.threads);
+    pawn_table_clear();
 
     // Reset the histories for each worker.
     wpool_reset(&SearchWorkerPool);
@@ -319,14 +347,123 @@ void uci_d(const char *args __attribute__((unused)))
     printf("\nFEN: %s\nKey: 0x%" KEY_INFO "\n", board_fen(&UciBoard),
         (info_t)UciBoard.stack->boardKey);
 
-    double eval = (double)evaluate(&UciBoard) / 100.0;
+    double eval = (double)evaluate_cached(&UciBoard) / 100.0;
 
     printf(
         "Eval (from %s's POV): %+.2lf\n\n", UciBoard.sideToMove == WHITE ? "White" : "Black", eval);
+
+    if (UciBoard.stack->bitbase != NULL)
+    {
+        static const char *ResultStr[] = {"draw", "win", "loss"};
+
+        printf("Bitbase: %s for the side to move\n\n",
+            ResultStr[bitbase_probe(UciBoard.stack->bitbase, &UciBoard)]);
+    }
+
     fflush(stdout);
 }
 
-void uci_position(const char *args)
+// Returns the directory used for storing bitbases.
+static const char *bitbase_dir(void)
+{
+    const char *path = UciOptionFields.bitbasePath;
+
+    return (*path == '\0' || !strcmp(path, "<empty>")) ? "." : path;
+}
+
+void uci_bitbase(const char *args)
+{
+    if (args == NULL)
+    {
+        puts("info string Usage: bitbase <class> [<class> ...] (e.g. bitbase KQvKR KPvKP)");
+        fflush(stdout);
+        return;
+    }
+
+    // Wait for any unfinished search to complete.
+    worker_wait_search_end(wpool_main_worker(&SearchWorkerPool));
+
+    char *copy = strdup(args);
+    char *ptr = copy;
+    char *token;
+
+    if (copy == NULL) uci_allocation_failure("bitbase command");
+
+    while ((token = get_next_token(&ptr)) != NULL)
+        if (!bitbase_generate(token, bitbase_dir(), (int)UciOptionFields.threads)) break;
+
+    free(copy);
+
+    // The new bitbases may cover the current position, and cached evals
+    // don't know about them.
+    set_endgame_class(&UciBoard);
+    wpool_reset(&SearchWorkerPool);
+    fflush(stdout);
+}
+
+void uci_relay(const char *args)
+{
+    char *copy = strdup(args ? args : "");
+
+    if (copy == NULL) uci_allocation_failure("relay command");
+
+    char *ptr = copy;
+    char *mode = get_next_token(&ptr);
+    char *address = get_next_token(&ptr);
+
+    if (mode != NULL && address != NULL && !strcmp(mode, "serve"))
+        relay_serve(address);
+    else if (mode != NULL && address != NULL && !strcmp(mode, "join"))
+        relay_join(address);
+    else
+        puts("info string Usage: relay serve <address> | relay join <address>");
+
+    free(copy);
+    fflush(stdout);
+}
+
+void uci_tbcheck(const char *args)
+{
+    char *copy = strdup(args ? args : "");
+
+    if (copy == NULL) uci_allocation_failure("tbcheck command");
+
+    char *ptr = copy;
+    char *name = get_next_token(&ptr);
+    char *count = get_next_token(&ptr);
+
+    if (name != NULL)
+    {
+        // Wait for any unfinished search to complete.
+        worker_wait_search_end(wpool_main_worker(&SearchWorkerPool));
+        tb_check(name, count != NULL ? strtoul(count, NULL, 10) : 10000);
+    }
+    else
+        puts("info string Usage: tbcheck <class> [<count>] (e.g. tbcheck KRvKP 10000)");
+
+    free(copy);
+    fflush(stdout);
+}
+
+void uci_server(const char *args)
+{
+    char *copy = strdup(args ? args : "");
+
+    if (copy == NULL) uci_allocation_failure("server command");
+
+    char *ptr = copy;
+    char *address = get_next_token(&ptr);
+
+    if (address != NULL)
+        server_start(address);
+    else
+        puts("info string Usage: server <address>");
+
+    free(copy);
+    fflush(stdout);
+}
+
+void uci_parse_position(Board *board, const char *args, bool isChess960)
 {
     const char *StartPosFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 
@@ -374,17 +511,16 @@ void uci_position(const char *args)
         return;
     }
 
-    free_boardstack(UciBoard.stack);
+    free_boardstack(board->stack);
 
     Boardstack *firstStack = malloc(sizeof(Boardstack));
 
     if (firstStack == NULL) uci_allocation_failure("board stack");
 
-    const int result = board_from_fen(&UciBoard, fen, UciOptionFields.chess960, firstStack);
+    const int result = board_from_fen(board, fen, isChess960, firstStack);
 
-    if (result < 0) board_from_fen(&UciBoard, StartPosFEN, UciOptionFields.chess960, firstStack);
+    if (result < 0) board_from_fen(board, StartPosFEN, isChess960, firstStack);
 
-    UciBoard.worker = wpool_main_worker(&SearchWorkerPool);
     free(fen);
 
     if (result >= 0)
@@ -394,13 +530,13 @@ void uci_position(const char *args)
         move_t move;
         size_t i = 1;
 
-        while (token && (move = str_to_move(&UciBoard, token)) != NO_MOVE)
+        while (token && (move = str_to_move(board, token)) != NO_MOVE)
         {
             Boardstack *nextStack = malloc(sizeof(Boardstack));
 
             if (nextStack == NULL) uci_allocation_failure("board stack");
 
-            do_move(&UciBoard, move, nextStack);
+            do_move(board, move, nextStack);
             token = get_next_token(&ptr);
             ++i;
         }
@@ -408,104 +544,117 @@ void uci_position(const char *args)
         if (token)
             debug_printf(
                 "info string Failed to parse move token #%lu ('%s')\n", (unsigned long)i, token);
-        debug_printf("info string Final board state: %s\n", board_fen(&UciBoard));
+        debug_printf("info string Final board state: %s\n", board_fen(board));
     }
 
     free(copy);
 }
 
-void uci_go(const char *args)
+void uci_position(const char *args)
 {
-    worker_wait_search_end(wpool_main_worker(&SearchWorkerPool));
+    relay_set_position(args);
+    uci_parse_position(&UciBoard, args, UciOptionFields.chess960);
+    UciBoard.worker = wpool_main_worker(&SearchWorkerPool);
+}
 
-    memset(&UciSearchParams, 0, sizeof(SearchParams));
-    list_all(&UciSearchMoves, &UciBoard);
+void uci_parse_go(
+    const Board *board, const char *args, SearchParams *params, Movelist *searchMoves)
+{
+    memset(params, 0, sizeof(SearchParams));
+    list_all(searchMoves, board);
 
     char *copy = strdup(args ? args : "");
 
     if (copy == NULL) uci_allocation_failure("command copy");
 
-    char *token = strtok(copy, Delimiters);
+    char *ptr = copy;
+    char *token = get_next_token(&ptr);
 
     while (token)
     {
         if (strcmp(token, "searchmoves") == 0)
         {
-            token = strtok(NULL, Delimiters);
+            token = get_next_token(&ptr);
 
-            ExtendedMove *m = UciSearchMoves.moves;
+            ExtendedMove *m = searchMoves->moves;
 
             while (token)
             {
-                (m++)->move = str_to_move(&UciBoard, token);
-                token = strtok(NULL, Delimiters);
+                (m++)->move = str_to_move(board, token);
+                token = get_next_token(&ptr);
             }
-            UciSearchMoves.last = m;
+            searchMoves->last = m;
             break;
         }
         else if (strcmp(token, "wtime") == 0)
         {
-            token = strtok(NULL, Delimiters);
-            if (token) UciSearchParams.wtime = (clock_t)atoll(token);
+            token = get_next_token(&ptr);
+            if (token) params->wtime = (clock_t)atoll(token);
         }
         else if (strcmp(token, "btime") == 0)
         {
-            token = strtok(NULL, Delimiters);
-            if (token) UciSearchParams.btime = (clock_t)atoll(token);
+            token = get_next_token(&ptr);
+            if (token) params->btime = (clock_t)atoll(token);
         }
         else if (strcmp(token, "winc") == 0)
         {
-            token = strtok(NULL, Delimiters);
-            if (token) UciSearchParams.winc = (clock_t)atoll(token);
+            token = get_next_token(&ptr);
+            if (token) params->winc = (clock_t)atoll(token);
         }
         else if (strcmp(token, "binc") == 0)
         {
-            token = strtok(NULL, Delimiters);
-            if (token) UciSearchParams.binc = (clock_t)atoll(token);
+            token = get_next_token(&ptr);
+            if (token) params->binc = (clock_t)atoll(token);
         }
         else if (strcmp(token, "movestogo") == 0)
         {
-            token = strtok(NULL, Delimiters);
-            if (token) UciSearchParams.movestogo = atoi(token);
+            token = get_next_token(&ptr);
+            if (token) params->movestogo = atoi(token);
         }
         else if (strcmp(token, "depth") == 0)
         {
-            token = strtok(NULL, Delimiters);
-            if (token) UciSearchParams.depth = atoi(token);
+            token = get_next_token(&ptr);
+            if (token) params->depth = atoi(token);
         }
         else if (strcmp(token, "nodes") == 0)
         {
-            token = strtok(NULL, Delimiters);
-            if (token) UciSearchParams.nodes = (uint64_t)atoll(token);
+            token = get_next_token(&ptr);
+            if (token) params->nodes = (uint64_t)atoll(token);
         }
         else if (strcmp(token, "mate") == 0)
         {
-            token = strtok(NULL, Delimiters);
-            if (token) UciSearchParams.mate = atoi(token);
+            token = get_next_token(&ptr);
+            if (token) params->mate = atoi(token);
         }
         else if (strcmp(token, "perft") == 0)
         {
-            token = strtok(NULL, Delimiters);
-            if (token) UciSearchParams.perft = atoi(token);
+            token = get_next_token(&ptr);
+            if (token) params->perft = atoi(token);
         }
         else if (strcmp(token, "movetime") == 0)
         {
-            token = strtok(NULL, Delimiters);
-            if (token) UciSearchParams.movetime = (clock_t)atoll(token);
+            token = get_next_token(&ptr);
+            if (token) params->movetime = (clock_t)atoll(token);
         }
         else if (strcmp(token, "infinite") == 0)
-            UciSearchParams.infinite = 1;
+            params->infinite = 1;
 
         else if (strcmp(token, "ponder") == 0)
-            UciSearchParams.ponder = 1;
+            params->ponder = 1;
 
-        token = strtok(NULL, Delimiters);
+        token = get_next_token(&ptr);
     }
 
-    wpool_start_search(&SearchWorkerPool, &UciBoard, &UciSearchParams);
     free(copy);
 }
 
+void uci_go(const char *args)
+{
+    worker_wait_search_end(wpool_main_worker(&SearchWorkerPool));
+    uci_parse_go(&UciBoard, args, &UciSearchParams, &UciSearchMoves);
+    wpool_start_search(&SearchWorkerPool, &UciBoard, &UciSearchParams);
+}
+
 void uci_setoption(const char *args)
 {
     if (!args) return;
@@ -570,7 +719,10 @@ int execute_uci_cmd(const char *command)
     {
         if (strcmp(UciCommands[i].commandName, cmd) == 0)
         {
-            UciCommands[i].call(strtok(NULL, ""));
+            const char *args = strtok(NULL, "");
+
+            if (!server_run_command(cmd, UciCommands[i].call, args)) UciCommands[i].call(args);
+
             break;
         }
     }
@@ -587,9 +739,26 @@ void on_hash_set(void *data)
     fflush(stdout);
 }
 
+void on_shared_pawn_hash_set(void *data)
+{
+    pawn_table_resize((size_t) * (long *)data);
+    fflush(stdout);
+}
+
+void on_shared_hash_name_set(void *data)
+{
+    (void)data;
+
+    // Wait for any unfinished search to complete before remapping the TT.
+    worker_wait_search_end(wpool_main_worker(&SearchWorkerPool));
+    tt_resize((size_t)UciOptionFields.hash);
+    fflush(stdout);
+}
+
 void on_clear_hash(void *nothing __attribute__((unused)))
 {
     tt_bzero((size_t)UciOptionFields.threads);
+    pawn_table_clear();
     fflush(stdout);
 }
 
@@ -599,12 +768,68 @@ void on_thread_set(void *data)
     fflush(stdout);
 }
 
+void on_use_nnue_set(void *data)
+{
+    NnueEnabled = *(bool *)data && nnue_is_loaded();
+
+    // Cached evals may come from the other evaluation.
+    wpool_reset(&SearchWorkerPool);
+
+    if (*(bool *)data && !NnueEnabled)
+        puts("info string No network loaded, using the classical evaluation");
+
+    fflush(stdout);
+}
+
+void on_eval_file_set(void *data)
+{
+    const char *path = *(char **)data;
+
+    if (*path == '\0' || !strcmp(path, "<empty>"))
+        nnue_unload();
+
+    else if (nnue_load(path))
+    {
+        // The accumulators of the current position were computed with the
+        // previous network, if any.
+        for (Boardstack *stack = UciBoard.stack; stack != NULL; stack = stack->prev)
+            stack->accumulator.computed[WHITE] = stack->accumulator.computed[BLACK] = false;
+
+        printf("info string Loaded network '%s'\n", path);
+    }
+
+    on_use_nnue_set(&UciOptionFields.useNnue);
+}
+
+void on_bitbase_path_set(void *data)
+{
+    const char *path = *(char **)data;
+
+    bitbase_unload();
+
+    if (*path != '\0' && strcmp(path, "<empty>"))
+        printf("info string Loaded %d bitbases from '%s'\n", bitbase_load_dir(path), path);
+
+    // Cached evals may come from the previous set of bitbases.
+    set_endgame_class(&UciBoard);
+    wpool_reset(&SearchWorkerPool);
+    fflush(stdout);
+}
+
+void on_syzygy_path_set(void *data)
+{
+    tb_init(*(char **)data);
+    fflush(stdout);
+}
+
 void uci_loop(int argc, char **argv)
 {
     init_option_list(&UciOptionList);
     add_option_spin_int(
-        &UciOptionList, "Threads", &UciOptionFields.threads, 1, 256, &on_thread_set);
+        &UciOptionList, "Threads", &UciOptionFields.threads, 1, MAX_THREADS, &on_thread_set);
     add_option_spin_int(&UciOptionList, "Hash", &UciOptionFields.hash, 1, MAX_HASH, &on_hash_set);
+    add_option_spin_int(&UciOptionList, "SharedPawnHash", &UciOptionFields.sharedPawnHash, 0,
+        MAX_HASH, &on_shared_pawn_hash_set);
     add_option_spin_int(
         &UciOptionList, "Move Overhead", &UciOptionFields.moveOverhead, 0, 30000, NULL);
     add_option_spin_int(&UciOptionList, "MultiPV", &UciOptionFields.multiPv, 1, 500, NULL);
@@ -612,6 +837,44 @@ void uci_loop(int argc, char **argv)
     add_option_check(&UciOptionList, "UCI_ShowWDL", &UciOptionFields.showWDL, NULL);
     add_option_check(&UciOptionList, "NormalizeScore", &UciOptionFields.normalizeScore, NULL);
     add_option_check(&UciOptionList, "Ponder", &UciOptionFields.ponder, NULL);
+    add_option_check(&UciOptionList, "ABDADA", &UciOptionFields.abdada, NULL);
+    add_option_check(&UciOptionList, "HelperDepthSkip", &UciOptionFields.helperDepthSkip, NULL);
+    add_option_check(&UciOptionList, "HelperDiversity", &UciOptionFields.helperDiversity, NULL);
+    add_option_check(&UciOptionList, "Use NNUE", &UciOptionFields.useNnue, &on_use_nnue_set);
+
+    UciOptionFields.evalFile = strdup("<empty>");
+
+    if (UciOptionFields.evalFile == NULL) uci_allocation_failure("option string");
+
+    add_option_string(&UciOptionList, "EvalFile", &UciOptionFields.evalFile, &on_eval_file_set);
+
+    UciOptionFields.bitbasePath = strdup("<empty>");
+
+    if (UciOptionFields.bitbasePath == NULL) uci_allocation_failure("option string");
+
+    add_option_string(
+        &UciOptionList, "BitbasePath", &UciOptionFields.bitbasePath, &on_bitbase_path_set);
+
+    UciOptionFields.syzygyPath = strdup("<empty>");
+
+    if (UciOptionFields.syzygyPath == NULL) uci_allocation_failure("option string");
+
+    add_option_string(
+        &UciOptionList, "SyzygyPath", &UciOptionFields.syzygyPath, &on_syzygy_path_set);
+    add_option_spin_int(
+        &UciOptionList, "SyzygyProbeDepth", &UciOptionFields.syzygyProbeDepth, 1, 100, NULL);
+    add_option_spin_int(&UciOptionList, "SyzygyProbeLimit", &UciOptionFields.syzygyProbeLimit, 0,
+        TB_MAX_PIECES, NULL);
+    add_option_check(&UciOptionList, "Syzygy50MoveRule", &UciOptionFields.syzygy50MoveRule, NULL);
+
+    UciOptionFields.sharedHashName = strdup("<empty>");
+
+    if (UciOptionFields.sharedHashName == NULL) uci_allocation_failure("option string");
+
+    add_option_string(&UciOptionList, "SharedHashName", &UciOptionFields.sharedHashName,
+        &on_shared_hash_name_set);
+    add_option_spin_int(
+        &UciOptionList, "ClusterDepth", &UciOptionFields.clusterDepth, 0, MAX_PLIES, NULL);
     add_option_button(&UciOptionList, "Clear Hash", &on_clear_hash);
 
     uci_position("startpos");
@@ -6,6 +6,9 @@
 
 WorkerPool SearchWorkerPool;
 
+// Task run by the workers in standalone mode.
+static void (*StandaloneTask)(Worker *worker);
+
 INLINED int rtm_greater_than(RootMove *right, RootMove *left)
 {
     if (right->score != left->score)
@@ -51,8 +54,15 @@ void worker_init(Worker *worker, size_t idx)
     worker->idx = idx;
     worker->stack = NULL;
     worker->pawnTable = calloc(PawnTableSize, sizeof(PawnEntry));
+    worker->evalCache = calloc(EvalCacheSize, sizeof(EvalCacheEntry));
+    worker->kingPawnTable = calloc(KingPawnTableSize, sizeof(KingPawnEntry));
+    nnue_finny_reset(&worker->finnyTable);
+#ifdef PROFILE
+    memset(&worker->profile, 0, sizeof(ProfileData));
+#endif
     worker->exit = false;
     worker->searching = true;
+    worker->standalone = false;
 
     if (worker->pawnTable == NULL)
     {
@@ -60,6 +70,18 @@ void worker_init(Worker *worker, size_t idx)
         exit(EXIT_FAILURE);
     }
 
+    if (worker->evalCache == NULL)
+    {
+        perror("Unable to allocate eval cache");
+        exit(EXIT_FAILURE);
+    }
+
+    if (worker->kingPawnTable == NULL)
+    {
+        perror("Unable to allocate King Pawn table");
+        exit(EXIT_FAILURE);
+    }
+
     if (pthread_mutex_init(&worker->mutex, NULL) || pthread_cond_init(&worker->condVar, NULL))
     {
         perror("Unable to initialize worker lock");
@@ -88,6 +110,8 @@ void worker_destroy(Worker *worker)
 
     // Destroy the pawn table and the locks initialized for the worker.
     free(worker->pawnTable);
+    free(worker->evalCache);
+    free(worker->kingPawnTable);
     pthread_mutex_destroy(&worker->mutex);
     pthread_cond_destroy(&worker->condVar);
 }
@@ -99,6 +123,7 @@ void worker_reset(Worker *worker)
     memset(worker->ctHistory, 0, sizeof(continuation_history_t));
     memset(worker->cmHistory, 0, sizeof(countermove_history_t));
     memset(worker->capHistory, 0, sizeof(capture_history_t));
+    memset(worker->evalCache, 0, sizeof(EvalCacheEntry) * EvalCacheSize);
     worker->verifPlies = 0;
 }
 
@@ -123,6 +148,11 @@ void *worker_entry(void *ptr)
 {
     Worker *worker = ptr;
 
+#ifdef PROFILE
+    // Collect the profiling counters of this thread in the worker struct.
+    ThreadProfile = &worker->profile;
+#endif
+
     while (true)
     {
         // Set the worker status as non-searching, and notify all waiting
@@ -141,8 +171,11 @@ void *worker_entry(void *ptr)
         pthread_mutex_unlock(&worker->mutex);
 
         // In case of SMP search, the main worker thread will have to do
-        // additional work for launching other workers.
-        if (worker->idx)
+        // additional work for launching other workers. Standalone workers
+        // run their own task instead.
+        if (worker->standalone)
+            StandaloneTask(worker);
+        else if (worker->idx)
             worker_search(worker);
         else
             main_worker_search(worker);
@@ -197,6 +230,7 @@ void wpool_init(WorkerPool *wpool, size_t threads)
             }
 
             worker_init(wpool->workerList[wpool->size], wpool->size);
+            wpool->workerList[wpool->size]->pool = wpool;
             wpool->size++;
         }
 
@@ -206,8 +240,30 @@ void wpool_init(WorkerPool *wpool, size_t threads)
 
 void wpool_new_search(WorkerPool *wpool)
 {
-    // Reset the verification ply counter used in NMP for each thread.
-    for (size_t i = 0; i < wpool->size; ++i) wpool->workerList[i]->verifPlies = 0;
+    // Set the search parameter perturbations of helper workers: each helper
+    // gets a different combination of LMR and LMP offsets, so that workers
+    // explore slightly different trees.
+    for (size_t i = 0; i < wpool->size; ++i)
+    {
+        const bool diversify = wpool->options->helperDiversity && i != 0;
+
+        wpool->workerList[i]->lmrBias = diversify ? ((int)(i % 5) - 2) * 128 : 0;
+        wpool->workerList[i]->lmpBias = diversify ? (int)(i / 5 % 3) - 1 : 0;
+    }
+
+    // Reset the verification ply counter used in NMP and the eval cache, Pawn
+    // table and search statistics for each thread.
+    for (size_t i = 0; i < wpool->size; ++i)
+    {
+        wpool->workerList[i]->verifPlies = 0;
+        wpool->workerList[i]->evalCacheProbes = 0;
+        wpool->workerList[i]->evalCacheHits = 0;
+        wpool->workerList[i]->pawnProbes = 0;
+        wpool->workerList[i]->pawnHits = 0;
+#ifdef SEARCH_STATS
+        memset(&wpool->workerList[i]->stats, 0, sizeof(SearchStats));
+#endif
+    }
 
     // Reset the periodical time checking counter as well.
     wpool->checks = 1;
@@ -237,13 +293,16 @@ void wpool_start_search(WorkerPool *wpool, const Board *rootBoard, const SearchP
     {
         Worker *curWorker = wpool->workerList[i];
 
-        // Reset the node counter for each worker, and configure the position to
+        // Reset the node counters for each worker, and configure the position to
         // search.
         atomic_store_explicit(&curWorker->nodes, 0, memory_order_relaxed);
+        atomic_store_explicit(&curWorker->tbHits, 0, memory_order_relaxed);
+        curWorker->completedDepth = 0;
         curWorker->board = *rootBoard;
         curWorker->stack = curWorker->board.stack = dup_boardstack(rootBoard->stack);
         curWorker->board.worker = curWorker;
-        curWorker->rootCount = movelist_size(&UciSearchMoves);
+        curWorker->pool = wpool;
+        curWorker->rootCount = movelist_size(wpool->searchMoves);
         curWorker->rootMoves = malloc(sizeof(RootMove) * curWorker->rootCount);
 
         if (curWorker->rootMoves == NULL && curWorker->rootCount != 0)
@@ -257,9 +316,11 @@ void wpool_start_search(WorkerPool *wpool, const Board *rootBoard, const SearchP
         {
             RootMove *curRootMove = &curWorker->rootMoves[k];
 
-            curRootMove->move = UciSearchMoves.moves[k].move;
+            curRootMove->move = wpool->searchMoves->moves[k].move;
             curRootMove->seldepth = 0;
             curRootMove->score = curRootMove->prevScore = -INF_SCORE;
+            curRootMove->tbRank = 0;
+            curRootMove->tbScore = DRAW;
             curRootMove->pv[0] = curRootMove->pv[1] = NO_MOVE;
         }
     }
@@ -278,6 +339,34 @@ void wpool_wait_search_end(WorkerPool *wpool)
     for (size_t i = 1; i < wpool->size; ++i) worker_wait_search_end(wpool->workerList[i]);
 }
 
+void wpool_run_standalone(WorkerPool *wpool, void (*task)(Worker *))
+{
+    // Wait for the current search to complete if needed.
+    worker_wait_search_end(wpool_main_worker(wpool));
+
+    atomic_store_explicit(&wpool->stop, false, memory_order_relaxed);
+    atomic_store_explicit(&wpool->ponder, false, memory_order_relaxed);
+    StandaloneTask = task;
+
+    // Standalone workers don't need search perturbations, since they search
+    // different positions.
+    for (size_t i = 0; i < wpool->size; ++i)
+    {
+        wpool->workerList[i]->standalone = true;
+        wpool->workerList[i]->pool = wpool;
+        wpool->workerList[i]->lmrBias = 0;
+        wpool->workerList[i]->lmpBias = 0;
+        wpool->workerList[i]->verifPlies = 0;
+        worker_start_search(wpool->workerList[i]);
+    }
+
+    for (size_t i = 0; i < wpool->size; ++i)
+    {
+        worker_wait_search_end(wpool->workerList[i]);
+        wpool->workerList[i]->standalone = false;
+    }
+}
+
 uint64_t wpool_get_total_nodes(WorkerPool *wpool)
 {
     uint64_t totalNodes = 0;
@@ -288,3 +377,145 @@ uint64_t wpool_get_total_nodes(WorkerPool *wpool)
 
     return totalNodes;
 }
+
+uint64_t wpool_get_total_tbhits(WorkerPool *wpool)
+{
+    uint64_t totalHits = 0;
+
+    // Compute the sum of the current tablebase hits across all workers.
+    for (size_t i = 0; i < wpool->size; ++i)
+        totalHits += atomic_load_explicit(&wpool->workerList[i]->tbHits, memory_order_relaxed);
+
+    return totalHits;
+}
+
+Worker *wpool_best_worker(WorkerPool *wpool)
+{
+    Worker *bestWorker = wpool_main_worker(wpool);
+
+    // Only vote when searching a single line with several workers.
+    if (wpool->size == 1 || wpool->options->multiPv != 1) return bestWorker;
+
+    uint64_t votes[MAX_THREADS] = {0};
+    score_t minScore = INF_SCORE;
+
+    for (size_t i = 0; i < wpool->size; ++i)
+        if (wpool->workerList[i]->completedDepth)
+            minScore = imin(minScore, wpool->workerList[i]->rootMoves->prevScore);
+
+    // Each worker votes for its best move, with a weight depending on its score
+    // and on its completed depth.
+    for (size_t i = 0; i < wpool->size; ++i)
+    {
+        const Worker *voter = wpool->workerList[i];
+
+        if (!voter->completedDepth) continue;
+
+        const uint64_t weight =
+            (uint64_t)(voter->rootMoves->prevScore - minScore + 14) * voter->completedDepth;
+
+        for (size_t k = 0; k < wpool->size; ++k)
+            if (wpool->workerList[k]->completedDepth
+                && wpool->workerList[k]->rootMoves->move == voter->rootMoves->move)
+                votes[k] += weight;
+    }
+
+    size_t bestIdx = 0;
+
+    for (size_t i = 1; i < wpool->size; ++i)
+    {
+        Worker *curWorker = wpool->workerList[i];
+        const score_t score = curWorker->rootMoves->prevScore;
+        const score_t bestScore = bestWorker->rootMoves->prevScore;
+
+        if (!curWorker->completedDepth) continue;
+
+        // Always prefer the shortest mate found, and the longest one when all
+        // workers are getting mated. Otherwise, pick the most voted move,
+        // using the completed depth to break ties.
+        if (score >= MATE_FOUND || bestScore >= MATE_FOUND || bestScore <= -MATE_FOUND)
+        {
+            if (score <= bestScore) continue;
+        }
+        else if (score <= -MATE_FOUND || votes[i] < votes[bestIdx]
+                 || (votes[i] == votes[bestIdx]
+                     && curWorker->completedDepth <= bestWorker->completedDepth))
+            continue;
+
+        bestWorker = curWorker;
+        bestIdx = i;
+    }
+
+    return bestWorker;
+}
+
+void wpool_get_search_stats(WorkerPool *wpool, SearchStats *stats)
+{
+    memset(stats, 0, sizeof(SearchStats));
+
+#ifdef SEARCH_STATS
+    // Compute the sum of the search statistics across all workers.
+    for (size_t i = 0; i < wpool->size; ++i)
+        search_stats_merge(stats, &wpool->workerList[i]->stats);
+#else
+    (void)wpool;
+#endif
+}
+
+void wpool_print_profile(WorkerPool *wpool)
+{
+#ifdef PROFILE
+    char name[32];
+
+    for (size_t i = 0; i < wpool->size; ++i)
+    {
+        sprintf(name, "worker %zu", i);
+        profile_print(&wpool->workerList[i]->profile, name);
+    }
+#else
+    (void)wpool;
+#endif
+}
+
+void search_stats_merge(SearchStats *restrict dst, const SearchStats *restrict src)
+{
+    uint64_t *dstCounters = (uint64_t *)dst;
+    const uint64_t *srcCounters = (const uint64_t *)src;
+
+    for (size_t i = 0; i < sizeof(SearchStats) / sizeof(uint64_t); ++i)
+        dstCounters[i] += srcCounters[i];
+}
+
+INLINED double stat_ratio(uint64_t count, uint64_t total)
+{
+    return total ? 100.0 * count / total : 0.0;
+}
+
+void search_stats_print(const SearchStats *stats, uint64_t nodes, FILE *stream)
+{
+    fprintf(stream,
+        "info string TT hits %" FMT_INFO "/%" FMT_INFO " (%.2lf%%), cutoffs %" FMT_INFO "\n",
+        (info_t)stats->ttHits, (info_t)stats->ttProbes, stat_ratio(stats->ttHits, stats->ttProbes),
+        (info_t)stats->ttCutoffs);
+    fprintf(stream, "info string Null moves %" FMT_INFO "/%" FMT_INFO " (%.2lf%%)\n",
+        (info_t)stats->nmpCutoffs, (info_t)stats->nmpTries,
+        stat_ratio(stats->nmpCutoffs, stats->nmpTries));
+    fprintf(stream, "info string ProbCut cutoffs %" FMT_INFO "\n",
+        (info_t)stats->probcutCutoffs);
+    fprintf(stream,
+        "info string Singular searches %" FMT_INFO ", extensions %" FMT_INFO
+        ", multicuts %" FMT_INFO "\n",
+        (info_t)stats->singularSearches, (info_t)stats->singularExtensions,
+        (info_t)stats->multicuts);
+    fprintf(stream, "info string LMR re-searches %" FMT_INFO "/%" FMT_INFO " (%.2lf%%)\n",
+        (info_t)stats->lmrResearches, (info_t)stats->lmrSearches,
+        stat_ratio(stats->lmrResearches, stats->lmrSearches));
+    fprintf(stream, "info string First move cutoffs %" FMT_INFO "/%" FMT_INFO " (%.2lf%%)\n",
+        (info_t)stats->firstMoveCutoffs, (info_t)stats->betaCutoffs,
+        stat_ratio(stats->firstMoveCutoffs, stats->betaCutoffs));
+    fprintf(stream, "info string QSearch nodes %" FMT_INFO "/%" FMT_INFO " (%.2lf%%)\n",
+        (info_t)stats->qsearchNodes, (info_t)nodes, stat_ratio(stats->qsearchNodes, nodes));
+    fprintf(stream, "info string Branching factor %.2lf\n",
+        stats->expandedNodes ? (double)stats->searchedMoves / stats->expandedNodes : 0.0);
+    fflush(stream);
+}
@@ -0,0 +1,683 @@
+/*
+**    Stash, a UCI chess playing engine developed from scratch
+**    Copyright (C) 2019-2023 Morgan Houppin
+**
+**    Stash is free software: you can redistribute it and/or modify
+**    it under the terms of the GNU General Public License as published by
+**    the Free Software Foundation, either version 3 of the License, or
+**    (at your option) any later version.
+**
+**    Stash is distributed in the hope that it will be useful,
+**    but WITHOUT ANY WARRANTY; without even the implied warranty of
+**    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**    GNU General Public License for more details.
+**
+**    You should have received a copy of the GNU General Public License
+**    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bitboard.h"
+#include "board.h"
+#include "endgame.h"
+#include "hashkey.h"
+#include "random.h"
+#include "types.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// This program computes all the precomputed tables of the engine, and writes
+// them as constant data to the C file given as argument. It is built and run
+// by the Makefile before compiling the engine.
+
+int SquareDistance[SQUARE_NB][SQUARE_NB];
+bitboard_t LineBB[SQUARE_NB][SQUARE_NB];
+bitboard_t PseudoMoves[PIECETYPE_NB][SQUARE_NB];
+bitboard_t PawnMoves[COLOR_NB][SQUARE_NB];
+Magic BishopMagics[SQUARE_NB];
+Magic RookMagics[SQUARE_NB];
+
+bitboard_t HiddenRookTable[0x19000];
+bitboard_t HiddenBishopTable[0x1480];
+static bitboard_t PextRookTable[0x19000];
+static bitboard_t PextBishopTable[0x1480];
+static uint16_t PdepRookTable[0x19000];
+static uint16_t PdepBishopTable[0x1480];
+
+hashkey_t ZobristPsq[PIECE_NB][SQUARE_NB];
+hashkey_t ZobristEnPassant[FILE_NB];
+hashkey_t ZobristCastling[CASTLING_NB];
+hashkey_t ZobristSideToMove;
+
+hashkey_t CyclicKeys[8192];
+move_t CyclicMoves[8192];
+
+uint8_t KPK_Bitbase[KPK_SIZE / 8];
+// Returns a bitboard representing all the reachable squares by a bishop
+// (or rook) from given square and given occupied squares.
+static bitboard_t sliding_attack(
+    const direction_t *directions, square_t square, bitboard_t occupied)
+{
+    bitboard_t attack = 0;
+
+    for (int i = 0; i < 4; ++i)
+        for (square_t s = square + directions[i];
+             is_valid_sq(s) && SquareDistance[s][s - directions[i]] == 1; s += directions[i])
+        {
+            attack |= square_bb(s);
+            if (occupied & square_bb(s)) break;
+        }
+
+    return attack;
+}
+
+// Initializes magic bitboard tables necessary for bishop, rook and queen moves.
+static void magic_init(bitboard_t *table, Magic *magics, const direction_t *directions)
+{
+    bitboard_t reference[4096], occupancy[4096], edges, b;
+
+    // The epoch is used to determine which iteration of the occupancy test
+    // we are in, to avoid having to zero the attack array between each failed
+    // iteration.
+    int epoch[4096] = {0}, currentEpoch = 0;
+    uint64_t seed = 64;
+
+    bitboard_t *moves = table;
+    int size = 0;
+
+    for (square_t square = SQ_A1; square <= SQ_H8; ++square)
+    {
+        // The edges of the board are not counted in the occupancy bits
+        // (since we can reach them whether there's a piece on them or not
+        // because of capture moves), but we must still ensure they're
+        // accounted for if the piece is already on them for Rook moves.
+        edges = ((RANK_1_BB | RANK_8_BB) & ~sq_rank_bb(square))
+                | ((FILE_A_BB | FILE_H_BB) & ~sq_file_bb(square));
+
+        Magic *m = magics + square;
+
+        // Compute the occupancy for the given square, excluding edges as
+        // explained before.
+        m->mask = sliding_attack(directions, square, 0) & ~edges;
+
+        // We will need popcount(mask) bits of information for indexing
+        // the occupancy, and (1 << popcount(mask)) entries in the table
+        // for storing the corresponding attack bitboards.
+        m->shift = 64 - popcount(m->mask);
+
+        // We use the entry count of the previous square for computing the
+        // next index.
+        moves += size;
+        m->moves = moves;
+
+        b = 0;
+        size = 0;
+
+        // Iterate over all subsets of the occupancy mask with the
+        // Carry-Rippler trick and compute all attack bitboards for the current
+        // square based on the occupancy.
+        do {
+            occupancy[size] = b;
+            reference[size] = sliding_attack(directions, square, b);
+            size++;
+            b = (b - m->mask) & m->mask;
+        } while (b);
+
+        // Now loop until we find a magic that maps each occupancy to a correct
+        // index in our magic table. We optimize the loop by using two binary
+        // ANDs to reduce the number of significant bits in the magic
+        // (good magics generally have high bit sparsity), and we reduce
+        // further the range of tested values by removing magics which do not
+        // generate enough significant bits for a full occupancy mask.
+        for (int i = 0; i < size;)
+        {
+            for (m->magic = 0; popcount((m->magic * m->mask) >> 56) < 6;)
+                m->magic = qrandom(&seed) & qrandom(&seed) & qrandom(&seed);
+
+            // Check if the generated magic correctly maps each occupancy to
+            // its corresponding bitboard attack. Note that we build the table
+            // for the square as we test for each occupancy as a speedup, and
+            // that we allow two different occupancies to map to the same index
+            // if their corresponding bitboard attack is identical.
+            for (++currentEpoch, i = 0; i < size; ++i)
+            {
+                unsigned int index = magic_index(m, occupancy[i]);
+
+                // Check if we already wrote an attack bitboard at this index
+                // during this iteration of the loop. If not, we can set
+                // the attack bitboard corresponding to the occupancy at this
+                // index; otherwise we check if the attack bitboard already
+                // written is identical to the current one, and if it's not
+                // the case, the mapping failed, and we must try another value.
+                if (epoch[index] < currentEpoch)
+                {
+                    epoch[index] = currentEpoch;
+                    moves[index] = reference[i];
+                }
+                else if (moves[index] != reference[i])
+                    break;
+            }
+        }
+    }
+}
+
+// Initializes all bitboard tables at program startup.
+static void bitboard_init(void)
+{
+    static const direction_t kingDirections[8] = {-9, -8, -7, -1, 1, 7, 8, 9};
+    static const direction_t knightDirections[8] = {-17, -15, -10, -6, 6, 10, 15, 17};
+    static const direction_t bishopDirections[4] = {-9, -7, 7, 9};
+    static const direction_t rookDirections[4] = {-8, -1, 1, 8};
+
+    // Initialize the square distance table.
+    for (square_t sq1 = SQ_A1; sq1 <= SQ_H8; ++sq1)
+        for (square_t sq2 = SQ_A1; sq2 <= SQ_H8; ++sq2)
+        {
+            const int fileDistance = abs(sq_file(sq1) - sq_file(sq2));
+            const int rankDistance = abs(sq_rank(sq1) - sq_rank(sq2));
+
+            SquareDistance[sq1][sq2] = imax(fileDistance, rankDistance);
+        }
+
+    // Initialize the Pawn pseudo-moves table.
+    for (square_t square = SQ_A1; square <= SQ_H8; ++square)
+    {
+        const bitboard_t b = square_bb(square);
+
+        PawnMoves[WHITE][square] = (shift_up_left(b) | shift_up_right(b));
+        PawnMoves[BLACK][square] = (shift_down_left(b) | shift_down_right(b));
+    }
+
+    // Initialize the King and Knight pseudo-moves tables.
+    for (square_t square = SQ_A1; square <= SQ_H8; ++square)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            const square_t to = square + kingDirections[i];
+
+            if (is_valid_sq(to) && SquareDistance[square][to] <= 2)
+                PseudoMoves[KING][square] |= square_bb(to);
+        }
+
+        for (int i = 0; i < 8; ++i)
+        {
+            const square_t to = square + knightDirections[i];
+
+            if (is_valid_sq(to) && SquareDistance[square][to] <= 2)
+                PseudoMoves[KNIGHT][square] |= square_bb(to);
+        }
+    }
+
+    // Initialize the Bishop and Rook magic tables.
+    magic_init(HiddenBishopTable, BishopMagics, bishopDirections);
+    magic_init(HiddenRookTable, RookMagics, rookDirections);
+
+    // Initialize the Bishop, Rook and Queen pseudo-moves tables, as well
+    // as the line bitboards table.
+    for (square_t sq1 = SQ_A1; sq1 <= SQ_H8; ++sq1)
+    {
+        PseudoMoves[QUEEN][sq1] = PseudoMoves[BISHOP][sq1] = bishop_moves_bb(sq1, 0);
+        PseudoMoves[QUEEN][sq1] |= PseudoMoves[ROOK][sq1] = rook_moves_bb(sq1, 0);
+
+        for (square_t sq2 = SQ_A1; sq2 <= SQ_H8; ++sq2)
+        {
+            if (PseudoMoves[BISHOP][sq1] & square_bb(sq2))
+                LineBB[sq1][sq2] = (bishop_moves_bb(sq1, 0) & bishop_moves_bb(sq2, 0))
+                                   | square_bb(sq1) | square_bb(sq2);
+
+            if (PseudoMoves[ROOK][sq1] & square_bb(sq2))
+                LineBB[sq1][sq2] = (rook_moves_bb(sq1, 0) & rook_moves_bb(sq2, 0)) | square_bb(sq1)
+                                   | square_bb(sq2);
+        }
+    }
+}
+
+// Initializes the Zobrist keys.
+static void zobrist_init(void)
+{
+    uint64_t seed = 0x7F6E5D4C3B2A1908ull;
+
+    // Initialize the Piece-Square Zobrist table.
+    for (piece_t piece = WHITE_PAWN; piece <= BLACK_KING; ++piece)
+        for (square_t square = SQ_A1; square <= SQ_H8; ++square)
+            ZobristPsq[piece][square] = qrandom(&seed);
+
+    // Initialize the En-Passant Zobrist table.
+    for (file_t file = FILE_A; file <= FILE_H; ++file) ZobristEnPassant[file] = qrandom(&seed);
+
+    // Initialize the Castling Zobrist table.
+    for (int cr = 0; cr < CASTLING_NB; ++cr)
+    {
+        ZobristCastling[cr] = 0;
+        bitboard_t b = cr;
+        while (b)
+        {
+            hashkey_t k = ZobristCastling[1ull << bb_pop_first_sq(&b)];
+            ZobristCastling[cr] ^= k ? k : qrandom(&seed);
+        }
+    }
+
+    // Initialize the Zobrist key for the side to move.
+    ZobristSideToMove = qrandom(&seed);
+}
+
+static void cyclic_init_move(piece_t piece, square_t from, square_t to)
+{
+    move_t move = create_move(from, to);
+    hashkey_t key = ZobristPsq[piece][from] ^ ZobristPsq[piece][to] ^ ZobristSideToMove;
+    uint16_t index = cyclic_index_lo(key);
+
+    // Swap the current move/key pair with the table contents until we find an
+    // empty slot.
+    while (true)
+    {
+        hashkey_t tmpKey = CyclicKeys[index];
+        CyclicKeys[index] = key;
+        key = tmpKey;
+
+        move_t tmpMove = CyclicMoves[index];
+        CyclicMoves[index] = move;
+        move = tmpMove;
+
+        if (move == NO_MOVE) break;
+
+        // Trick: change the section of the key for indexing by xor-ing the
+        // index value with the low and high key indexes:
+        // - if index == hi, index ^ lo ^ hi == lo
+        // - if index == lo, index ^ lo ^ hi == hi
+        index ^= cyclic_index_lo(key) ^ cyclic_index_hi(key);
+    }
+}
+
+// Initializes cycle detection tables.
+static void cyclic_init(void)
+{
+    // Map all reversible move Zobrist keys to their corresponding move.
+    for (piecetype_t pt = KNIGHT; pt <= KING; ++pt)
+        for (color_t c = WHITE; c <= BLACK; ++c)
+            for (square_t from = SQ_A1; from <= SQ_H8; ++from)
+                for (square_t to = from + 1; to <= SQ_H8; ++to)
+                    if (piece_moves(pt, from, 0) & square_bb(to))
+                        cyclic_init_move(create_piece(c, pt), from, to);
+}
+
+enum
+{
+    KPK_INVALID = 0,
+    KPK_UNKNOWN = 1,
+    KPK_DRAW = 2,
+    KPK_WIN = 4
+};
+
+typedef struct kpk_position_s
+{
+    color_t sideToMove;
+    square_t kingSquare[COLOR_NB];
+    square_t pawnSquare;
+    uint8_t result;
+} kpk_position_t;
+
+static void kpk_set(kpk_position_t *pos, unsigned int index)
+{
+    const square_t wksq = (square_t)(index & 0x3F);
+    const square_t bksq = (square_t)((index >> 6) & 0x3F);
+    const color_t stm = (color_t)((index >> 12) & 1);
+    const square_t psq =
+        create_sq((file_t)((index >> 13) & 0x3), (rank_t)(RANK_7 - ((index >> 15) & 0x7)));
+
+    pos->sideToMove = stm;
+    pos->kingSquare[WHITE] = wksq;
+    pos->kingSquare[BLACK] = bksq;
+    pos->pawnSquare = psq;
+
+    // Overlapping/adjacent Kings ?
+    if (SquareDistance[wksq][bksq] <= 1) pos->result = KPK_INVALID;
+
+    // Overlapping King with Pawn ?
+    else if (wksq == psq || bksq == psq)
+        pos->result = KPK_INVALID;
+
+    // Losing king in check while the winning side has the move ?
+    else if (stm == WHITE && (PawnMoves[WHITE][psq] & square_bb(bksq)))
+        pos->result = KPK_INVALID;
+
+    // Can we promote without getting captured ?
+    else if (stm == WHITE && sq_rank(psq) == RANK_7 && wksq != psq + NORTH
+             && (SquareDistance[bksq][psq + NORTH] > 1 || SquareDistance[wksq][psq + NORTH] == 1))
+        pos->result = KPK_WIN;
+
+    // Is it stalemate ?
+    else if (stm == BLACK && !(king_moves(bksq) & ~(king_moves(wksq) | PawnMoves[WHITE][psq])))
+        pos->result = KPK_DRAW;
+
+    // Can the losing side capture the Pawn ?
+    else if (stm == BLACK && (king_moves(bksq) & ~king_moves(wksq) & square_bb(psq)))
+        pos->result = KPK_DRAW;
+
+    else
+        pos->result = KPK_UNKNOWN;
+}
+
+static void kpk_classify(kpk_position_t *pos, kpk_position_t *kpkTable)
+{
+    const uint8_t goodResult = (pos->sideToMove == WHITE) ? KPK_WIN : KPK_DRAW;
+    const uint8_t badResult = (pos->sideToMove == WHITE) ? KPK_DRAW : KPK_WIN;
+
+    const square_t wksq = pos->kingSquare[WHITE];
+    const square_t bksq = pos->kingSquare[BLACK];
+    const color_t stm = pos->sideToMove;
+    const square_t psq = pos->pawnSquare;
+
+    uint8_t result = KPK_INVALID;
+    bitboard_t b = king_moves(pos->kingSquare[stm]);
+
+    // We will pack all moves' results in the result variable with bitwise 'or's.
+    // We exploit the fact that invalid entries with overlapping pieces are stored
+    // as KPK_INVALID (aka 0) to avoid checking for move legality (expect for double
+    // Pawn pushes, where we need to check if the square above the pawn is empty).
+
+    // Get all entries' results for King moves.
+    while (b)
+    {
+        if (stm == WHITE)
+            result |= kpkTable[kpk_index(BLACK, bksq, bb_pop_first_sq(&b), psq)].result;
+        else
+            result |= kpkTable[kpk_index(WHITE, bb_pop_first_sq(&b), wksq, psq)].result;
+    }
+
+    // If the winning side has the move, also get all entries' results for Pawn moves.
+    if (stm == WHITE)
+    {
+        // Single push
+        if (sq_rank(psq) < RANK_7)
+            result |= kpkTable[kpk_index(BLACK, bksq, wksq, psq + NORTH)].result;
+
+        // Double push
+        if (sq_rank(psq) == RANK_2 && psq + NORTH != wksq && psq + NORTH != bksq)
+            result |= kpkTable[kpk_index(BLACK, bksq, wksq, psq + NORTH + NORTH)].result;
+    }
+
+    pos->result = ((result & goodResult)    ? goodResult
+                   : (result & KPK_UNKNOWN) ? KPK_UNKNOWN
+                                            : badResult);
+}
+
+// Initializes the KPK bitbase.
+static void init_kpk_bitbase(void)
+{
+    kpk_position_t *kpkTable = malloc(sizeof(kpk_position_t) * KPK_SIZE);
+
+    if (kpkTable == NULL)
+    {
+        perror("Unable to initialize KPK bitbase");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned int index;
+    bool repeat;
+
+    // Fill the bitbase with zeroes, and then perform an early
+    // recognition of trivial wins/draws and illegal positions.
+    memset(KPK_Bitbase, 0, sizeof(KPK_Bitbase));
+    for (index = 0; index < KPK_SIZE; ++index) kpk_set(kpkTable + index, index);
+
+    // Backtrack all known wins/draws to the undecided positions, by trying to
+    // determine the result of a position from the child states' results.
+    do {
+        repeat = false;
+        for (index = 0; index < KPK_SIZE; ++index)
+            if (kpkTable[index].result == KPK_UNKNOWN)
+            {
+                kpk_classify(kpkTable + index, kpkTable);
+                repeat |= kpkTable[index].result != KPK_UNKNOWN;
+            }
+    } while (repeat);
+
+    // Index the wins in the bitbase as set bits.
+    for (index = 0; index < KPK_SIZE; ++index)
+        if (kpkTable[index].result == KPK_WIN) KPK_Bitbase[index / 8] |= 1 << (index % 8);
+
+    free(kpkTable);
+}
+
+// Returns the bits of the given bitboard selected by the mask, packed in the
+// lowest bits of the result like the PEXT instruction does.
+static unsigned int soft_pext(bitboard_t b, bitboard_t mask)
+{
+    unsigned int result = 0;
+
+    for (unsigned int bit = 1; mask; bit <<= 1, mask &= mask - 1)
+        if (b & mask & -mask) result |= bit;
+
+    return result;
+}
+
+// Initializes the slider tables used by PEXT builds, which index the attack
+// bitboards by the occupancy bits of the mask instead of using the magics.
+// Each square keeps the same table slice as with magic indexing. The compact
+// tables used with PDEP only store the attack bits selected by the attacks on
+// an empty board, which fit in 16 bits.
+static void pext_init(const bitboard_t *table, const Magic *magics, bitboard_t *pextTable,
+    uint16_t *pdepTable)
+{
+    for (square_t square = SQ_A1; square <= SQ_H8; ++square)
+    {
+        const Magic *m = magics + square;
+        const bitboard_t emptyAttacks = m->moves[magic_index(m, 0)];
+        const ptrdiff_t offset = m->moves - table;
+        bitboard_t b = 0;
+
+        do {
+            const unsigned int index = soft_pext(b, m->mask);
+
+            pextTable[offset + index] = m->moves[magic_index(m, b)];
+            pdepTable[offset + index] = soft_pext(pextTable[offset + index], emptyAttacks);
+            b = (b - m->mask) & m->mask;
+        } while (b);
+    }
+}
+
+// Writes a single table value of the given size.
+static void write_value(FILE *f, const void *value, size_t size)
+{
+    if (size == sizeof(uint64_t))
+    {
+        uint64_t v;
+
+        memcpy(&v, value, size);
+        fprintf(f, "0x%016" PRIx64, v);
+    }
+    else if (size == sizeof(int32_t))
+    {
+        int32_t v;
+
+        memcpy(&v, value, size);
+        fprintf(f, "%" PRId32, v);
+    }
+    else if (size == sizeof(uint16_t))
+    {
+        uint16_t v;
+
+        memcpy(&v, value, size);
+        fprintf(f, "%" PRIu16, v);
+    }
+    else
+    {
+        uint8_t v;
+
+        memcpy(&v, value, size);
+        fprintf(f, "%" PRIu8, v);
+    }
+}
+
+// Writes the given table definition, with one brace block per row for
+// two-dimensional tables.
+static void write_table(
+    FILE *f, const char *decl, const void *data, size_t size, size_t rows, size_t cols)
+{
+    const size_t perLine = (size == sizeof(uint64_t)) ? 4 : 16;
+    const char *indent = (rows > 1) ? "        " : "    ";
+
+    fprintf(f, "\n%s = {\n", decl);
+
+    for (size_t row = 0; row < rows; ++row)
+    {
+        if (rows > 1) fputs("    {\n", f);
+
+        for (size_t col = 0; col < cols; ++col)
+        {
+            if (col % perLine == 0) fputs(indent, f);
+
+            write_value(f, (const uint8_t *)data + (row * cols + col) * size, size);
+            fputs((col % perLine == perLine - 1 || col == cols - 1) ? ",\n" : ", ", f);
+        }
+
+        if (rows > 1) fputs("    },\n", f);
+    }
+
+    fputs("};\n", f);
+}
+
+// Slider table layouts, matching the Magic struct variants.
+typedef enum
+{
+    MagicLayout,
+    PextLayout,
+    PdepLayout,
+    DispatchLayout
+} layout_t;
+
+// Writes the magics definition of the given piece for the given layout, with
+// attack pointers relative to the start of the tables.
+static void write_magics(
+    FILE *f, const char *pieceName, const Magic *magics, const bitboard_t *table, layout_t layout)
+{
+    static const char *TablePrefixes[] = {"Magic", "Pext", "Pdep", "Magic"};
+
+    fprintf(f, "\nconst Magic %sMagics[SQUARE_NB] = {\n", pieceName);
+
+    for (square_t square = SQ_A1; square <= SQ_H8; ++square)
+    {
+        const Magic *m = magics + square;
+        const unsigned long offset = (unsigned long)(m->moves - table);
+
+        fprintf(f, "    {0x%016" PRIx64 ", 0x%016" PRIx64 ", %s%sTable + %lu", m->mask,
+            layout == PdepLayout ? m->moves[magic_index(m, 0)] : m->magic,
+            TablePrefixes[layout], pieceName, offset);
+
+        if (layout == DispatchLayout) fprintf(f, ", Pext%sTable + %lu", pieceName, offset);
+
+        if (layout != PdepLayout) fprintf(f, ", %u", m->shift);
+
+        fputs("},\n", f);
+    }
+
+    fputs("};\n", f);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 2)
+    {
+        printf("Usage: %s output_file\n", *argv);
+        return EXIT_FAILURE;
+    }
+
+    // Compute all the tables.
+    bitboard_init();
+    zobrist_init();
+    cyclic_init();
+    init_kpk_bitbase();
+    pext_init(HiddenBishopTable, BishopMagics, PextBishopTable, PdepBishopTable);
+    pext_init(HiddenRookTable, RookMagics, PextRookTable, PdepRookTable);
+
+    FILE *f = fopen(argv[1], "w");
+
+    if (f == NULL)
+    {
+        perror("Unable to open output file");
+        exit(EXIT_FAILURE);
+    }
+
+    fputs("// This file was generated by tools/tablegen.c, do not edit.\n\n"
+          "#include \"bitboard.h\"\n"
+          "#include \"board.h\"\n"
+          "#include \"endgame.h\"\n"
+          "#include \"hashkey.h\"\n",
+        f);
+
+    write_table(f, "const int SquareDistance[SQUARE_NB][SQUARE_NB]", SquareDistance,
+        sizeof(int), SQUARE_NB, SQUARE_NB);
+    write_table(f, "const bitboard_t LineBB[SQUARE_NB][SQUARE_NB]", LineBB, sizeof(bitboard_t),
+        SQUARE_NB, SQUARE_NB);
+    write_table(f, "const bitboard_t PseudoMoves[PIECETYPE_NB][SQUARE_NB]", PseudoMoves,
+        sizeof(bitboard_t), PIECETYPE_NB, SQUARE_NB);
+    write_table(f, "const bitboard_t PawnMoves[COLOR_NB][SQUARE_NB]", PawnMoves,
+        sizeof(bitboard_t), COLOR_NB, SQUARE_NB);
+
+    // The slider tables have the same layout for all indexing methods, only
+    // the position of the attack bitboards within each slice differ. Fat
+    // builds need both the magic and PEXT tables.
+    fputs("\n#ifdef USE_PDEP\n", f);
+    write_table(f, "static const uint16_t PdepBishopTable[0x1480]", PdepBishopTable,
+        sizeof(uint16_t), 1, 0x1480);
+    write_table(f, "static const uint16_t PdepRookTable[0x19000]", PdepRookTable,
+        sizeof(uint16_t), 1, 0x19000);
+    fputs("\n#else\n", f);
+    fputs("\n#if defined(USE_PEXT) || defined(USE_DISPATCH)\n", f);
+    write_table(f, "static const bitboard_t PextBishopTable[0x1480]", PextBishopTable,
+        sizeof(bitboard_t), 1, 0x1480);
+    write_table(f, "static const bitboard_t PextRookTable[0x19000]", PextRookTable,
+        sizeof(bitboard_t), 1, 0x19000);
+    fputs("\n#endif\n", f);
+    fputs("\n#ifndef USE_PEXT\n", f);
+    write_table(f, "static const bitboard_t MagicBishopTable[0x1480]", HiddenBishopTable,
+        sizeof(bitboard_t), 1, 0x1480);
+    write_table(f, "static const bitboard_t MagicRookTable[0x19000]", HiddenRookTable,
+        sizeof(bitboard_t), 1, 0x19000);
+    fputs("\n#endif\n", f);
+    fputs("\n#endif\n", f);
+
+    static const struct
+    {
+        const char *condition;
+        layout_t layout;
+    } Variants[] = {
+        {"#if defined(USE_PDEP)", PdepLayout},
+        {"#elif defined(USE_PEXT)", PextLayout},
+        {"#elif defined(USE_DISPATCH)", DispatchLayout},
+        {"#else", MagicLayout},
+    };
+
+    for (size_t i = 0; i < sizeof(Variants) / sizeof(*Variants); ++i)
+    {
+        fprintf(f, "\n%s\n", Variants[i].condition);
+        write_magics(f, "Bishop", BishopMagics, HiddenBishopTable, Variants[i].layout);
+        write_magics(f, "Rook", RookMagics, HiddenRookTable, Variants[i].layout);
+    }
+
+    fputs("\n#endif\n", f);
+
+    write_table(f, "const hashkey_t ZobristPsq[PIECE_NB][SQUARE_NB]", ZobristPsq,
+        sizeof(hashkey_t), PIECE_NB, SQUARE_NB);
+    write_table(f, "const hashkey_t ZobristEnPassant[FILE_NB]", ZobristEnPassant,
+        sizeof(hashkey_t), 1, FILE_NB);
+    write_table(f, "const hashkey_t ZobristCastling[CASTLING_NB]", ZobristCastling,
+        sizeof(hashkey_t), 1, CASTLING_NB);
+    fprintf(f, "\nconst hashkey_t ZobristSideToMove = 0x%016" PRIx64 ";\n", ZobristSideToMove);
+
+    write_table(f, "const hashkey_t CyclicKeys[8192]", CyclicKeys, sizeof(hashkey_t), 1, 8192);
+    write_table(f, "const move_t CyclicMoves[8192]", CyclicMoves, sizeof(move_t), 1, 8192);
+
+    write_table(f, "const uint8_t KPK_Bitbase[KPK_SIZE / 8]", KPK_Bitbase, sizeof(uint8_t), 1,
+        KPK_SIZE / 8);
+
+    if (fclose(f) != 0)
+    {
+        perror("Unable to write output file");
+        exit(EXIT_FAILURE);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -2,11 +2,4 @@
 
 cd src
 
-CFLAGS="$CFLAGS -fprofile-generate" LDFLAGS="$LDFLAGS -lgcov" ARCH="$ARCH" make re
-
-./stash-bot bench
-
-CFLAGS="$CFLAGS -fprofile-use -fno-peel-loops -fno-tracer" LDFLAGS="$LDFLAGS -lgcov" \
-    ARCH="$ARCH" make re
-
-rm sources/*.gcda
+make pgo ARCH="$ARCH"
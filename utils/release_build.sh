@@ -13,29 +13,23 @@ cd $(dirname "$0")
 
 cd ../src
 
-cat Makefile | sed 's/-Werror/-Wno-coverage-mismatch/g' > tmp.make
-
 for arch in 64 x86-64 x86-64-modern x86-64-bmi2
 do
     ext_arch=${arch/x86-64/x86_64}
 
-    ARCH="$arch" CFLAGS="-fprofile-generate" LDFLAGS="-lgcov" make -f tmp.make re
-
-    ./stash-bot bench
+    make pgo-train ARCH="$arch"
 
-    ARCH="$arch" CFLAGS="-fprofile-use -fno-peel-loops -fno-tracer" LDFLAGS="-lgcov" \
-        make -f tmp.make re EXE="stash-$version-linux-$ext_arch" \
+    make pgo-use ARCH="$arch" EXE="stash-$version-linux-$ext_arch"
 
-    ARCH="$arch" CC=x86_64-w64-mingw32-gcc CFLAGS="-fprofile-use -fno-peel-loops -fno-tracer" \
-        LDFLAGS="-lgcov -static" make -f tmp.make re \
-        EXE="stash-$version-windows-$ext_arch.exe" \
+    # The Windows binary reuses the profile collected by the Linux one.
+    LDFLAGS="-static" make pgo-use ARCH="$arch" CC=x86_64-w64-mingw32-gcc \
+        EXE="stash-$version-windows-$ext_arch.exe"
 
-    rm $(find sources \( -name "*.gcda" \) )
+    make profclean
 done
 
-CFLAGS="-m32" make -f tmp.make re EXE="stash-$version-linux-i386" ARCH=i386
+CFLAGS="-m32" make re EXE="stash-$version-linux-i386" ARCH=i386
 
-make -f tmp.make clean
+make clean
 
 rm stash-bot
-rm -f tmp.make
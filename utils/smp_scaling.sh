@@ -0,0 +1,54 @@
+#!/bin/sh
+
+# This script measures the time-to-depth of the bench positions for increasing
+# thread counts, both with plain Lazy SMP and with a variant of the SMP options
+# given as name=value pairs in VARIANT (ABDADA=true by default, for example
+# VARIANT="HelperDepthSkip=true HelperDiversity=true"). Set MAX_THREADS to the
+# number of hardware threads, and DEPTH to the bench depth.
+
+cd $(dirname "$0")/../src
+
+engine=${ENGINE:-./stash-bot}
+depth=${DEPTH:-16}
+maxThreads=${MAX_THREADS:-128}
+variant=${VARIANT:-ABDADA=true}
+
+bench_time()
+{
+    benchThreads=$1
+    shift
+
+    set -- "$@" "setoption name Hash value 256" "setoption name Threads value $benchThreads"
+
+    $engine "$@" "bench $depth" | awk '/^TIME:/ { print $2 }'
+}
+
+variant_time()
+{
+    variantThreads=$1
+    set --
+
+    for option in $variant
+    do
+        set -- "$@" "setoption name ${option%%=*} value ${option#*=}"
+    done
+
+    bench_time $variantThreads "$@"
+}
+
+printf "%8s %12s %12s %8s %8s\n" threads lazy_ms variant_ms lazy_x variant_x
+
+threads=1
+
+while [ $threads -le $maxThreads ]
+do
+    lazy=$(bench_time $threads)
+    other=$(variant_time $threads)
+
+    [ $threads -eq 1 ] && base=$lazy
+
+    awk -v t=$threads -v b=$base -v l=$lazy -v v=$other \
+        'BEGIN { printf "%8d %12d %12d %8.2f %8.2f\n", t, l, v, b / l, b / v }'
+
+    threads=$((threads * 2))
+done